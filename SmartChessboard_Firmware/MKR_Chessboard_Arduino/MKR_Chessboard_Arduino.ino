@@ -10,6 +10,7 @@
  * Librerie richieste:
  * - ArduinoJson (versione 6.x)
  * - WiFiNINA (inclusa con Arduino IDE)
+ * - ChessLink (SmartChessboard_Firmware/libraries, la stessa del Mega)
  * 
  * Hardware:
  * - Arduino MKR WiFi 1010
@@ -20,6 +21,7 @@
 
 #include <WiFiNINA.h>
 #include <ArduinoJson.h>
+#include <ChessLink.h>
 #include "src/config.h"
 #include "src/wifi_config.h"
 #include "src/ChessboardProtocol.h"
@@ -27,6 +29,9 @@
 // Istanza del protocollo scacchi
 ChessboardProtocol chessboard;
 
+// Collegamento con il Mega su Serial1: frame con CRC, conferme e ritrasmissioni
+ChessLink megaLink;
+
 void setup() {
   // Inizializza la comunicazione seriale
   Serial.begin(115200);
@@ -35,7 +40,8 @@ void setup() {
   }
   
   // Inizializza la comunicazione con il Mega
-  Serial1.begin(9600);
+  Serial1.begin(CHESSLINK_BAUDRATE);
+  megaLink.begin(Serial1);
   
   // Stampa informazioni di avvio
   printStartupInfo();
@@ -62,12 +68,34 @@ void loop() {
   
   // Gestisce input da monitor seriale
   handleSerialInput();
+
+  // Messaggi dal Mega (CALIB_MSG:...), il collegamento manda anche i frame e le conferme in attesa
+  handleMegaLink();
   
   // Aggiorna lo stato del sistema
   chessboard.updateStatus();
   
-  // Piccola pausa per evitare sovraccarico
-  delay(10);
+  // Piccola pausa per evitare sovraccarico: a 115200 baud in 1 ms arrivano 11 byte,
+  // il buffer di ricezione di Serial1 non si riempie tra un giro e l'altro
+  delay(1);
+}
+
+void handleMegaLink() {
+  if (megaLink.receive()) {
+    Serial.print("Messaggio dal Mega: ");
+    Serial.println(megaLink.text());
+    // Gli eventi delle mosse diventano MOVE_CONFIRM / MOVE_PROGRESS per l'app
+    chessboard.handleMegaMessage(megaLink.text());
+  }
+}
+
+// Un comando per il Mega, false se il Mega non lo ha confermato in tempo
+bool sendToMega(const String& command) {
+  if (!megaLink.send(ChessLinkCommand, command.c_str())) {
+    Serial.println("ERRORE: comando non inviato al Mega: " + command);
+    return false;
+  }
+  return true;
 }
 
 void printStartupInfo() {
@@ -96,7 +124,9 @@ void printConnectionInfo() {
     Serial.println("Disconnected");
   }
   Serial.print("Mega Communication: ");
-  Serial.println("Serial1 (9600 baud)");
+  Serial.print("Serial1 (");
+  Serial.print(CHESSLINK_BAUDRATE);
+  Serial.println(" baud, ChessLink)");
   Serial.println("========================================");
 }
 
@@ -125,6 +155,15 @@ void handleSerialInput() {
         String move = input.substring(5);
         simulateMove(move);
       }
+      else if (input.startsWith("mega ")) {
+        String command = input.substring(5);
+        if (sendToMega(command)) {
+          Serial.println("Comando inviato al Mega: " + command);
+        }
+      }
+      else if (input == "link") {
+        printLinkStatus();
+      }
       else if (input.startsWith("led ")) {
         String ledCmd = input.substring(4);
         controlLED(ledCmd);
@@ -153,6 +192,8 @@ void printHelp() {
   Serial.println("wifi             - Stato WiFi");
   Serial.println("ping             - Invia ping di test");
   Serial.println("move e2e4        - Simula mossa (es: e2e4)");
+  Serial.println("mega CALIB_CONFIRM - Invia un comando al Mega (STARTGAME, CALIBRATE...)");
+  Serial.println("link             - Statistiche del collegamento con il Mega");
   Serial.println("led on           - Accendi LED");
   Serial.println("led off          - Spegni LED");
   Serial.println("led blink        - Fai lampeggiare LED");
@@ -183,6 +224,28 @@ void printSystemStatus() {
   Serial.println("========================================");
 }
 
+void printLinkStatus() {
+  const ChessLinkStats& link = megaLink.stats();
+  Serial.println("========================================");
+  Serial.println("COLLEGAMENTO MEGA:");
+  Serial.println("========================================");
+  Serial.print("Stato: ");
+  Serial.println(megaLink.isPeerUp() ? "Attivo" : "Il Mega non risponde");
+  Serial.print("Frame inviati e confermati: ");
+  Serial.println(link.sent);
+  Serial.print("Frame ricevuti: ");
+  Serial.println(link.received);
+  Serial.print("Ritrasmissioni: ");
+  Serial.println(link.retransmits);
+  Serial.print("Frame con CRC errato: ");
+  Serial.println(link.crcErrors);
+  Serial.print("Duplicati scartati: ");
+  Serial.println(link.duplicates);
+  Serial.print("Frame persi: ");
+  Serial.println(link.failed + link.dropped);
+  Serial.println("========================================");
+}
+
 void printWiFiStatus() {
   Serial.println("========================================");
   Serial.println("STATO WIFI:");
@@ -219,8 +282,9 @@ void simulateMove(String move) {
   Serial.println("Simulando mossa: " + move);
   
   // Invia comando al Mega via Serial1
-  Serial1.println(move);
-  Serial.println("Comando inviato al Mega: " + move);
+  if (sendToMega(move)) {
+    Serial.println("Comando inviato al Mega: " + move);
+  }
   
   // Simula anche la risposta del protocollo
   DynamicJsonDocument doc(1024);
@@ -485,7 +485,7 @@ void ChessboardProtocol::handleMoveDetected(JsonObject data) {
     DEBUG_LOG_INFO("Move detected: " + fromSquare + " to " + toSquare + " (" + pieceType + ")");
     
     // Send move confirmation
-    sendMoveConfirm(moveId, "MOVE_ACCEPTED");
+    sendMoveConfirm(moveId, MOVE_STATUS_ACCEPTED);
     
     // Update game state
     lastMove = fromSquare + toSquare;
@@ -509,12 +509,104 @@ void ChessboardProtocol::handleMoveDetected(JsonObject data) {
     handleLEDControl(ledData.as<JsonObject>());
 }
 
-void ChessboardProtocol::sendMoveConfirm(String moveId, String status, String errorMessage) {
+void ChessboardProtocol::sendMoveConfirm(String moveId, String status, String errorMessage, String move, long durationMs) {
     DynamicJsonDocument confirmData(512);
     confirmData["moveId"] = moveId;
     confirmData["status"] = status;
     confirmData["errorMessage"] = errorMessage;
+    if (move.length() > 0) {
+        confirmData["move"] = move;
+    }
+    if (durationMs >= 0) {
+        confirmData["durationMs"] = durationMs;
+    }
     
     sendMessage(MSG_TYPE_MOVE_CONFIRM, confirmData.as<JsonObject>());
     DEBUG_LOG_INFO("Move confirmation sent: " + status);
 }
+
+void ChessboardProtocol::sendMoveProgress(String moveId, String move, String phase, String status, long elapsedMs) {
+    DynamicJsonDocument progressData(512);
+    progressData["moveId"] = moveId;
+    progressData["move"] = move;
+    progressData["phase"] = phase;
+    progressData["status"] = status;
+    if (elapsedMs >= 0) {
+        progressData["elapsedMs"] = elapsedMs;
+    }
+    
+    sendMessage(MSG_TYPE_MOVE_PROGRESS, progressData.as<JsonObject>());
+    DEBUG_LOG_INFO("Move progress sent: " + move + " " + phase + " " + status);
+}
+
+void ChessboardProtocol::sendMoveQueue(int depth, int capacity) {
+    DynamicJsonDocument queueData(256);
+    queueData["depth"] = depth;
+    queueData["capacity"] = capacity;
+    
+    sendMessage(MSG_TYPE_MOVE_QUEUE, queueData.as<JsonObject>());
+    DEBUG_LOG_INFO("Move queue sent: " + String(depth) + "/" + String(capacity));
+}
+
+// "MOVE_EVT:<id>:<move>:<event>[:<detail>]" from the Mega: QUEUED, CANCELLED:<reason>, ACCEPTED,
+// REJECTED:<reason>, START:<phase>, END:<phase>:<ms>, DONE:<ms>, ERROR:<reason>, RESUMED, ABORTED.
+// "MOVE_QUEUE:<depth>:<capacity>" becomes MOVE_QUEUE. The other messages are only logged.
+void ChessboardProtocol::handleMegaMessage(String message) {
+    if (message.startsWith(MEGA_MOVE_QUEUE_PREFIX)) {
+        String fields = message.substring(strlen(MEGA_MOVE_QUEUE_PREFIX));
+        int colon = fields.indexOf(':');
+        if (colon == -1) {
+            DEBUG_LOG_ERROR("Invalid move queue: " + message);
+            return;
+        }
+        sendMoveQueue(fields.substring(0, colon).toInt(), fields.substring(colon + 1).toInt());
+        return;
+    }
+    if (!message.startsWith(MEGA_MOVE_EVENT_PREFIX)) {
+        DEBUG_LOG_INFO("Mega: " + message);
+        return;
+    }
+    String fields = message.substring(strlen(MEGA_MOVE_EVENT_PREFIX));
+    int idEnd = fields.indexOf(':');
+    int moveEnd = idEnd == -1 ? -1 : fields.indexOf(':', idEnd + 1);
+    if (moveEnd == -1) {
+        DEBUG_LOG_ERROR("Invalid move event: " + message);
+        return;
+    }
+    String moveId = fields.substring(0, idEnd);
+    String move = fields.substring(idEnd + 1, moveEnd);
+    String event = fields.substring(moveEnd + 1);
+    int detailStart = event.indexOf(':');
+    String detail = detailStart == -1 ? "" : event.substring(detailStart + 1);
+    if (detailStart != -1) {
+        event = event.substring(0, detailStart);
+    }
+
+    if (event == "QUEUED") {
+        sendMoveProgress(moveId, move, "", MOVE_PROGRESS_QUEUED);
+    } else if (event == "CANCELLED") {
+        sendMoveConfirm(moveId, MOVE_STATUS_CANCELLED, detail, move);
+    } else if (event == "ACCEPTED") {
+        sendMoveConfirm(moveId, MOVE_STATUS_ACCEPTED, "", move);
+    } else if (event == "REJECTED") {
+        sendMoveConfirm(moveId, MOVE_STATUS_REJECTED, detail, move);
+    } else if (event == "START") {
+        sendMoveProgress(moveId, move, detail, MOVE_PROGRESS_STARTED);
+    } else if (event == "END") {
+        // "<phase>:<ms>"
+        int colon = detail.indexOf(':');
+        String phase = colon == -1 ? detail : detail.substring(0, colon);
+        long elapsed = colon == -1 ? -1 : detail.substring(colon + 1).toInt();
+        sendMoveProgress(moveId, move, phase, MOVE_PROGRESS_FINISHED, elapsed);
+    } else if (event == "DONE") {
+        sendMoveConfirm(moveId, MOVE_STATUS_COMPLETED, "", move, detail.toInt());
+    } else if (event == "ERROR") {
+        sendMoveConfirm(moveId, MOVE_STATUS_FAILED, detail, move);
+    } else if (event == "RESUMED") {
+        sendMoveProgress(moveId, move, "", MOVE_PROGRESS_RESUMED);
+    } else if (event == "ABORTED") {
+        sendMoveConfirm(moveId, MOVE_STATUS_ABORTED, "", move);
+    } else {
+        DEBUG_LOG_ERROR("Unknown move event: " + message);
+    }
+}
@@ -43,7 +43,12 @@ public:
     // Move detection
     void detectMove();
     void handleMoveDetected(JsonObject data);
-    void sendMoveConfirm(String moveId, String status, String errorMessage = "");
+    void sendMoveConfirm(String moveId, String status, String errorMessage = "", String move = "", long durationMs = -1);
+    void sendMoveProgress(String moveId, String move, String phase, String status, long elapsedMs = -1);
+    void sendMoveQueue(int depth, int capacity);
+    
+    // Messages of the Mega (ChessLink), the move events are relayed as MOVE_CONFIRM/MOVE_PROGRESS
+    void handleMegaMessage(String message);
     
     // LED control
     void handleLEDControl(JsonObject data);
@@ -39,6 +39,8 @@
 #define MSG_TYPE_WIFI_STATUS "WIFI_STATUS"
 #define MSG_TYPE_MOVE_DETECTED "MOVE_DETECTED"
 #define MSG_TYPE_MOVE_CONFIRM "MOVE_CONFIRM"
+#define MSG_TYPE_MOVE_PROGRESS "MOVE_PROGRESS"
+#define MSG_TYPE_MOVE_QUEUE "MOVE_QUEUE"
 #define MSG_TYPE_GAME_STATE "GAME_STATE"
 #define MSG_TYPE_LED_CONTROL "LED_CONTROL"
 #define MSG_TYPE_HAPTIC_FEEDBACK "HAPTIC_FEEDBACK"
@@ -70,6 +72,25 @@
 #define SETUP_STATUS_COMPLETED "COMPLETED"
 #define SETUP_STATUS_FAILED "FAILED"
 
+// Move Status Codes (MOVE_CONFIRM)
+#define MOVE_STATUS_ACCEPTED "MOVE_ACCEPTED"
+#define MOVE_STATUS_REJECTED "MOVE_REJECTED"
+#define MOVE_STATUS_COMPLETED "MOVE_COMPLETED"
+#define MOVE_STATUS_FAILED "MOVE_FAILED"
+#define MOVE_STATUS_ABORTED "MOVE_ABORTED"
+#define MOVE_STATUS_CANCELLED "MOVE_CANCELLED"
+
+// Move Progress Codes (MOVE_PROGRESS)
+#define MOVE_PROGRESS_QUEUED "QUEUED"
+#define MOVE_PROGRESS_STARTED "STARTED"
+#define MOVE_PROGRESS_FINISHED "FINISHED"
+#define MOVE_PROGRESS_RESUMED "RESUMED"
+
+// Move events of the Mega on the ChessLink link, "MOVE_EVT:<id>:<move>:<event>[:<detail>]"
+#define MEGA_MOVE_EVENT_PREFIX "MOVE_EVT:"
+// Depth of the move queue of the Mega, "MOVE_QUEUE:<depth>:<capacity>"
+#define MEGA_MOVE_QUEUE_PREFIX "MOVE_QUEUE:"
+
 // WiFi Status Codes
 #define WIFI_STATUS_CONNECTING "connecting"
 #define WIFI_STATUS_CONNECTED "connected"
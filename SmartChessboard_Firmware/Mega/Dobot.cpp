@@ -21,7 +21,29 @@
 #include "stdio.h"
 #include "Dobot.h"
 #include "HardwareSerial.h"
-#include "arduino.h"
+#include <Arduino.h>
+#include "DobotSerial.h"
+
+// Params last queued by the Batch functions, they are queued again only when they change
+static struct {
+    PTPCommonParams common;
+    PTPJumpParams jump;
+    bool isCommonKnown;
+    bool isJumpKnown;
+} gBatchParams;
+
+// Last pose read from the Dobot and when, dropped by every motion command
+static struct {
+    Pose pose;
+    uint32_t time;
+    bool isValid;
+} gPoseSnapshot;
+
+// Function last set on each EIO port, a port is configured again only when it changes
+static struct {
+    uint8_t function[IO_PORT_NUM];
+    uint32_t isKnown;                   // One bit per port
+} gIOMultiplexing;
 
 /*********************************************************************************************************
 ** Function name:       Dobot_GetDeviceTimeEX
@@ -63,12 +85,14 @@ float Dobot_GetPose(Pos temp)
     static Pose pose;
     static float poseL;
 
-    GetPose(&pose);
+    // L has its own request, the pose is not needed for it
+    if (temp == L) {
+        GetPoseL(&poseL);
+        return poseL;
+    }
+    Dobot_GetPoseSnapshot(pose);
 
     switch(temp){
-        case L:
-            GetPoseL(&poseL);
-            return poseL;
         case X:
             return pose.x;
         break;
@@ -100,17 +124,47 @@ float Dobot_GetPose(Pos temp)
     return 0;
 }
 
+/*********************************************************************************************************
+** Function name:       Dobot_GetPoseSnapshot
+** Descriptions:        Get X, Y, Z, R and the joint angles with one GetPose round trip. The pose read
+**                      last is returned without asking the Dobot if it is at most maxAgeMs old and
+**                      no motion command was sent since; maxAgeMs = 0 always asks
+** Input parameters:    maxAgeMs: freshness window in ms
+** Output parameters:   pose
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_GetPoseSnapshot(Pose &pose,uint32_t maxAgeMs)
+{
+    uint32_t now = millis();
+
+    if (maxAgeMs == 0 || gPoseSnapshot.isValid == false || now - gPoseSnapshot.time > maxAgeMs) {
+        CmdStatus status = GetPose(&gPoseSnapshot.pose);
+
+        gPoseSnapshot.isValid = status == CmdStatusOk;
+        if (status != CmdStatusOk) {
+            return status;
+        }
+        gPoseSnapshot.time = now;
+    }
+    pose = gPoseSnapshot.pose;
+    return CmdStatusOk;
+}
+
 /*********************************************************************************************************
 ** Function name:       Dobot_SetHOMECmd
-** Descriptions:        SetHome
+** Descriptions:        SetHome, wait for the homing to end
 ** Input parameters:    none
 ** Output parameters:   none
-** Returned value:      none
+** Returned value:      CmdStatusOk once the arm is homed, else the status of the command or of the wait
 *********************************************************************************************************/
-void Dobot_SetHOMECmd(void)
+CmdStatus Dobot_SetHOMECmd(void)
 {
-    SetHomeCmd();
-    WaitQueuedCmdFinished();
+    gPoseSnapshot.isValid = false;
+    CmdStatus status = SetHomeCmd();
+    if (status != CmdStatusOk) {
+        return status;
+    }
+    return WaitQueuedCmdFinished();
 }
 
 /*********************************************************************************************************
@@ -163,16 +217,16 @@ void Dobot_SetEndEffectorSuctionCup(bool issuck)
 ** Descriptions:        Set Gripper
 ** Input parameters:    isEnable,isGriped
 ** Output parameters:   none
-** Returned value:      none
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-void Dobot_SetEndEffectorGripper(bool isEnable,bool isGriped)
+CmdStatus Dobot_SetEndEffectorGripper(bool isEnable,bool isGriped)
 {
     static EndEffectorGripper endEffectorGripper;
 
     endEffectorGripper.isEnable = isEnable;
     endEffectorGripper.isGriped = isGriped;
 
-    SeEndEffectorGritpper(&endEffectorGripper);
+    return SeEndEffectorGritpper(&endEffectorGripper);
 }
 
 /*********************************************************************************************************
@@ -258,6 +312,7 @@ void Dobot_SetJOGCmd(uint8_t model)
         jogCmd.cmd = model;
     }
 
+    gPoseSnapshot.isValid = false;
     SetJOGCmd(&jogCmd);
 }
 
@@ -276,6 +331,26 @@ void Dobot_SetPTPCommonParams(float velocityRatio,float accelerationRatio)
     ptpCommonParams.accelerationRatio = accelerationRatio;
 
     SetPTPCommonParams(&ptpCommonParams);
+    gBatchParams.isCommonKnown = false;
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_SetPTPCoordinateParams
+** Descriptions:        Set the Cartesian velocity and acceleration, scaled by the common ratios
+** Input parameters:    xyzVelocity,rVelocity,xyzAcceleration,rAcceleration
+** Output parameters:   none
+** Returned value:      none
+*********************************************************************************************************/
+void Dobot_SetPTPCoordinateParams(float xyzVelocity,float rVelocity,float xyzAcceleration,float rAcceleration)
+{
+    static PTPCoordinateParams ptpCoordinateParams;
+
+    ptpCoordinateParams.xyzVelocity = xyzVelocity;
+    ptpCoordinateParams.rVelocity = rVelocity;
+    ptpCoordinateParams.xyzAcceleration = xyzAcceleration;
+    ptpCoordinateParams.rAcceleration = rAcceleration;
+
+    SetPTPCoordinateParams(&ptpCoordinateParams);
 }
 
 /*********************************************************************************************************
@@ -292,7 +367,7 @@ void Dobot_SetPTPJointParams(float velocityJ1,float accelerationJ1,float velocit
     ptpJointParams.velocity[0] = velocityJ1;
     ptpJointParams.acceleration[0] = accelerationJ1;
     ptpJointParams.velocity[1] = velocityJ2;
-    ptpJointParams.acceleration[10] = accelerationJ2;
+    ptpJointParams.acceleration[1] = accelerationJ2;
     ptpJointParams.velocity[2] = velocityJ3;
     ptpJointParams.acceleration[2] = accelerationJ3;
     ptpJointParams.velocity[3] = velocityJ4;
@@ -333,6 +408,7 @@ void Dobot_SetPTPJumpParams(float jumpHeight)
     ptpJumpParams.zLimit = 100;
 
     SetPTPJumpParams(&ptpJumpParams);
+    gBatchParams.isJumpKnown = false;
 }
 
 /*********************************************************************************************************
@@ -340,20 +416,15 @@ void Dobot_SetPTPJumpParams(float jumpHeight)
 ** Descriptions:        Wait For PTPMove
 ** Input parameters:    Model,X,Y,Z,R
 ** Output parameters:   none
-** Returned value:      none
+** Returned value:      CmdStatusOk once the arm is there, else the status of the command or of the wait
 *********************************************************************************************************/
-void Dobot_SetPTPCmd(uint8_t Model,float x,float y,float z,float r)
+CmdStatus Dobot_SetPTPCmd(uint8_t Model,float x,float y,float z,float r)
 {
-    static PTPCmd ptpCmd;
-
-    ptpCmd.ptpMode = Model;
-    ptpCmd.x = x;
-    ptpCmd.y = y;
-    ptpCmd.z = z;
-    ptpCmd.rHead = r;
-
-    SetPTPCmd(&ptpCmd);
-    WaitQueuedCmdFinished();
+    CmdStatus status = Dobot_BatchPTPCmd(Model, x, y, z, r);
+    if (status != CmdStatusOk) {
+        return status;
+    }
+    return Dobot_BatchWait();
 }
 
 /*********************************************************************************************************
@@ -374,10 +445,373 @@ void Dobot_SetPTPWithLCmd(uint8_t Model,float x,float y,float z,float r,float l)
     ptpWithLCmd.rHead = r;
     ptpWithLCmd.l = l;
 
+    gPoseSnapshot.isValid = false;
     SetPTPCmdWithL(&ptpWithLCmd);
     WaitQueuedCmdFinished();
 }
 
+/*********************************************************************************************************
+** Function name:       Dobot_SetCPParams
+** Descriptions:        Set the continuous path acceleration and the speed kept through the junctions
+** Input parameters:    planAcc,junctionVel,acc,realTimeTrack
+** Output parameters:   none
+** Returned value:      none
+*********************************************************************************************************/
+void Dobot_SetCPParams(float planAcc,float junctionVel,float acc,uint8_t realTimeTrack)
+{
+    static CPParams cpParams;
+
+    cpParams.planAcc = planAcc;
+    cpParams.juncitionVel = junctionVel;
+    cpParams.acc = acc;
+    cpParams.realTimeTrack = realTimeTrack;
+
+    SetCPParams(&cpParams);
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchPTPCmd
+** Descriptions:        Queue a PTP point without waiting, the controller blends it with the next one
+** Input parameters:    Model,X,Y,Z,R
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchPTPCmd(uint8_t Model,float x,float y,float z,float r)
+{
+    static PTPCmd ptpCmd;
+
+    ptpCmd.ptpMode = Model;
+    ptpCmd.x = x;
+    ptpCmd.y = y;
+    ptpCmd.z = z;
+    ptpCmd.rHead = r;
+
+    gPoseSnapshot.isValid = false;
+    return SetPTPCmd(&ptpCmd);
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchCPCmd
+** Descriptions:        Queue a continuous path point, the arm runs through it without stopping
+**                      as long as the next queued command is a CP point too
+** Input parameters:    Model: CPRelativeMode or CPAbsoluteMode,X,Y,Z,velocity
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchCPCmd(uint8_t Model,float x,float y,float z,float velocity)
+{
+    static CPCmd cpCmd;
+
+    cpCmd.cpMode = Model;
+    cpCmd.x = x;
+    cpCmd.y = y;
+    cpCmd.z = z;
+    cpCmd.velocity = velocity;
+
+    gPoseSnapshot.isValid = false;
+    return SetCPCmd(&cpCmd);
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchPTPCommonParams
+** Descriptions:        Queue the velocity and acceleration ratios of the PTP points queued after them,
+**                      nothing is sent if they are the ones queued last
+** Input parameters:    velocityRatio,accelerationRatio: % of the joint and coordinate params
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchPTPCommonParams(float velocityRatio,float accelerationRatio)
+{
+    PTPCommonParams *common = &gBatchParams.common;
+
+    if (gBatchParams.isCommonKnown && common->velocityRatio == velocityRatio &&
+        common->accelerationRatio == accelerationRatio) {
+        return CmdStatusOk;
+    }
+    common->velocityRatio = velocityRatio;
+    common->accelerationRatio = accelerationRatio;
+
+    CmdStatus status = SetQueuedPTPCommonParams(common);
+    gBatchParams.isCommonKnown = status == CmdStatusOk;
+    return status;
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchPTPJumpParams
+** Descriptions:        Queue the jump params of the JUMP points queued after them,
+**                      nothing is sent if they are the ones queued last
+** Input parameters:    jumpHeight: lift above the higher end of the hop,zLimit: highest Z of the hop
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchPTPJumpParams(float jumpHeight,float zLimit)
+{
+    PTPJumpParams *jump = &gBatchParams.jump;
+
+    if (gBatchParams.isJumpKnown && jump->jumpHeight == jumpHeight && jump->zLimit == zLimit) {
+        return CmdStatusOk;
+    }
+    jump->jumpHeight = jumpHeight;
+    jump->zLimit = zLimit;
+
+    CmdStatus status = SetQueuedPTPJumpParams(jump);
+    gBatchParams.isJumpKnown = status == CmdStatusOk;
+    return status;
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchEndEffectorGripper
+** Descriptions:        Queue a gripper output behind the pending points
+** Input parameters:    isEnable,isGriped
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchEndEffectorGripper(bool isEnable,bool isGriped)
+{
+    static EndEffectorGripper endEffectorGripper;
+
+    endEffectorGripper.isEnable = isEnable;
+    endEffectorGripper.isGriped = isGriped;
+
+    return SetQueuedEndEffectorGripper(&endEffectorGripper);
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchDwell
+** Descriptions:        Queue a pause, the controller holds the arm for ms once the commands queued
+**                      before it are done, and the Mega does not wait for it
+** Input parameters:    ms
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchDwell(uint32_t ms)
+{
+    static WAITCmd waitCmd;
+    CmdStatus status;
+
+    // Long pauses are split, so the queue index moves before WaitQueuedCmdFinished takes it as stalled
+    do {
+        waitCmd.timeout = ms < QUEUED_CMD_STALL_TIMEOUT / 2 ? ms : QUEUED_CMD_STALL_TIMEOUT / 2;
+        ms -= waitCmd.timeout;
+        status = SetWAITCmd(&waitCmd);
+    } while (status == CmdStatusOk && ms > 0);
+    return status;
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchWait
+** Descriptions:        Wait for the last queued command of the batch
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchWait(void)
+{
+    return WaitQueuedCmdFinished();
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchIndex
+** Descriptions:        Queue index of the last command of the batch, to follow its progress
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      Queue index
+*********************************************************************************************************/
+uint64_t Dobot_BatchIndex(void)
+{
+    return GetQueuedCmdWriteIndex();
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchReserve
+** Descriptions:        Wait until count more commands can be queued with at most lookahead commands
+**                      waiting in the Dobot queue, so a long batch streams in while the arm runs it
+** Input parameters:    count: commands about to be queued,lookahead: most commands not finished
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchReserve(uint8_t count,uint8_t lookahead)
+{
+    return WaitQueuedCmdSpace(count, lookahead);
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchWaitIndex
+** Descriptions:        Wait for the queued command of the given index, the ones after it keep running
+** Input parameters:    index: a Dobot_BatchIndex value
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchWaitIndex(uint64_t index)
+{
+    return WaitQueuedCmdIndex(index);
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchDoneIndex
+** Descriptions:        Queue index of the last command the arm had finished when the index was last read
+**                      by Dobot_BatchReserve, Dobot_BatchWait* or Dobot_BatchPoll, no command is sent
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      Queue index
+*********************************************************************************************************/
+uint64_t Dobot_BatchDoneIndex(void)
+{
+    return GetQueuedCmdDoneIndex();
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchPoll
+** Descriptions:        Follow the batch without waiting, for a loop that keeps serving other work while
+**                      the arm moves: Dobot_BatchDoneIndex and Dobot_BatchHasRoom move on as the replies come
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      CmdStatus, CmdStatusAlarm or CmdStatusStalled as the waits
+*********************************************************************************************************/
+CmdStatus Dobot_BatchPoll(void)
+{
+    return PollQueuedCmdProgress();
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchHasRoom
+** Descriptions:        Whether count more commands fit in the lookahead, Dobot_BatchReserve without the wait
+** Input parameters:    count,lookahead
+** Output parameters:   none
+** Returned value:      true if they fit
+*********************************************************************************************************/
+bool Dobot_BatchHasRoom(uint8_t count,uint8_t lookahead)
+{
+    return HasQueuedCmdSpace(count, lookahead);
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_BatchAbort
+** Descriptions:        Stop the arm, drop the rest of the batch and make the queue ready for a new one
+** Input parameters:    none
+** Output parameters:   doneIndex: queue index reached before the stop, left as is on error
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_BatchAbort(uint64_t *doneIndex)
+{
+    // The params queued after the stop are dropped, the controller keeps the last ones it ran
+    gBatchParams.isCommonKnown = false;
+    gBatchParams.isJumpKnown = false;
+    gPoseSnapshot.isValid = false;
+
+    CmdStatus status = SetQueuedCmdForceStopExec();
+
+    if (status == CmdStatusOk) {
+        status = GetQueuedCmdCurrentIndex(doneIndex);
+    }
+    if (status == CmdStatusOk) {
+        status = SetQueuedCmdClear();
+    }
+    if (status == CmdStatusOk) {
+        status = SetQueuedCmdStartExec();
+    }
+    return status;
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_ForceStop
+** Descriptions:        Stop the arm at once, from an ISR too: the force stop goes out ahead of the queued
+**                      frames and the batch waits return CmdStatusStopped. Dobot_BatchAbort then clears the
+**                      queue and starts it again
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      false if the previous force stop is still being sent, try again once it is out
+*********************************************************************************************************/
+bool Dobot_ForceStop(void)
+{
+    return SendQueuedCmdForceStop();
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_ForceStopSentTime
+** Descriptions:        When the last Dobot_ForceStop left for the Dobot
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      micros() when its last byte was handed to the UART, 0 if none was sent
+*********************************************************************************************************/
+uint32_t Dobot_ForceStopSentTime(void)
+{
+    return DobotSerialGetUrgentSentTime();
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_GetAlarms
+** Descriptions:        Read the alarms raised by the Dobot, as alarm codes
+** Input parameters:    maxCodes: size of codes
+** Output parameters:   codes, count: codes written
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_GetAlarms(uint8_t *codes,uint8_t maxCodes,uint8_t *count)
+{
+    uint8_t alarmsState[ALARMS_STATE_SIZE];
+    uint8_t len = 0;
+
+    *count = 0;
+    CmdStatus status = GetAlarmsState(alarmsState, &len, sizeof(alarmsState));
+    for (uint8_t i = 0; i < len * 8 && *count < maxCodes; i++) {
+        if (alarmsState[i / 8] & (1 << (i % 8))) {
+            codes[(*count)++] = i;
+        }
+    }
+    return status;
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_ClearAlarms
+** Descriptions:        Clear the alarms, a raised one stops every wait on the queue until then
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_ClearAlarms(void)
+{
+    return ClearAllAlarmsState();
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_AlarmName
+** Descriptions:        Group of an alarm code, the low nibble is the detail or the axis
+** Input parameters:    code
+** Output parameters:   none
+** Returned value:      Name
+*********************************************************************************************************/
+const char *Dobot_AlarmName(uint8_t code)
+{
+    switch (code >> 4) {
+    case 0x0:
+        return code == 0 ? "RESET" : "SYSTEM";
+    case 0x1:
+        return "PLAN";              // Target out of reach or bad params, the command is skipped
+    case 0x2:
+        return "MOVE";              // Out of reach while moving
+    case 0x3:
+        return "OVERSPEED";
+    case 0x4:
+        return "LIMIT";
+    case 0x5:
+        return "LOSE STEP";         // Stalled or blocked joint
+    default:
+        return "OTHER";
+    }
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_SetAlarmWatch
+** Descriptions:        Set how often the waits on the queue read the alarms
+** Input parameters:    periodMs: 0 to never read them, then only a stalled queue is noticed
+** Output parameters:   none
+** Returned value:      none
+*********************************************************************************************************/
+void Dobot_SetAlarmWatch(uint16_t periodMs)
+{
+    SetQueuedCmdAlarmPeriod(periodMs);
+}
+
 /*********************************************************************************************************
 ** Function name:       Dobot_SetIOMultiplexingEX
 ** Descriptions:        Set IO Config
@@ -389,10 +823,53 @@ void Dobot_SetIOMultiplexing(uint8_t address,uint8_t function)
 {
     static IOConfig iOConfig;
 
+    if (address < IO_PORT_NUM && (gIOMultiplexing.isKnown & (1UL << address)) &&
+        gIOMultiplexing.function[address] == function) {
+        return;
+    }
     iOConfig.address = address;
     iOConfig.function = (IOFunction)function;
 
-    SetIOMultiplexing(&iOConfig);
+    if (SetIOMultiplexing(&iOConfig) == CmdStatusOk && address < IO_PORT_NUM) {
+        gIOMultiplexing.function[address] = function;
+        gIOMultiplexing.isKnown |= 1UL << address;
+    }
+}
+
+/*********************************************************************************************************
+** Function name:       Dobot_SetIOMultiplexingList
+** Descriptions:        Set several IO configs back to back, the ports already set to their function are skipped
+** Input parameters:    ioConfigs, count
+** Output parameters:   none
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus Dobot_SetIOMultiplexingList(const IOPortConfig *ioConfigs,uint8_t count)
+{
+    IOPortConfig changed[IO_PORT_NUM];
+    uint8_t changedCount = 0;
+
+    for (uint8_t i = 0; i < count && changedCount < IO_PORT_NUM; i++) {
+        uint8_t address = ioConfigs[i].address;
+        if (address >= IO_PORT_NUM) {
+            continue;
+        }
+        if ((gIOMultiplexing.isKnown & (1UL << address)) &&
+            gIOMultiplexing.function[address] == ioConfigs[i].function) {
+            continue;
+        }
+        changed[changedCount++] = ioConfigs[i];
+    }
+    if (changedCount == 0) {
+        return CmdStatusOk;
+    }
+    CmdStatus status = SetIOMultiplexingList(changed, changedCount);
+    if (status == CmdStatusOk) {
+        for (uint8_t i = 0; i < changedCount; i++) {
+            gIOMultiplexing.function[changed[i].address] = changed[i].function;
+            gIOMultiplexing.isKnown |= 1UL << changed[i].address;
+        }
+    }
+    return status;
 }
 
 /*********************************************************************************************************
@@ -20,7 +20,7 @@
 #define DOBOT_H
 
 #include "type.h"
-#include "Command.h"
+#include "command.h"
 #include <stdio.h>
 
 typedef enum tagPos{
@@ -45,10 +45,13 @@ typedef enum tagIOFunction {
     IOFunctionDIPD,
 } IOFunction;
 
+// EIO addresses are 0 to IO_PORT_NUM - 1
+#define IO_PORT_NUM 21
+
 /*********************************************************************************************************
 ** Device Init
 *********************************************************************************************************/
-extern void Dobot_Init();
+extern CmdStatus Dobot_Init(const IOPortConfig *ioConfigs = 0,uint8_t ioCount = 0);
 
 /*********************************************************************************************************
 ** Device function
@@ -59,8 +62,9 @@ extern void Dobot_SetDeviceWIthL(bool isWithL);
 /*********************************************************************************************************
 ** Home function
 *********************************************************************************************************/
-extern void Dobot_SetHOMECmd(void);
+extern CmdStatus Dobot_SetHOMECmd(void);
 extern float Dobot_GetPose(Pos p);
+extern CmdStatus Dobot_GetPoseSnapshot(Pose &pose,uint32_t maxAgeMs = 0);
 
 /*********************************************************************************************************
 ** EndEffector function
@@ -68,7 +72,7 @@ extern float Dobot_GetPose(Pos p);
 extern void Dobot_SetEndEffectorParams(float x,float y,float z);
 extern void Dobot_SetEndEffectorLaser(uint8_t isEnable,float power);
 extern void Dobot_SetEndEffectorSuctionCup(bool issuck);
-extern void Dobot_SetEndEffectorGripper(bool isEnable,bool isGriped);
+extern CmdStatus Dobot_SetEndEffectorGripper(bool isEnable,bool isGriped);
 
 /*********************************************************************************************************
 ** JOG function
@@ -82,16 +86,51 @@ extern void Dobot_SetJOGCmd(uint8_t model);
 ** PTP function
 *********************************************************************************************************/
 extern void Dobot_SetPTPCommonParams(float velocityRatio,float accelerationRatio);
+extern void Dobot_SetPTPCoordinateParams(float xyzVelocity,float rVelocity,float xyzAcceleration,float rAcceleration);
 extern void Dobot_SetPTPJointParams(float velocityJ1,float accelerationJ1,float velocityJ2,float accelerationJ2,float velocityJ3,float accelerationJ3,float velocityJ4,float accelerationJ4);
 extern void Dobot_SetPTPLParams(float velocityRatio,float accelerationRatio);
 extern void Dobot_SetPTPJumpParams(float jumpHeight);
-extern void Dobot_SetPTPCmd(uint8_t Model,float x,float y,float z,float r);
+extern CmdStatus Dobot_SetPTPCmd(uint8_t Model,float x,float y,float z,float r);
 extern void Dobot_SetPTPWithLCmd(uint8_t Model,float x,float y,float z,float r,float l);
 
+/*********************************************************************************************************
+** CP function
+*********************************************************************************************************/
+extern void Dobot_SetCPParams(float planAcc,float junctionVel,float acc,uint8_t realTimeTrack);
+
+/*********************************************************************************************************
+** Batch function
+*********************************************************************************************************/
+extern CmdStatus Dobot_BatchPTPCmd(uint8_t Model,float x,float y,float z,float r);
+extern CmdStatus Dobot_BatchCPCmd(uint8_t Model,float x,float y,float z,float velocity);
+extern CmdStatus Dobot_BatchPTPCommonParams(float velocityRatio,float accelerationRatio);
+extern CmdStatus Dobot_BatchPTPJumpParams(float jumpHeight,float zLimit);
+extern CmdStatus Dobot_BatchEndEffectorGripper(bool isEnable,bool isGriped);
+extern CmdStatus Dobot_BatchDwell(uint32_t ms);
+extern CmdStatus Dobot_BatchWait(void);
+extern uint64_t Dobot_BatchIndex(void);
+extern CmdStatus Dobot_BatchReserve(uint8_t count,uint8_t lookahead);
+extern CmdStatus Dobot_BatchWaitIndex(uint64_t index);
+extern uint64_t Dobot_BatchDoneIndex(void);
+extern CmdStatus Dobot_BatchPoll(void);
+extern bool Dobot_BatchHasRoom(uint8_t count,uint8_t lookahead);
+extern CmdStatus Dobot_BatchAbort(uint64_t *doneIndex);
+extern bool Dobot_ForceStop(void);
+extern uint32_t Dobot_ForceStopSentTime(void);
+
+/*********************************************************************************************************
+** Alarm function
+*********************************************************************************************************/
+extern CmdStatus Dobot_GetAlarms(uint8_t *codes,uint8_t maxCodes,uint8_t *count);
+extern CmdStatus Dobot_ClearAlarms(void);
+extern const char *Dobot_AlarmName(uint8_t code);
+extern void Dobot_SetAlarmWatch(uint16_t periodMs);
+
 /*********************************************************************************************************
 ** EIO function
 *********************************************************************************************************/
 extern void Dobot_SetIOMultiplexing(uint8_t address,uint8_t function);
+extern CmdStatus Dobot_SetIOMultiplexingList(const IOPortConfig *ioConfigs,uint8_t count);
 extern void Dobot_SetIODO(uint8_t address,uint8_t value);
 extern void Dobot_SetIOPWM(uint8_t address,float freq,float duty);
 extern uint8_t Dobot_GetIODI(uint8_t address);
@@ -0,0 +1,103 @@
+/****************************************Copyright(c)*****************************************************
+**                            Shenzhen Yuejiang Technology Co., LTD.
+**
+**                                 http://www.dobot.cc
+**
+**--------------File Info---------------------------------------------------------------------------------
+** File name:           DobotCmd.h
+** Latest modified Date:
+** Latest Version:      V1.0.0
+** Descriptions:        Typed command descriptor
+**
+**--------------------------------------------------------------------------------------------------------
+** Created by:
+** Created date:        2026-10-17
+** Version:             V1.0.0
+** Descriptions:
+**--------------------------------------------------------------------------------------------------------
+*********************************************************************************************************/
+#ifndef DOBOTCMD_H
+#define DOBOTCMD_H
+
+#include <stdint.h>
+#include "Protocol.h"
+#include "command.h"
+
+typedef enum tagCmdMode {
+    CmdGet,                             // rw = 0
+    CmdSet,                             // rw = 1
+    CmdQueued                           // rw = 1, isQueued = 1, the echo is the queue index
+}CmdMode;
+
+// No params to send, or no result to read back
+typedef struct tagCmdNone {
+}CmdNone;
+
+template <typename T>
+struct CmdSize {
+    enum { value = sizeof(T) };
+};
+
+template <>
+struct CmdSize<CmdNone> {
+    enum { value = 0 };
+};
+
+/*********************************************************************************************************
+** Function name:       CommandExec
+** Descriptions:        Send a command and wait its echo, shared by all the DobotCmd
+** Input parameters:    id, mode, params, paramsLen, resultLen, timeout: deadline in ms of a single try
+** Output parameters:   result: may be 0
+** Returned value:      CmdStatus, after the retries set by SetCmdRetryPolicy
+*********************************************************************************************************/
+extern CmdStatus CommandExec(uint8_t id, uint8_t mode, const void *params, uint8_t paramsLen,
+                             void *result, uint8_t resultLen, uint32_t timeout);
+
+/*********************************************************************************************************
+** Function name:       CommandSubmit
+** Descriptions:        Send a command without waiting its echo
+** Input parameters:    id, mode, params, paramsLen, timeout: deadline in ms of the echo
+** Output parameters:   None
+** Returned value:      Request slot, -1 if none is free or the frame could not be queued
+*********************************************************************************************************/
+extern int8_t CommandSubmit(uint8_t id, uint8_t mode, const void *params, uint8_t paramsLen, uint32_t timeout);
+
+/*********************************************************************************************************
+** Function name:       CommandRead
+** Descriptions:        Read the echo of a submitted command, the slot is freed unless it is still pending
+** Input parameters:    request, resultLen
+** Output parameters:   result
+** Returned value:      RequestState
+*********************************************************************************************************/
+extern RequestState CommandRead(int8_t request, void *result, uint8_t resultLen);
+
+/*
+ * One command of ProtocolID.h with its params and result types from type.h.
+ * The lengths default to the type sizes, and are given where the wire size differs.
+ * The members only forward constants to the shared functions above, so a new command costs
+ * a typedef and no code, and a wrong size is a compile error.
+ */
+template <uint8_t Id, typename Params, typename Result, uint8_t Mode,
+          uint8_t ParamsLen = CmdSize<Params>::value, uint8_t ResultLen = CmdSize<Result>::value>
+struct DobotCmd {
+    static_assert(ParamsLen <= MAX_PAYLOAD_SIZE - 2, "Params do not fit in a packet");
+    static_assert(ResultLen <= PROTOCOL_REQUEST_PARAMS_SIZE, "Result does not fit in a request slot");
+    static_assert(Mode != CmdQueued || ResultLen == sizeof(uint64_t), "A queued command echoes its queue index");
+
+    static CmdStatus Exec(const Params *params, Result *result, uint32_t timeout = CMD_ECHO_TIMEOUT)
+    {
+        return CommandExec(Id, Mode, params, ParamsLen, result, ResultLen, timeout);
+    }
+
+    static int8_t Submit(const Params *params, uint32_t timeout = CMD_ECHO_TIMEOUT)
+    {
+        return CommandSubmit(Id, Mode, params, ParamsLen, timeout);
+    }
+
+    static RequestState Read(int8_t request, Result *result)
+    {
+        return CommandRead(request, result, ResultLen);
+    }
+};
+
+#endif
@@ -16,13 +16,16 @@
 ** Descriptions:        Init Dobot
 **--------------------------------------------------------------------------------------------------------
 *********************************************************************************************************/
-#include "FlexiTimer2.h"
 #include "stdio.h"
-#include <arduino.h>
+#include <Arduino.h>
 #include "HardwareSerial.h"
 #include "Protocol.h"
 #include "Dobot.h"
 
+// The Dobot is polled until it answers, instead of a fixed pause
+#define DOBOT_READY_TIMEOUT 10000
+#define DOBOT_READY_POLL 20
+
 /*********************************************************************************************************
 ** Function name:       Serial_putc
 ** Descriptions:        Remap Serial to Printf
@@ -48,23 +51,65 @@ void printf_begin(void)
     fdevopen( &Serial_putc, 0 );
 }
 
+/*********************************************************************************************************
+** Function name:       Dobot_WaitReady
+** Descriptions:        Poll the Dobot until it answers, it may still be booting with the Mega
+** Input parameters:    timeout: ms
+** Output parameters:
+** Returned value:      true if it answered
+*********************************************************************************************************/
+static bool Dobot_WaitReady(uint32_t timeout)
+{
+    uint32_t start = millis();
+
+    do {
+        uint64_t queuedCmdIndex;
+        int8_t request = RequestQueuedCmdCurrentIndex();
+        if (request >= 0) {
+            ProtocolRequestWait(request);
+            if (ReadQueuedCmdCurrentIndex(request, &queuedCmdIndex) == RequestDone) {
+                return true;
+            }
+        }
+        delay(DOBOT_READY_POLL);
+    } while (millis() - start < timeout);
+    return false;
+}
+
 /*********************************************************************************************************
 ** Function name:       Dobot_Init
-** Descriptions:        Init Dobot
-** Input parameters:    
+** Descriptions:        Init Dobot, as soon as it answers, and print the boot-to-ready time
+** Input parameters:    ioConfigs: EIO ports used by the application, ioCount: may be 0
 ** Output parameters:
-** Returned value:      
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-void Dobot_Init()
+CmdStatus Dobot_Init(const IOPortConfig *ioConfigs, uint8_t ioCount)
 {
-    SERIALNUM.begin(115200);
-    delay(1000);
+    uint32_t start = millis();
 
+    // Also starts the Dobot UART
     ProtocolInit();
 
     Serial.println("Dobot Init");
-    for(int i = 0; i < 21; i++){
-        Dobot_SetIOMultiplexing(i,IOFunctionDI);
+    if (Dobot_WaitReady(DOBOT_READY_TIMEOUT) == false) {
+        Serial.println("[ERROR]Dobot not answering");
+        return CmdStatusTimeout;
     }
-    SetQueuedCmdStartExec();
+    // The alarms of an earlier session would stop the first wait on the queue
+    CmdStatus status = Dobot_ClearAlarms();
+    // Only the ports the application uses, sent back to back
+    if (status == CmdStatusOk) {
+        status = Dobot_SetIOMultiplexingList(ioConfigs, ioCount);
+    }
+    if (status == CmdStatusOk) {
+        status = SetQueuedCmdStartExec();
+    }
+
+    uint32_t now = millis();
+    Serial.print("Dobot ready in ");
+    Serial.print(now - start);
+    Serial.print(" ms, ");
+    Serial.print(now);
+    Serial.println(" ms from boot");
+    return status;
 }
@@ -513,7 +513,7 @@ int VIS::DobotMove(uint8_t Model,
     Pose p;
     Dobot_SetPTPCmd(Model, x, y, z, r);     // The position of a target object
     delay(500);
-    GetPose(&p);
+    Dobot_GetPoseSnapshot(p);               // Fresh pose, the move above dropped the last one
 #ifdef __DEBUG
     Serial.print("move: ");
     Serial.print(x);
@@ -553,7 +553,7 @@ char VIS::Run(void)
     int signature = 0;
     Pose p;
     PBLOCKPARM ptr = NULL;
-    GetPose(&p);
+    Dobot_GetPoseSnapshot(p, PoseMaxAge);  // The pose read by the last DobotMove, if recent
     delay(500);
     if (FloatEqual(p.x, gVISAT.x, 0.01) == FALSE || FloatEqual(p.y, gVISAT.y, 0.01) == FALSE || FloatEqual(p.z, gVISAT.z, 0.01) == FALSE)		/* �жϵ�ǰ���� */
     {
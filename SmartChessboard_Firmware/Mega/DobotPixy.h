@@ -5,6 +5,7 @@
 #include "SmartKitType.h"
 
 #define BlockMaxNum 10
+#define PoseMaxAge  1000  // ms a pose read by DobotMove is reused by Run
 
 #ifndef __DEBUG
 #define __DEBUG
@@ -0,0 +1,294 @@
+/****************************************Copyright(c)*****************************************************
+**                            Shenzhen Yuejiang Technology Co., LTD.
+**
+**                                 http://www.dobot.cc
+**
+**--------------File Info---------------------------------------------------------------------------------
+** File name:           DobotSerial.cpp
+** Latest modified Date:
+** Latest Version:      V1.0.0
+** Descriptions:        Interrupt driven UART2 link to the Dobot
+**
+**--------------------------------------------------------------------------------------------------------
+** Created by:
+** Created date:        2026-10-17
+** Version:             V1.0.0
+** Descriptions:
+**--------------------------------------------------------------------------------------------------------
+*********************************************************************************************************/
+#include "DobotSerial.h"
+#ifdef __AVR__
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#endif
+#include "ProtocolDef.h"
+#include <Arduino.h>
+
+// The RX queue has a single producer (the ISR) and a single consumer (the parser),
+// and its 8-bit addresses are read and written atomically, so no lock is needed.
+// The TX queue is the same with the roles swapped: MessageWrite fills it, the TX ISR drains it
+static RingBuffer *gRxQueue;
+static RingBuffer *gTxQueue;
+
+// Frame end tracking, the ISR only follows sync bytes and payload length
+enum {
+    FrameSyncByte1,
+    FrameSyncByte2,
+    FramePayloadLen,
+    FrameBody
+};
+static uint8_t gFrameState;
+static uint8_t gFrameLeft;
+static volatile uint8_t gFrameCount;
+
+// Bytes of the queued frame on the wire not sent yet, an urgent frame only goes out at 0.
+// MessageWrite publishes a whole frame with one commit, so its length is there with its first byte
+static uint8_t gTxFrameLeft;
+// Set by DobotSerialSendUrgent, possibly from an ISR, cleared by the TX ISR once sent
+static const uint8_t * volatile gUrgentFrame;
+static volatile uint8_t gUrgentLen;
+static volatile uint8_t gUrgentPos;
+static volatile uint32_t gUrgentSentTime;
+
+/*********************************************************************************************************
+** Function name:       DobotSerialInit
+** Descriptions:        Open the Dobot port and start feeding the RX queue
+** Input parameters:    baudrate, rxQueue: filled by the RX ISR, txQueue: drained by the TX ISR, elemSize 1
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void DobotSerialInit(uint32_t baudrate, RingBuffer *rxQueue, RingBuffer *txQueue)
+{
+    gRxQueue = rxQueue;
+    gTxQueue = txQueue;
+    gFrameState = FrameSyncByte1;
+    gFrameCount = 0;
+    gTxFrameLeft = 0;
+    gUrgentFrame = 0;
+
+    DobotSerialPortOpen(baudrate);
+}
+
+/*********************************************************************************************************
+** Function name:       DobotSerialSend
+** Descriptions:        Start sending the TX queue in the background, call it after queueing bytes
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void DobotSerialSend(void)
+{
+    if (RingBufferIsEmpty(gTxQueue) == false) {
+        DobotSerialPortStartTx();
+    }
+}
+
+/*********************************************************************************************************
+** Function name:       DobotSerialTransmit
+** Descriptions:        Take the next byte to send, urgent frame first, called by the port layer
+** Input parameters:    None
+** Output parameters:   data
+** Returned value:      false if there is nothing to send
+*********************************************************************************************************/
+bool DobotSerialTransmit(uint8_t *data)
+{
+    const uint8_t *urgentFrame = gUrgentFrame;
+
+    if (gTxFrameLeft == 0 && urgentFrame) {
+        uint8_t pos = gUrgentPos;
+        *data = urgentFrame[pos++];
+        gUrgentPos = pos;
+        if (pos == gUrgentLen) {
+            gUrgentSentTime = micros();
+            gUrgentFrame = 0;
+        }
+        return true;
+    }
+    if (RingBufferIsEmpty(gTxQueue)) {
+        return false;
+    }
+    if (gTxFrameLeft == 0) {
+        // Sync bytes, length byte, payload and checksum
+        gTxFrameLeft = *(uint8_t *)RingBufferDataAt(gTxQueue, 2) + 4;
+    }
+    *data = *(uint8_t *)RingBufferDataAt(gTxQueue, 0);
+    RingBufferCommitRead(gTxQueue, 1);
+    gTxFrameLeft--;
+    return true;
+}
+
+/*********************************************************************************************************
+** Function name:       DobotSerialSendUrgent
+** Descriptions:        Send a frame ahead of the TX queue, between two queued frames. Safe in an ISR
+** Input parameters:    frame: kept until sent, len
+** Output parameters:   None
+** Returned value:      false if an urgent frame is still being sent, this one is dropped
+*********************************************************************************************************/
+bool DobotSerialSendUrgent(const uint8_t *frame, uint8_t len)
+{
+    if (gUrgentFrame) {
+        return false;
+    }
+    gUrgentLen = len;
+    gUrgentPos = 0;
+    // Published last, the TX ISR takes the frame once the pointer is set
+    gUrgentFrame = frame;
+    DobotSerialPortStartTx();
+    return true;
+}
+
+/*********************************************************************************************************
+** Function name:       DobotSerialGetUrgentSentTime
+** Descriptions:        Time the last byte of the last urgent frame was handed to the port
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      micros() at that time, 0 if no urgent frame was sent yet
+*********************************************************************************************************/
+uint32_t DobotSerialGetUrgentSentTime(void)
+{
+#ifdef __AVR__
+    // Four bytes, the TX ISR must not write them between two reads
+    uint8_t sreg = SREG;
+
+    cli();
+    uint32_t sentTime = gUrgentSentTime;
+    SREG = sreg;
+    return sentTime;
+#else
+    return gUrgentSentTime;
+#endif
+}
+
+/*********************************************************************************************************
+** Function name:       DobotSerialGetFrameCount
+** Descriptions:        Number of frame ends seen by the RX ISR, wraps at 256
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      Frame count
+*********************************************************************************************************/
+uint8_t DobotSerialGetFrameCount(void)
+{
+    return gFrameCount;
+}
+
+/*********************************************************************************************************
+** Function name:       DobotSerialReceive
+** Descriptions:        Push a received byte to the RX queue and count the frame ends, called by the port layer
+** Input parameters:    data
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void DobotSerialReceive(uint8_t data)
+{
+    if (RingBufferIsFull(gRxQueue) == false) {
+        RingBufferEnqueue(gRxQueue, &data);
+    }
+
+    switch (gFrameState) {
+    case FrameSyncByte1:
+        if (data == SYNC_BYTE) {
+            gFrameState = FrameSyncByte2;
+        }
+        break;
+
+    case FrameSyncByte2:
+        gFrameState = data == SYNC_BYTE ? FramePayloadLen : FrameSyncByte1;
+        break;
+
+    case FramePayloadLen:
+        if (data == SYNC_BYTE) {
+            break;
+        }
+        if (data < 2 || data > MAX_PAYLOAD_SIZE) {
+            gFrameState = FrameSyncByte1;
+            break;
+        }
+        // Payload and checksum
+        gFrameLeft = data + 1;
+        gFrameState = FrameBody;
+        break;
+
+    case FrameBody:
+        if (--gFrameLeft == 0) {
+            gFrameCount++;
+            gFrameState = FrameSyncByte1;
+        }
+        break;
+    }
+}
+
+#ifdef __AVR__
+/*********************************************************************************************************
+** Function name:       DobotSerialPortOpen
+** Descriptions:        Init UART2 at 8N1 and start the RX interrupt
+** Input parameters:    baudrate
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void DobotSerialPortOpen(uint32_t baudrate)
+{
+    // Double speed as the Arduino core does, the baud error at 115200 is smaller
+    uint16_t baudSetting = (F_CPU / 4 / baudrate - 1) / 2;
+
+    UCSR2B = 0;
+    UCSR2A = _BV(U2X2);
+    UBRR2H = baudSetting >> 8;
+    UBRR2L = baudSetting;
+    UCSR2C = _BV(UCSZ21) | _BV(UCSZ20);
+    UCSR2B = _BV(RXEN2) | _BV(TXEN2) | _BV(RXCIE2);
+}
+
+/*********************************************************************************************************
+** Function name:       DobotSerialPortStartTx
+** Descriptions:        Enable the data register empty interrupt of UART2
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void DobotSerialPortStartTx(void)
+{
+    // UCSR2B is not in the bit addressable I/O space, the ISR must not run between read and write
+    uint8_t sreg = SREG;
+
+    cli();
+    UCSR2B |= _BV(UDRIE2);
+    SREG = sreg;
+}
+
+/*********************************************************************************************************
+** Function name:       USART2_UDRE_vect
+** Descriptions:        Send the next byte of the urgent frame or of the TX queue, stop when both are empty
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+ISR(USART2_UDRE_vect)
+{
+    uint8_t data;
+
+    if (DobotSerialTransmit(&data)) {
+        UDR2 = data;
+    } else {
+        UCSR2B &= ~_BV(UDRIE2);
+    }
+}
+
+/*********************************************************************************************************
+** Function name:       USART2_RX_vect
+** Descriptions:        Hand the received byte to DobotSerialReceive
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+ISR(USART2_RX_vect)
+{
+    uint8_t status = UCSR2A;
+    uint8_t data = UDR2;
+
+    // Framing error, the byte is garbage
+    if (status & _BV(FE2)) {
+        return;
+    }
+    DobotSerialReceive(data);
+}
+#endif
@@ -0,0 +1,127 @@
+/****************************************Copyright(c)*****************************************************
+**                            Shenzhen Yuejiang Technology Co., LTD.
+**
+**                                 http://www.dobot.cc
+**
+**--------------File Info---------------------------------------------------------------------------------
+** File name:           DobotSerial.h
+** Latest modified Date:
+** Latest Version:      V1.0.0
+** Descriptions:        Interrupt driven UART2 link to the Dobot
+**
+**--------------------------------------------------------------------------------------------------------
+** Created by:
+** Created date:        2026-10-17
+** Version:             V1.0.0
+** Descriptions:
+**--------------------------------------------------------------------------------------------------------
+*********************************************************************************************************/
+#ifndef DOBOTSERIAL_H
+#define DOBOTSERIAL_H
+
+#include <stdint.h>
+#include "RingBuffer.h"
+
+/*
+ * Serial2 of the core is not used for the Dobot: referencing it links the core USART2 ISR.
+ * Here the RX ISR pushes every byte straight into the protocol raw byte queue, so nothing is
+ * lost while the main loop is busy, and counts the frame ends for the parser.
+ * The TX side is the mirror: MessageWrite serializes the frames into the tx raw byte queue and
+ * the UDRE ISR drains it, so the main loop never waits for the wire.
+ * An urgent frame (DobotSerialSendUrgent) skips the queue: the TX ISR sends it as soon as the
+ * frame on the wire is complete, so it waits for at most one frame, not for the whole queue.
+ * The port layer (DobotSerialPortOpen, DobotSerialPortStartTx) is UART2 on the AVR, and a tty on
+ * the host build (host/shim).
+ */
+#define DOBOT_SERIAL_BAUDRATE   115200
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*********************************************************************************************************
+** Function name:       DobotSerialInit
+** Descriptions:        Open the Dobot port and start feeding the RX queue
+** Input parameters:    baudrate, rxQueue: filled by the RX ISR, txQueue: drained by the TX ISR, elemSize 1
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void DobotSerialInit(uint32_t baudrate, RingBuffer *rxQueue, RingBuffer *txQueue);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialSend
+** Descriptions:        Start sending the TX queue in the background, call it after queueing bytes
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void DobotSerialSend(void);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialSendUrgent
+** Descriptions:        Send a frame ahead of the TX queue, between two queued frames. Safe in an ISR
+** Input parameters:    frame: kept until sent, len
+** Output parameters:   None
+** Returned value:      false if an urgent frame is still being sent, this one is dropped
+*********************************************************************************************************/
+extern bool DobotSerialSendUrgent(const uint8_t *frame, uint8_t len);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialGetUrgentSentTime
+** Descriptions:        Time the last byte of the last urgent frame was handed to the port
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      micros() at that time, 0 if no urgent frame was sent yet
+*********************************************************************************************************/
+extern uint32_t DobotSerialGetUrgentSentTime(void);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialReceive
+** Descriptions:        Push a received byte to the RX queue and count the frame ends, called by the port layer
+** Input parameters:    data
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void DobotSerialReceive(uint8_t data);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialPortOpen
+** Descriptions:        Open the port and start receiving, port layer
+** Input parameters:    baudrate
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void DobotSerialPortOpen(uint32_t baudrate);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialTransmit
+** Descriptions:        Take the next byte to send, urgent frame first, called by the port layer
+** Input parameters:    None
+** Output parameters:   data
+** Returned value:      false if there is nothing to send
+*********************************************************************************************************/
+extern bool DobotSerialTransmit(uint8_t *data);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialPortStartTx
+** Descriptions:        Start the TX interrupt, it stops by itself when the TX queue is empty, port layer
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void DobotSerialPortStartTx(void);
+
+/*********************************************************************************************************
+** Function name:       DobotSerialGetFrameCount
+** Descriptions:        Number of frame ends seen by the RX ISR, wraps at 256
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      Frame count
+*********************************************************************************************************/
+extern uint8_t DobotSerialGetFrameCount(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
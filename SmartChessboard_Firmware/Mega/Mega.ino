@@ -31,11 +31,39 @@ float GRIPPER_OFFSET_Y = 0.0; // Set after calibration (mm)
 #define PIECE_HEIGHT_QUEEN   49.984
 #define PIECE_HEIGHT_KING    53.676
 
+// Speed of a transfer step, in % of the PTP joint and coordinate params
+struct SpeedProfile {
+    float velocityRatio;
+    float accelerationRatio;
+};
+
+// Height of each piece type, with a fast travel profile and a slow approach profile for
+// pickup and place. The taller pieces sway more, they travel slower.
+struct PieceProfile {
+    char letter;
+    float height;
+    SpeedProfile travel;
+    SpeedProfile approach;
+};
+
+#define PIECE_TYPES   6
+#define PIECE_UNKNOWN 5   // the king, tallest and slowest, when the piece is not known
+
+PieceProfile pieceProfiles[PIECE_TYPES] = {
+    {'p', PIECE_HEIGHT_PAWN,   {100, 80}, {30, 30}},
+    {'r', PIECE_HEIGHT_ROOK,   {100, 80}, {30, 30}},
+    {'n', PIECE_HEIGHT_KNIGHT, {90, 70},  {25, 25}},
+    {'b', PIECE_HEIGHT_BISHOP, {80, 60},  {25, 25}},
+    {'q', PIECE_HEIGHT_QUEEN,  {80, 60},  {20, 20}},
+    {'k', PIECE_HEIGHT_KING,   {70, 50},  {20, 20}}
+};
+
 // Helper function to get pickup Z for a piece type (relative to gripper zero)
 
 #include "Dobot.h"
+#include <ChessLink.h>
 
-// Set to 1 to try to use Dobot_GetPose (may cause linking errors)
+// Set to 1 to read the calibration points with Dobot_GetPoseSnapshot (may cause linking errors)
 // Set to 0 to use predefined coordinates
 #define USE_DOBOT_GETPOSE 1
 
@@ -43,10 +71,144 @@ float GRIPPER_OFFSET_Y = 0.0; // Set after calibration (mm)
 
 float matrix[8][8][3];  // Will be calculated based on corner positions
 
+// Gripper action applied once a transfer step has reached its point
+#define GRIPPER_NONE  0
+#define GRIPPER_CLOSE 1
+#define GRIPPER_OPEN  2
+
+// Pauses around a gripper action, queued on the Dobot as WAIT commands
+#define GRIPPER_SETTLE_MS 500   // arm still on the point before the gripper moves
+#define GRIPPER_STROKE_MS 300   // gripper stroke before the next point
+
+// How a transfer step reaches its point: joint move that stops there, continuous path,
+// or JUMP hop (lift, travel and lower in one command)
+#define MOTION_PTP  0
+#define MOTION_CP   1
+#define MOTION_JUMP 2
+
+// How a transfer moves the piece: lift/travel/descend as MOVJ points, as one blended CP path,
+// or as one JUMP hop per half-move
+#define TRANSFER_MOVJ 0
+#define TRANSFER_CP   1
+#define TRANSFER_JUMP 2
+
+// Most points in a pick-and-place transfer, and the points of a JUMP transfer
+#define TRANSFER_STEPS 6
+#define JUMP_TRANSFER_STEPS 3
+
+// One point of a pick-and-place transfer
+struct TransferStep {
+    const char* description;
+    float x, y, z;
+    const SpeedProfile* profile;
+    uint8_t gripper;
+    uint8_t motion;
+    float jumpHeight, jumpLimit;  // MOTION_JUMP only
+    uint8_t number;               // step number in its transfer, set when it enters the stream
+    uint8_t marks;                // STEP_* marks, set when it enters the stream
+    uint8_t phase;                // PHASE_* of the move, set when it enters the stream
+    uint8_t move;                 // slot of its move in MotionStream::moves
+};
+
+// Marks of a step in the stream, for the messages and the counters of its move
+#define STEP_CAPTURE_START 0x01
+#define STEP_MOVE_START    0x02
+#define STEP_CAPTURE_END   0x04   // the captured piece is in the deposit area
+#define STEP_MOVE_END      0x08
+#define STEP_WHITE_PIECE   0x10   // with STEP_CAPTURE_END: the captured piece is white
+#define STEP_PHASE_START   0x20   // first step of its phase
+#define STEP_PHASE_END     0x40   // last step of its phase
+#define STEP_ANNOUNCED     0x80   // the start of its phase was reported
+
+// Phases of a move reported to the MKR: the capture transfer, then pickup and lift, travel, and
+// descend, release and clear of the piece
+#define PHASE_CAPTURE  0
+#define PHASE_LIFT     1
+#define PHASE_TRANSFER 2
+#define PHASE_PLACE    3
+const char* const phaseNames[] = {"capture", "lift", "transfer", "place"};
+
+// Events of the moves sent to the MKR, "MOVE_EVT:<id>:<move>:<event>[:<detail>]":
+//   QUEUED, CANCELLED:<reason>, ACCEPTED, REJECTED:<reason>, START:<phase>, END:<phase>:<ms>,
+//   DONE:<ms>, ERROR:<reason>, RESUMED, ABORTED. The ms count from the start of the move, when the
+//   arm begins its first phase.
+#define MOVE_EVENT_PREFIX "MOVE_EVT:"
+// Depth of the move queue sent to the MKR when it changes, "MOVE_QUEUE:<depth>:<capacity>"
+#define MOVE_QUEUE_PREFIX "MOVE_QUEUE:"
+
+// Commands kept in the Dobot queue ahead of the arm, tunable with "lookahead"
+#define STREAM_LOOKAHEAD 20
+// Most commands one transfer step queues: speed params, jump params and point (or three CP points),
+// then settle, gripper, stroke and gripper off
+#define STEP_MAX_COMMANDS 7
+// Steps the stream holds: a move with its capture, and the next move planned behind it
+#define STREAM_STEPS (3 * TRANSFER_STEPS)
+// Moves the stream holds: a new one is planned only when 2 * TRANSFER_STEPS are free,
+// so at most two short JUMP moves are in front of it
+#define STREAM_MOVES 3
+#define MOVE_NAME_MAX 8
+
+// A move of the stream, for its events
+struct StreamMove {
+    uint16_t id;
+    char name[MOVE_NAME_MAX];
+    uint32_t startTime;              // millis() when the arm began it, 0 before
+};
+
+// Planner that appends its next move to the stream, false once it has no more
+typedef bool (*MoveFeed)();
+
+// Steps of the planned moves on their way to the Dobot queue, in a ring from first.
+// A step stays until the arm has run its last command. After a Dobot error the steps
+// left stay in the stream until they are resumed or aborted.
+// loop() runs the stream one tick at a time (streamTick), so the serial links are read while the arm moves.
+struct MotionStream {
+    TransferStep steps[STREAM_STEPS];
+    uint64_t stepEnd[STREAM_STEPS];  // queue index of the last command of each sent step
+    uint8_t first;                   // oldest step not known to be done
+    uint8_t sent;                    // steps sent to the Dobot, counted from first
+    uint8_t count;                   // steps in the stream, counted from first
+    MoveFeed feed;                   // planner asked for more moves while the stream has room
+    bool isRunning;                  // streamTick has steps to send or to wait for
+    bool isMoved;                    // a step was sent since the stream started
+    bool isInterrupted;
+    StreamMove moves[STREAM_MOVES];  // moves of the steps, by TransferStep::move
+};
+MotionStream motionStream;
+uint16_t lastMoveId = 0;
+uint8_t streamLookahead = STREAM_LOOKAHEAD;
+
+// Moves received and not planned yet, in order. The stream plans the first one as soon as it has
+// room for it, so the moves run back to back however fast they arrive.
+#define MOVE_QUEUE_SIZE 12
+#define MOVE_TEXT_MAX   16   // a move with its options, "e4xd5 jump q"
+struct QueuedMove {
+    uint16_t id;
+    char text[MOVE_TEXT_MAX];
+};
+struct MoveQueue {
+    QueuedMove moves[MOVE_QUEUE_SIZE];
+    uint8_t first;
+    uint8_t count;
+};
+MoveQueue moveQueue;
+
+// Line being received on Serial, read a character at a time without waiting
+#define SERIAL_LINE_MAX 200
+String serialLine;
+
+// Frames to and from the MKR on Serial1, checked and acknowledged (libraries/ChessLink)
+ChessLink mkrLink;
+
 #if USE_DOBOT_GETPOSE
-// Function to get coordinate by position type
-float getCoordinate(int posType) {
-    return Dobot_GetPose((Pos)posType); 
+// Current pose of the Dobot, X, Y and Z from a single GetPose round trip
+Pose getPose() {
+    Pose pose;
+    if (Dobot_GetPoseSnapshot(pose) != CmdStatusOk) {
+        Serial.println("WARNING: Dobot pose not read");
+        memset(&pose, 0, sizeof(pose));
+    }
+    return pose;
 }
 #endif
 
@@ -55,6 +217,13 @@ float getCoordinate(int posType) {
 #define EEPROM_Z0 1                   // 4 bytes
 #define EEPROM_Z_GRIPPER_ZERO 5       // 4 bytes
 #define EEPROM_MATRIX_START 9         // 8*8*3*4 = 768 bytes
+// Warm start: where the arm stopped and whether it stopped there. The state goes dirty when a
+// motion starts and clean with the pose when the arm is idle again, two writes per move on one cell.
+#define EEPROM_ARM_STATE 777          // 1 byte
+#define EEPROM_ARM_POSE 778           // 3*4 = 12 bytes: x, y, z commanded last
+#define ARM_STATE_CLEAN 0x5A
+#define ARM_STATE_DIRTY 0x00
+#define WARM_START_TOLERANCE 1.0      // mm between the stored and the live pose
 
 // Higher pickup height for safety
 #define SAFE_PICKUP_HEIGHT 35  // Increased height for piece pickup
@@ -64,9 +233,20 @@ float getCoordinate(int posType) {
 #define SAFE_TRAVEL_HEIGHT_EDGE 27.0 // Altezza di viaggio ridotta per colonne a e h
 #define PIECE_GRAB_OFFSET 5.0      // Offset per la presa dei pezzi
 
-// Velocità di movimento
-#define FAST_SPEED 100            // Aumentata da 50 a 100
-#define SLOW_SPEED 50             // Aumentata da 20 a 50
+// Velocità di movimento al 100% dei profili (pieceProfiles)
+#define PTP_XYZ_VELOCITY 200.0      // Velocità cartesiana (mm/s)
+#define PTP_XYZ_ACCELERATION 200.0  // Accelerazione cartesiana (mm/s^2)
+#define CP_VELOCITY 100.0           // Velocità dei percorsi CP (mm/s)
+
+// Percorso continuo (CP) per salita, traslazione e discesa
+#define CP_PLAN_ACC 200.0         // Accelerazione massima del percorso (mm/s^2)
+#define CP_JUNCTION_VEL 80.0      // Velocità massima nei raccordi (mm/s)
+#define CP_ACC 200.0              // Accelerazione lungo il percorso (mm/s^2)
+#define CP_BLEND_RADIUS 10.0      // Raggio di raccordo di default (mm)
+
+// Transfer strategy of the moves that do not choose one
+uint8_t transferStrategy = TRANSFER_CP;
+float cpBlendRadius = CP_BLEND_RADIUS;  // mm cut from each corner, 0 to pass through it
 
 // Area di deposito per i pezzi catturati
 #define CAPTURED_PIECES_X 200     // Posizione X dell'area pezzi catturati
@@ -89,7 +269,21 @@ int capturedPieceCount = 0;
 
 // Calibration variables
 bool isCalibrated = false;
-bool isEmergencyStop = false;
+bool isCalibrating = false;                // waiting for a confirm, the arm is moved by hand
+bool isCalibrationConfirmed = false;       // "calib confirm" from the console
+bool isCalibrationAborted = false;         // "calib abort" from the console
+// A calibration step not confirmed in this time stops the calibration
+#define CALIB_CONFIRM_TIMEOUT 600000UL     // 10 min
+volatile bool isEmergencyStop = false;     // set by the e-stop ISR too
+
+// Pulsante di emergenza, normalmente aperto verso GND. A8 is PCINT16: the ISR below is the one of
+// its bank (PCINT2_vect), another pin needs the vector of its own bank.
+#define ESTOP_PIN A8
+volatile bool isEstopPending = false;      // stopped by the ISR, the rest of emergencyStop still to do
+volatile uint32_t estopPressTime = 0;      // micros() of the press
+volatile bool isForceStopQueued = false;   // the force stop of the press was taken by DobotSerial
+uint32_t estopSentBefore = 0;              // Dobot_ForceStopSentTime before the press
+bool isHomed = false;       // homing done, or skipped by the warm start
 
 // EEPROM addresses
 #define EEPROM_CALIBRATED_FLAG 0
@@ -99,11 +293,81 @@ bool isEmergencyStop = false;
 // Function declarations
 bool validateCoordinates(float x, float y, float z);
 void emergencyStop();
+void triggerEmergencyStop();
+void finishEmergencyStop();
+void setupEstopButton();
+void testEstopButton();
 bool initializeLEDs();
 void handleSerialInput();
+bool readLine(Stream& port, String& buffer, String& line);
+void sendToMKR(const String& message);
+bool waitMKRConfirm(Pose& pose);
+bool runCalibration();
+bool isArmFree();
+void startStream(MoveFeed feed);
+void streamTick();
+void stopStream(const String& reason);
+bool abortStream();
+void reportStreamStop(const String& reason);
+void sendMoveEvent(uint16_t id, const String& move, const String& event);
+bool feedQueue();
+bool cancelQueuedMove(uint16_t id);
+void clearMoveQueue(const char* reason);
+void reportMoveQueue();
+void printMoveQueue();
 void processMKRCommand(String data);
 void printStartupInfo();
 void printHelp();
+void printSpeedProfiles() {
+    Serial.println("Pezzo  Altezza  Viaggio v%/a%  Avvicinamento v%/a%");
+    for (uint8_t i = 0; i < PIECE_TYPES; i++) {
+        const PieceProfile& piece = pieceProfiles[i];
+        Serial.print(piece.letter);
+        Serial.print("      ");
+        Serial.print(piece.height);
+        Serial.print("    ");
+        Serial.print(piece.travel.velocityRatio);
+        Serial.print("/");
+        Serial.print(piece.travel.accelerationRatio);
+        Serial.print("        ");
+        Serial.print(piece.approach.velocityRatio);
+        Serial.print("/");
+        Serial.println(piece.approach.accelerationRatio);
+    }
+}
+
+// "p travel 100 80": piece letter, travel or approach, velocity and acceleration in %
+void setSpeedProfile(String args) {
+    args.trim();
+    uint8_t piece;
+    int first = args.indexOf(' ');
+    int second = first == -1 ? -1 : args.indexOf(' ', first + 1);
+    int third = second == -1 ? -1 : args.indexOf(' ', second + 1);
+    if (third == -1 || !parsePiece(args.substring(0, first), piece)) {
+        Serial.println("ERROR: Use profile <p|r|n|b|q|k> <travel|approach> <velocity%> <acceleration%>");
+        return;
+    }
+    String kind = args.substring(first + 1, second);
+    float velocityRatio = args.substring(second + 1, third).toFloat();
+    float accelerationRatio = args.substring(third + 1).toFloat();
+    if (velocityRatio <= 0 || velocityRatio > 100 || accelerationRatio <= 0 || accelerationRatio > 100) {
+        Serial.println("ERROR: Ratios must be in 1..100%");
+        return;
+    }
+    SpeedProfile* profile;
+    if (kind.equalsIgnoreCase("travel")) {
+        profile = &pieceProfiles[piece].travel;
+    } else if (kind.equalsIgnoreCase("approach")) {
+        profile = &pieceProfiles[piece].approach;
+    } else {
+        Serial.println("ERROR: Profile must be travel or approach");
+        return;
+    }
+    profile->velocityRatio = velocityRatio;
+    profile->accelerationRatio = accelerationRatio;
+    printSpeedProfiles();
+}
+
 void printSystemStatus();
 void printCalibrationStatus();
 void testDobotMovement();
@@ -155,21 +419,87 @@ bool loadCalibrationFromEEPROM() {
     return true;
 }
 
+// The arm is about to move, the stored pose no longer tells where it stands
+void markArmMoving() {
+    EEPROM.update(EEPROM_ARM_STATE, ARM_STATE_DIRTY);
+}
+
+// The arm is idle at the commanded pose (EEPROM.put only writes the bytes that change)
+void saveArmPose(float x, float y, float z) {
+    float pose[3] = {x, y, z};
+    EEPROM.put(EEPROM_ARM_POSE, pose);
+    EEPROM.update(EEPROM_ARM_STATE, ARM_STATE_CLEAN);
+}
+
+// Homing can be skipped when the arm stopped cleanly and the Dobot still reports the same pose,
+// as after a reset of the Mega alone. After a power cycle of the Dobot its pose no longer matches.
+bool checkWarmStart() {
+    if (EEPROM.read(EEPROM_ARM_STATE) != ARM_STATE_CLEAN) {
+        Serial.println("Warm start: last motion not finished, homing required");
+        return false;
+    }
+    float stored[3];
+    EEPROM.get(EEPROM_ARM_POSE, stored);
+    Pose pose;
+    if (Dobot_GetPoseSnapshot(pose) != CmdStatusOk) {
+        Serial.println("Warm start: Dobot pose not read, homing required");
+        return false;
+    }
+    if (fabs(pose.x - stored[0]) > WARM_START_TOLERANCE ||
+        fabs(pose.y - stored[1]) > WARM_START_TOLERANCE ||
+        fabs(pose.z - stored[2]) > WARM_START_TOLERANCE) {
+        Serial.println("Warm start: pose changed, homing required");
+        return false;
+    }
+    Serial.println("Warm start: pose matches, homing skipped");
+    return true;
+}
+
+// Full homing cycle, only when the warm start could not vouch for the pose
+// False if the homing did not end (alarm, e-stop, no answer): the arm state stays dirty, so the
+// next boot homes again
+bool ensureHomed() {
+    if (isHomed) {
+        return true;
+    }
+    Serial.println("Moving to home position...");
+    markArmMoving();
+    Pose pose;
+    CmdStatus status = Dobot_SetHOMECmd();
+    if (status == CmdStatusOk) {
+        status = Dobot_GetPoseSnapshot(pose);
+    }
+    if (status != CmdStatusOk) {
+        Serial.print("ERROR: Homing not completed, status ");
+        Serial.println(status);
+        return false;
+    }
+    saveArmPose(pose.x, pose.y, pose.z);
+    isHomed = true;
+    return true;
+}
+
 void setup() {
     Serial.begin(115200);  // Initialize serial communication for debugging
-    Serial1.begin(9600);   // Initialize Serial1 for communication with ESP32
+    Serial1.begin(CHESSLINK_BAUDRATE);   // Initialize Serial1 for communication with the MKR
+    mkrLink.begin(Serial1);
     
     // LED system removed - now handled by MKR
     
     // Initialize Dobot and home position
+    // Nessuna porta EIO da configurare: il gripper usa il comando end effector
     Dobot_Init();
+    Dobot_SetPTPCoordinateParams(PTP_XYZ_VELOCITY, PTP_XYZ_VELOCITY, PTP_XYZ_ACCELERATION, PTP_XYZ_ACCELERATION);
+    Dobot_SetCPParams(CP_PLAN_ACC, CP_JUNCTION_VEL, CP_ACC, 0);
     
     // Try to load calibration from EEPROM
     if (loadCalibrationFromEEPROM()) {
         isCalibrated = true;
         Serial.println("Calibration loaded from EEPROM");
-        Serial1.println("CALIB_MSG:Calibration loaded from EEPROM");
+        sendToMKR("CALIB_MSG:Calibration loaded from EEPROM");
     }
+    isHomed = checkWarmStart();
+    setupEstopButton();
     
     // Print startup information
     printStartupInfo();
@@ -194,64 +524,179 @@ bool validateCoordinates(float x, float y, float z) {
     return true;
 }
 
+// Emergency stop from a command (serial "emergency", MKR "STOP"), the button goes through its ISR
 void emergencyStop() {
+    if (isEmergencyStop && !isEstopPending) {
+        Serial.println("Emergency stop already active");
+        return;
+    }
+    noInterrupts();
+    triggerEmergencyStop();
+    interrupts();
+    finishEmergencyStop();
+}
+
+// Stop the arm at once, from the ISR too: the force stop frame goes out ahead of the queued ones,
+// nothing waits for the Dobot here
+void triggerEmergencyStop() {
+    if (isEmergencyStop) {
+        return;
+    }
+    estopPressTime = micros();
+    estopSentBefore = Dobot_ForceStopSentTime();
+    isForceStopQueued = Dobot_ForceStop();
     isEmergencyStop = true;
+    isEstopPending = true;
+}
+
+// The rest of the stop, from loop(): the Dobot first (force stop out, queue dropped, piece
+// released), the report after, the MKR link can take a while
+void finishEmergencyStop() {
+    isEstopPending = false;
+
+    // The stop frame waits at most for the frame already on the wire. Refused while the previous
+    // force stop was still going out, it is queued again once that one is sent
+    uint32_t start = micros();
+    while (micros() - start < 20000) {
+        if (!isForceStopQueued) {
+            noInterrupts();
+            uint32_t sentBefore = Dobot_ForceStopSentTime();
+            if (Dobot_ForceStop()) {
+                estopSentBefore = sentBefore;
+                isForceStopQueued = true;
+            }
+            interrupts();
+        } else if (Dobot_ForceStopSentTime() != estopSentBefore) {
+            break;
+        }
+    }
+    bool isStopSent = isForceStopQueued && Dobot_ForceStopSentTime() != estopSentBefore;
+
+    // The arm is already still, the move left can be resumed after reset
+    bool isStreamStopped = motionStream.isRunning;
+    bool isQueueCleared;
+    if (isStreamStopped) {
+        isQueueCleared = abortStream();
+    } else {
+        uint64_t doneIndex;
+        isQueueCleared = Dobot_BatchAbort(&doneIndex) == CmdStatusOk;
+    }
+
+    // Open gripper to release any held piece, it is switched off by reset
+    CmdStatus gripperStatus = Dobot_SetEndEffectorGripper(true, false);
+
     Serial.println("EMERGENCY STOP ACTIVATED!");
-    Serial1.println("CALIB_MSG:EMERGENCY STOP ACTIVATED!");
-    
-    // Open gripper to release any held piece
-    Dobot_SetEndEffectorGripper(true, false);
-    delay(1000);
-    Dobot_SetEndEffectorGripper(false, false);
-    
+    Serial.print("E-stop latency (press to force stop sent): ");
+    if (isStopSent) {
+        Serial.print(Dobot_ForceStopSentTime() - estopPressTime);
+        Serial.println(" us");
+    } else {
+        Serial.println("not sent within 20 ms!");
+    }
+    if (!isQueueCleared) {
+        Serial.println("ERROR: Dobot queue could not be stopped!");
+    }
+    if (gripperStatus != CmdStatusOk) {
+        Serial.print("ERROR: Gripper not released, status ");
+        Serial.println(gripperStatus);
+    }
+    sendToMKR("CALIB_MSG:EMERGENCY STOP ACTIVATED!");
+    if (!isStopSent) {
+        sendToMKR("CALIB_MSG:ERROR: Force stop not sent to the Dobot");
+    }
+    if (gripperStatus != CmdStatusOk) {
+        sendToMKR("CALIB_MSG:ERROR: Gripper not released, check the piece");
+    }
+    if (isStreamStopped) {
+        reportStreamStop("emergency stop");
+    }
+
     // LED control removed - now handled by MKR
 }
 
+// E-stop button on a pin change interrupt, active low with the internal pull-up
+void setupEstopButton() {
+    pinMode(ESTOP_PIN, INPUT_PULLUP);
+    *digitalPinToPCMSK(ESTOP_PIN) |= _BV(digitalPinToPCMSKbit(ESTOP_PIN));
+    PCIFR = _BV(digitalPinToPCICRbit(ESTOP_PIN));
+    PCICR |= _BV(digitalPinToPCICRbit(ESTOP_PIN));
+    if (digitalRead(ESTOP_PIN) == LOW) {
+        Serial.println("E-stop button pressed at boot");
+        emergencyStop();
+    }
+}
+
+ISR(PCINT2_vect) {
+    // Only the press stops, the release and the bounces of an active stop are ignored
+    if (digitalRead(ESTOP_PIN) == LOW) {
+        triggerEmergencyStop();
+    }
+}
+
+// Press the button from the sketch: the pin change interrupt fires on an output pin too, so the
+// whole ISR path runs, also during a move. Driving low a line the button shorts to GND is harmless
+void testEstopButton() {
+    if (isEmergencyStop) {
+        Serial.println("ERROR: Emergency stop already active, send reset first");
+        return;
+    }
+    digitalWrite(ESTOP_PIN, LOW);
+    pinMode(ESTOP_PIN, OUTPUT);
+    delayMicroseconds(50);
+    pinMode(ESTOP_PIN, INPUT_PULLUP);
+}
+
 void calibrateChessboard() {
-    bool confirmed = false;
     Serial.println("\n=== STARTING CALIBRATION ===");
-    Serial1.println("CALIB_MSG:Starting chessboard calibration...");
+    sendToMKR("CALIB_MSG:Starting chessboard calibration...");
     
-    // Home position
-    Serial.println("Moving to home position...");
-    Dobot_SetHOMECmd();
-    delay(2000);
+    // Home position, the arm is then moved by hand: the next boot homes until a move ends cleanly
+    if (!ensureHomed()) {
+        sendToMKR("CALIB_MSG:ERROR: Homing failed, calibration not started");
+        return;
+    }
+    markArmMoving();
+
+    isCalibrating = true;
+    bool isDone = runCalibration();
+    isCalibrating = false;
+    if (!isDone) {
+        return;
+    }
+
+    isCalibrated = true;
+    Serial.println("\n=== CALIBRATION COMPLETE ===");
+    sendToMKR("CALIB_MSG:Calibration complete and verified!");
+}
+
+// The steps of the calibration. The values are kept aside until every step is confirmed, so a
+// calibration stopped halfway leaves the previous one in use and in EEPROM.
+bool runCalibration() {
+    Pose pose;
 
     // LED control removed - now handled by MKR
 
     // 1. Calibrate Z0 (board surface without gripper)
     Serial.println("\nSTEP 1: Calibrating board surface height (Z0)");
-    Serial1.println("CALIB_MSG:STEP 1: Place the calibration tool on the board surface. Press confirm when ready.");
+    sendToMKR("CALIB_MSG:STEP 1: Place the calibration tool on the board surface. Press confirm when ready.");
     
-    confirmed = false;
-    while (!confirmed) {
-        if (Serial1.available()) {
-            String conf = Serial1.readStringUntil('\n');
-            conf.trim();
-            if (conf.equalsIgnoreCase("CALIB_CONFIRM")) { confirmed = true; break; }
-        }
-        delay(10);
+    if (!waitMKRConfirm(pose)) {
+        return false;
     }
-    Z0 = getCoordinate(Z);
-    Serial.print("Z0 (board surface) saved as: "); Serial.println(Z0);
-    Serial1.print("CALIB_MSG:Z0 saved as: "); Serial1.println(Z0);
+    float z0 = pose.z;
+    Serial.print("Z0 (board surface) saved as: "); Serial.println(z0);
+    sendToMKR("CALIB_MSG:Z0 saved as: " + String(z0));
 
     // 2. Calibrate Z_gripper_zero (with gripper)
     Serial.println("\nSTEP 2: Calibrating gripper height (Z_gripper_zero)");
-    Serial1.println("CALIB_MSG:STEP 2: Attach gripper and place it on board surface. Press confirm when ready.");
+    sendToMKR("CALIB_MSG:STEP 2: Attach gripper and place it on board surface. Press confirm when ready.");
     
-    confirmed = false;
-    while (!confirmed) {
-        if (Serial1.available()) {
-            String conf = Serial1.readStringUntil('\n');
-            conf.trim();
-            if (conf.equalsIgnoreCase("CALIB_CONFIRM")) { confirmed = true; break; }
-        }
-        delay(10);
+    if (!waitMKRConfirm(pose)) {
+        return false;
     }
-    Z_gripper_zero = getCoordinate(Z);
-    Serial.print("Z_gripper_zero saved as: "); Serial.println(Z_gripper_zero);
-    Serial1.print("CALIB_MSG:Z_gripper_zero saved as: "); Serial1.println(Z_gripper_zero);
+    float zGripperZero = pose.z;
+    Serial.print("Z_gripper_zero saved as: "); Serial.println(zGripperZero);
+    sendToMKR("CALIB_MSG:Z_gripper_zero saved as: " + String(zGripperZero));
 
     // LED control removed - now handled by MKR
 
@@ -259,34 +704,28 @@ void calibrateChessboard() {
     Serial.println("\nSTEP 3: Calibrating corner positions");
     float corners[4][2];  // Store X,Y coordinates of corners
     String cornerNames[4] = {"a8", "h8", "a1", "h1"};
-    int cornerRows[4] = {0, 0, 7, 7};
-    int cornerCols[4] = {0, 7, 0, 7};
     
     for (int i = 0; i < 4; i++) {
         Serial.print("\nCalibrating corner "); Serial.println(cornerNames[i]);
-        Serial1.println("CALIB_MSG:Move to " + cornerNames[i] + " corner and press confirm when ready");
+        sendToMKR("CALIB_MSG:Move to " + cornerNames[i] + " corner and press confirm when ready");
         
         // LED control removed - now handled by MKR
         
-    confirmed = false;
-    while (!confirmed) {
-        if (Serial1.available()) {
-            String conf = Serial1.readStringUntil('\n');
-            conf.trim();
-            if (conf.equalsIgnoreCase("CALIB_CONFIRM")) { confirmed = true; break; }
+        if (!waitMKRConfirm(pose)) {
+            return false;
         }
-        delay(10);
-    }
-        corners[i][0] = getCoordinate(X);
-        corners[i][1] = getCoordinate(Y);
+        corners[i][0] = pose.x;
+        corners[i][1] = pose.y;
         Serial.print(cornerNames[i] + " position: X=");
         Serial.print(corners[i][0]); Serial.print(" Y=");
         Serial.println(corners[i][1]);
-        Serial1.print("CALIB_MSG:" + cornerNames[i] + " saved as X=");
-        Serial1.print(corners[i][0]); Serial1.print(" Y=");
-        Serial1.println(corners[i][1]);
+        sendToMKR("CALIB_MSG:" + cornerNames[i] + " saved as X=" + String(corners[i][0]) + " Y=" + String(corners[i][1]));
     }
 
+    // Every step confirmed: the new calibration replaces the old one
+    Z0 = z0;
+    Z_gripper_zero = zGripperZero;
+
     // Calculate all square positions
     Serial.println("\nCalculating square positions...");
     float xStep = (corners[1][0] - corners[0][0]) / 7.0;
@@ -314,9 +753,9 @@ void calibrateChessboard() {
     
     if (testZ0 != Z0 || testZ_gripper != Z_gripper_zero) {
         Serial.println("ERROR: EEPROM verification failed!");
-        Serial1.println("CALIB_MSG:ERROR: EEPROM verification failed!");
+        sendToMKR("CALIB_MSG:ERROR: EEPROM verification failed!");
         isCalibrated = false;
-        return;
+        return false;
     }
     
     // Final verification
@@ -326,10 +765,7 @@ void calibrateChessboard() {
     Serial.print("Gripper offset: "); Serial.println(Z_gripper_zero - Z0);
     
     delay(1000);
-    
-    isCalibrated = true;
-    Serial.println("\n=== CALIBRATION COMPLETE ===");
-    Serial1.println("CALIB_MSG:Calibration complete and verified!");
+    return true;
 }
 
 // Calculate the matrix positions based on the edge positions
@@ -351,7 +787,7 @@ void calculateMatrixPositions() {
         !validateCoordinates(x_a8, y_a8, Z0) ||
         !validateCoordinates(x_h8, y_h8, Z0)) {
         Serial.println("ERROR: Invalid corner coordinates!");
-        Serial1.println("CALIB_MSG:ERROR: Invalid corner coordinates!");
+        sendToMKR("CALIB_MSG:ERROR: Invalid corner coordinates!");
         isCalibrated = false;
         return;
     }
@@ -384,7 +820,7 @@ void calculateMatrixPositions() {
                                    matrix[row][col][1], 
                                    matrix[row][col][2])) {
                 Serial.println("ERROR: Invalid calculated position!");
-                Serial1.println("CALIB_MSG:ERROR: Invalid calculated position!");
+                sendToMKR("CALIB_MSG:ERROR: Invalid calculated position!");
                 isCalibrated = false;
                 return;
             }
@@ -415,32 +851,258 @@ int charToIndex(char c) {
 }
 
 void loop() {
-    // Check for emergency stop condition
-    if (isEmergencyStop) {
-        return;
+    // The e-stop ISR has already stopped the arm, the rest is done here
+    if (isEstopPending) {
+        finishEmergencyStop();
     }
 
-    // Handle input from monitor seriale (Serial)
+    // Handle input from monitor seriale (Serial), also during a move and after an emergency stop
     handleSerialInput();
     
-    // Check if data is available on Serial1 (from MKR)
-    if (Serial1.available()) {
-        String data = Serial1.readStringUntil('\n');
+    // Check if a command arrived from the MKR, the link also sends the frames and Acks due
+    if (mkrLink.receive()) {
+        String data = mkrLink.text();
         data.trim();
         Serial.println("Received from MKR: " + data);
         
         // Process commands from MKR
         processMKRCommand(data);
     }
+
+    // Check for emergency stop condition
+    if (isEmergencyStop) {
+        return;
+    }
+
+    // One step of the move in progress, if any
+    streamTick();
+}
+
+// Take the characters already received on port, true once a line is complete (trimmed, in line).
+// readStringUntil would wait up to a second for the end of a line while the arm moves.
+bool readLine(Stream& port, String& buffer, String& line) {
+    while (port.available()) {
+        char c = port.read();
+        if (c == '\n') {
+            line = buffer;
+            line.trim();
+            buffer = "";
+            return true;
+        }
+        if (buffer.length() < SERIAL_LINE_MAX) {
+            buffer += c;
+        }
+    }
+    return false;
 }
 
-// Function to process move data
+// Queue a message for the MKR, it goes out while loop() polls the link
+void sendToMKR(const String& message) {
+    if (!mkrLink.send(ChessLinkMessage, message.c_str())) {
+        Serial.println("WARNING: MKR message not sent: " + message);
+    }
+}
+
+// Calibration steps: wait for CALIB_CONFIRM and read the pose the arm was moved to. The e-stop and
+// the console stay live; STOP is obeyed and CALIB_ABORT stops the calibration, the other commands of
+// the MKR are dropped. False if the calibration must stop, the reason is reported here.
+bool waitMKRConfirm(Pose& pose) {
+    uint32_t start = millis();
+    String reason;
+    isCalibrationConfirmed = false;
+    isCalibrationAborted = false;
+    while (reason.length() == 0) {
+        if (isEstopPending) {
+            finishEmergencyStop();
+        }
+        handleSerialInput();
+        if (mkrLink.receive()) {
+            String conf = mkrLink.text();
+            conf.trim();
+            Serial.println("Received from MKR: " + conf);
+            if (conf.equalsIgnoreCase("CALIB_CONFIRM")) {
+                isCalibrationConfirmed = true;
+            } else if (conf.equalsIgnoreCase("CALIB_ABORT")) {
+                isCalibrationAborted = true;
+            } else if (conf.equalsIgnoreCase("STOP")) {
+                emergencyStop();
+            }
+        }
+        if (isEmergencyStop) {
+            reason = "emergency stop";
+        } else if (isCalibrationAborted) {
+            reason = "aborted";
+        } else if (isCalibrationConfirmed) {
+            CmdStatus status = Dobot_GetPoseSnapshot(pose);
+            if (status == CmdStatusOk) {
+                return true;
+            }
+            reason = "Dobot pose not read, status " + String(status);
+        } else if (millis() - start >= CALIB_CONFIRM_TIMEOUT) {
+            reason = "no confirm within 10 minutes";
+        }
+    }
+    Serial.println("ERROR: Calibration stopped: " + reason + ", previous calibration kept");
+    sendToMKR("CALIB_MSG:ERROR: Calibration stopped: " + reason + ", previous calibration kept");
+    return false;
+}
+
+// The blocking motions (calibration, tests, homing) wait for the move in progress to end
+bool isArmFree() {
+    if (isEmergencyStop) {
+        Serial.println("ERROR: Emergency stop is active!");
+        return false;
+    }
+    if (isCalibrating) {
+        Serial.println("ERROR: Calibration in progress, send calib confirm or calib abort");
+        return false;
+    }
+    if (motionStream.isRunning) {
+        Serial.println("ERROR: Arm busy with a move, wait for it or send emergency");
+        return false;
+    }
+    return true;
+}
+
+// Queue one move, or several separated by commas ("e2e4, e7e5 jump p, g1f3 n"), also during a move.
+// The stream plans each one while the previous one is still in the Dobot queue, and the arm does not
+// stop in between. Several moves go in together or not at all (castling, a capture and its move).
 void processMoveData(const String& moveData) {
+    String moves[MOVE_QUEUE_SIZE];
+    uint8_t count = 0;
+    const char* error = NULL;
+    int start = 0;
+    while (start <= (int)moveData.length()) {
+        int comma = moveData.indexOf(',', start);
+        String move = moveData.substring(start, comma == -1 ? moveData.length() : comma);
+        move.trim();
+        start = comma == -1 ? moveData.length() + 1 : comma + 1;
+        if (move.length() == 0) {
+            continue;
+        }
+        // The moves that do not fit are rejected at once, the others with them below
+        if (count == MOVE_QUEUE_SIZE - moveQueue.count) {
+            error = "move queue full";
+            rejectMove(++lastMoveId, move, error);
+        } else {
+            moves[count++] = move;
+            if (move.length() >= MOVE_TEXT_MAX) {
+                error = "move too long";
+            }
+        }
+    }
+    if (count == 0 && error == NULL) {
+        Serial.println("ERROR: No move given!");
+        rejectMove(++lastMoveId, moveData, "invalid move format");
+        return;
+    }
     if (isEmergencyStop) {
         Serial.println("ERROR: Emergency stop is active!");
+        error = "emergency stop active";
+    } else if (isCalibrating) {
+        Serial.println("ERROR: Calibration in progress!");
+        error = "calibration in progress";
+    } else if (motionStream.isInterrupted) {
+        // An interrupted move must be finished or dropped first, the board is not where the game thinks
+        Serial.println("ERROR: A move was interrupted, send RESUME or ABORT first!");
+        sendToMKR("CALIB_MSG:ERROR: A move was interrupted, send RESUME or ABORT first!");
+        error = "interrupted move, send RESUME or ABORT";
+    } else if (error != NULL) {
+        Serial.print("ERROR: Moves not queued, ");
+        Serial.println(error);
+    }
+    if (error != NULL) {
+        for (uint8_t i = 0; i < count; i++) {
+            rejectMove(++lastMoveId, moves[i], error);
+        }
+        return;
+    }
+
+    for (uint8_t i = 0; i < count; i++) {
+        QueuedMove& queued = moveQueue.moves[(moveQueue.first + moveQueue.count++) % MOVE_QUEUE_SIZE];
+        queued.id = ++lastMoveId;
+        moves[i].toCharArray(queued.text, MOVE_TEXT_MAX);
+        sendMoveEvent(queued.id, queued.text, "QUEUED");
+    }
+    Serial.println(motionStream.isRunning ? "Move queued behind the current one" : "Executing move...");
+    reportMoveQueue();
+    startStream(feedQueue);
+}
+
+// Planner of the stream: append the first queued move, false once the queue is empty. After an
+// invalid move the moves behind it are dropped, they were sent for a board with that move made.
+bool feedQueue() {
+    if (moveQueue.count == 0) {
+        return false;
+    }
+    QueuedMove& next = moveQueue.moves[moveQueue.first];
+    uint16_t id = next.id;
+    String move = next.text;
+    moveQueue.first = (moveQueue.first + 1) % MOVE_QUEUE_SIZE;
+    moveQueue.count--;
+    if (!planMove(move, id)) {
+        clearMoveQueue("previous move rejected");
+        return false;
+    }
+    reportMoveQueue();
+    return true;
+}
+
+// Drop a queued move that is not planned yet, false if there is none with that id
+bool cancelQueuedMove(uint16_t id) {
+    for (uint8_t i = 0; i < moveQueue.count; i++) {
+        QueuedMove& queued = moveQueue.moves[(moveQueue.first + i) % MOVE_QUEUE_SIZE];
+        if (queued.id != id) {
+            continue;
+        }
+        sendMoveEvent(queued.id, queued.text, "CANCELLED:cancelled");
+        // The moves behind it move up one place
+        for (uint8_t j = i; j + 1 < moveQueue.count; j++) {
+            moveQueue.moves[(moveQueue.first + j) % MOVE_QUEUE_SIZE] =
+                moveQueue.moves[(moveQueue.first + j + 1) % MOVE_QUEUE_SIZE];
+        }
+        moveQueue.count--;
+        reportMoveQueue();
+        return true;
+    }
+    return false;
+}
+
+// Drop every queued move, reason goes with their CANCELLED events
+void clearMoveQueue(const char* reason) {
+    if (moveQueue.count == 0) {
         return;
     }
+    for (uint8_t i = 0; i < moveQueue.count; i++) {
+        const QueuedMove& queued = moveQueue.moves[(moveQueue.first + i) % MOVE_QUEUE_SIZE];
+        sendMoveEvent(queued.id, queued.text, String("CANCELLED:") + reason);
+    }
+    Serial.print("Move queue cleared: ");
+    Serial.println(reason);
+    moveQueue.count = 0;
+    reportMoveQueue();
+}
 
+void reportMoveQueue() {
+    sendToMKR(MOVE_QUEUE_PREFIX + String(moveQueue.count) + ":" + String(MOVE_QUEUE_SIZE));
+}
+
+void printMoveQueue() {
+    Serial.print("Mosse in coda: ");
+    Serial.print(moveQueue.count);
+    Serial.print("/");
+    Serial.println(MOVE_QUEUE_SIZE);
+    for (uint8_t i = 0; i < moveQueue.count; i++) {
+        const QueuedMove& queued = moveQueue.moves[(moveQueue.first + i) % MOVE_QUEUE_SIZE];
+        Serial.print("  ");
+        Serial.print(queued.id);
+        Serial.print(": ");
+        Serial.println(queued.text);
+    }
+}
+
+// Plan a move, with its capture if any, and append it to the stream. Nothing is appended if it is invalid.
+bool planMove(const String& moveData, uint16_t id) {
     String move = moveData;
     move.trim();
     Serial.println("\n=== PROCESSING MOVE ===");
@@ -448,19 +1110,33 @@ void processMoveData(const String& moveData) {
     Serial.print(move);
     Serial.println("'");
 
+    // Optional words after the move choose the transfer strategy and the moving piece, e.g. "e2e4 jump n"
+    uint8_t strategy = transferStrategy;
+    uint8_t piece = PIECE_UNKNOWN;
+    int space = move.indexOf(' ');
+    if (space != -1) {
+        if (!parseMoveOptions(move.substring(space + 1), strategy, piece)) {
+            Serial.println("ERROR: Invalid move options!");
+            return rejectMove(id, moveData, "invalid move options");
+        }
+        move = move.substring(0, space);
+    }
+
     int fromCol, fromRow, toCol, toRow;
     bool isCapture = false;
 
     // Parse and validate move format
     if (!parseMoveData(move, fromCol, fromRow, toCol, toRow, isCapture)) {
         Serial.println("ERROR: Invalid move format!");
-        return;
+        return rejectMove(id, moveData, "invalid move format");
     }
 
     Serial.println("Move parsed successfully:");
     Serial.print("From: row="); Serial.print(fromRow); Serial.print(" col="); Serial.println(fromCol);
     Serial.print("To: row="); Serial.print(toRow); Serial.print(" col="); Serial.println(toCol);
     Serial.print("Is capture: "); Serial.println(isCapture ? "yes" : "no");
+    Serial.print("Transfer: "); Serial.print(getTransferStrategyName(strategy));
+    Serial.print(" - piece: "); Serial.println(pieceProfiles[piece].letter);
 
     // Get coordinates
     float fromX = matrix[fromRow][fromCol][0];
@@ -478,34 +1154,98 @@ void processMoveData(const String& moveData) {
     if (!validateCoordinates(fromX, fromY, fromZ) ||
         !validateCoordinates(toX, toY, toZ)) {
         Serial.println("ERROR: Invalid move coordinates!");
-        return;
+        return rejectMove(id, moveData, "invalid coordinates");
     }
 
     // LED control removed - now handled by MKR
 
-    // If it's a capture, first remove the captured piece
+    // Check if calibration is valid before executing move
+    if (!isCalibrated) {
+        Serial.println("ERROR: System not calibrated!");
+        return rejectMove(id, moveData, "not calibrated");
+    }
+    if (STREAM_STEPS - motionStream.count < 2 * TRANSFER_STEPS) {
+        Serial.println("ERROR: No room for the move in the stream!");
+        return rejectMove(id, moveData, "too many moves queued");
+    }
+
+    // Plan every transfer before the move enters the stream, so an invalid move leaves the arm still
+    TransferStep steps[TRANSFER_STEPS];
+    uint8_t captureCount = 0;
+    uint8_t slot = findFreeMoveSlot();
     if (isCapture) {
-        if (!handleCapture(toX, toY, toZ)) {
+        bool isWhitePiece;
+        captureCount = planCapture(toX, toY, toZ, strategy, steps, isWhitePiece);
+        if (captureCount == 0) {
             Serial.println("ERROR: Failed to handle capture!");
-            return;
+            return rejectMove(id, moveData, "capture not possible");
         }
+        setTransferPhases(steps, captureCount, true);
+        appendToStream(steps, captureCount, slot, STEP_CAPTURE_START,
+                       STEP_CAPTURE_END | (isWhitePiece ? STEP_WHITE_PIECE : 0));
     }
+    uint8_t moveCount = planTransfer(fromX, fromY, fromZ, toX, toY, toZ, strategy, pieceProfiles[piece], steps);
+    if (moveCount == 0) {
+        // The capture has not been sent yet, it leaves the stream with the move
+        motionStream.count -= captureCount;
+        Serial.println("ERROR: Move execution failed!");
+        return rejectMove(id, moveData, "point out of range");
+    }
+    setTransferPhases(steps, moveCount, false);
+    appendToStream(steps, moveCount, slot, STEP_MOVE_START, STEP_MOVE_END);
+
+    StreamMove& planned = motionStream.moves[slot];
+    planned.id = id;
+    move.toCharArray(planned.name, MOVE_NAME_MAX);
+    planned.startTime = 0;
+    sendMoveEvent(planned.id, planned.name, "ACCEPTED");
+    return true;
+}
 
-    // Check if calibration is valid before executing move
-    if (!isCalibrated) {
-        Serial.println("ERROR: System not calibrated!");
-        return;
+// Report a move that does not enter the stream, returns false for planMove
+bool rejectMove(uint16_t id, const String& moveData, const char* reason) {
+    sendMoveEvent(id, moveData, String("REJECTED:") + reason);
+    return false;
+}
+
+// Send an event of a move to the MKR, see MOVE_EVENT_PREFIX. The move goes without its options.
+void sendMoveEvent(uint16_t id, const String& move, const String& event) {
+    String name = move;
+    name.trim();
+    int space = name.indexOf(' ');
+    if (space != -1) {
+        name = name.substring(0, space);
     }
+    sendToMKR(MOVE_EVENT_PREFIX + String(id) + ":" + name + ":" + event);
+}
 
-    // Execute the move
-    Serial.println("Executing move...");
-    if (!executeMove(fromX, fromY, fromZ, toX, toY, toZ)) {
-        Serial.println("ERROR: Move execution failed!");
-        return;
+// Phases of the steps of a transfer: a capture is one phase, the moving piece is picked up and
+// lifted, carried, then placed (the last step clears the piece)
+void setTransferPhases(TransferStep steps[], uint8_t count, bool isCapture) {
+    for (uint8_t i = 0; i < count; i++) {
+        if (isCapture) {
+            steps[i].phase = PHASE_CAPTURE;
+        } else if (count == JUMP_TRANSFER_STEPS) {
+            // One hop to the pickup, one to the place point, then up
+            steps[i].phase = i == 0 ? PHASE_LIFT : i == 1 ? PHASE_TRANSFER : PHASE_PLACE;
+        } else {
+            steps[i].phase = i < 3 ? PHASE_LIFT : i == 3 ? PHASE_TRANSFER : PHASE_PLACE;
+        }
     }
+}
 
-    Serial.println("=== MOVE COMPLETE ===\n");
-    // LED control removed - now handled by MKR
+// A slot of motionStream.moves not used by a step of the stream
+uint8_t findFreeMoveSlot() {
+    for (uint8_t slot = 0; slot < STREAM_MOVES; slot++) {
+        bool isUsed = false;
+        for (uint8_t i = 0; i < motionStream.count && !isUsed; i++) {
+            isUsed = streamStep(i).move == slot;
+        }
+        if (!isUsed) {
+            return slot;
+        }
+    }
+    return 0;
 }
 
 bool parseMoveData(const String& move, int& fromCol, int& fromRow, int& toCol, int& toRow, bool& isCapture) {
@@ -536,47 +1276,87 @@ bool parseMoveData(const String& move, int& fromCol, int& fromRow, int& toCol, i
     return true;
 }
 
-bool handleCapture(float toX, float toY, float toZ) {
-    Serial.println("\n=== CAPTURING PIECE ===");
-    
-    // Check if we have space for more captured pieces
-    bool isWhitePiece = toY < (MIN_Y_COORD + MAX_Y_COORD) / 2;
-    if ((isWhitePiece && capturedWhitePieces >= MAX_CAPTURED_PIECES) ||
-        (!isWhitePiece && capturedBlackPieces >= MAX_CAPTURED_PIECES)) {
-        Serial.println("ERROR: No more space for captured pieces!");
+// Transfer strategy named by a word of a move or of the "path" command
+bool parseTransferStrategy(const String& word, uint8_t& strategy) {
+    if (word.equalsIgnoreCase("movj")) {
+        strategy = TRANSFER_MOVJ;
+    } else if (word.equalsIgnoreCase("cp")) {
+        strategy = TRANSFER_CP;
+    } else if (word.equalsIgnoreCase("jump")) {
+        strategy = TRANSFER_JUMP;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* getTransferStrategyName(uint8_t strategy) {
+    switch (strategy) {
+        case TRANSFER_MOVJ: return "MOVJ";
+        case TRANSFER_CP:   return "CP";
+        default:            return "JUMP";
+    }
+}
+
+// Piece type named by its letter (p, r, n, b, q, k), index of pieceProfiles
+bool parsePiece(const String& word, uint8_t& piece) {
+    if (word.length() != 1) {
         return false;
     }
+    for (uint8_t i = 0; i < PIECE_TYPES; i++) {
+        if (tolower(word.charAt(0)) == pieceProfiles[i].letter) {
+            piece = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Words after a move: a transfer strategy and/or the letter of the moving piece, in any order
+bool parseMoveOptions(String options, uint8_t& strategy, uint8_t& piece) {
+    options.trim();
+    while (options.length() > 0) {
+        int space = options.indexOf(' ');
+        String word = space == -1 ? options : options.substring(0, space);
+        options = space == -1 ? String() : options.substring(space + 1);
+        options.trim();
+        if (!parseTransferStrategy(word, strategy) && !parsePiece(word, piece)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint8_t planCapture(float toX, float toY, float toZ, uint8_t strategy, TransferStep steps[], bool& isWhitePiece) {
+    // Check if we have space for more captured pieces, counting the captures still in the stream
+    isWhitePiece = toY < (MIN_Y_COORD + MAX_Y_COORD) / 2;
+    int whitePieces = capturedWhitePieces + countStreamCaptures(true);
+    int blackPieces = capturedBlackPieces + countStreamCaptures(false);
+    if ((isWhitePiece && whitePieces >= MAX_CAPTURED_PIECES) ||
+        (!isWhitePiece && blackPieces >= MAX_CAPTURED_PIECES)) {
+        Serial.println("ERROR: No more space for captured pieces!");
+        return 0;
+    }
 
     float depositX, depositY;
     
     // Calculate deposit position
     if (!isWhitePiece) {
         depositX = CAPTURED_PIECES_X;
-        depositY = CAPTURED_PIECES_Y + (PIECES_SPACING * capturedBlackPieces);
+        depositY = CAPTURED_PIECES_Y + (PIECES_SPACING * blackPieces);
     } else {
         depositX = CAPTURED_PIECES_X;
-        depositY = CAPTURED_PIECES_Y - (PIECES_SPACING * capturedWhitePieces);
+        depositY = CAPTURED_PIECES_Y - (PIECES_SPACING * whitePieces);
     }
 
     // Validate deposit coordinates
     if (!validateCoordinates(depositX, depositY, CAPTURED_PIECES_Z)) {
         Serial.println("ERROR: Invalid deposit coordinates!");
-        return false;
+        return 0;
     }
 
-    // Execute capture movement sequence
-    if (!executeMove(toX, toY, toZ, depositX, depositY, CAPTURED_PIECES_Z)) {
-        return false;
-    }
-
-    // Update counters only after successful capture
-    if (isWhitePiece) {
-        capturedWhitePieces++;
-    } else {
-        capturedBlackPieces++;
-    }
-
-    return true;
+    // Plan capture movement sequence, the captured piece is not known: hop over the tallest one
+    return planTransfer(toX, toY, toZ, depositX, depositY, CAPTURED_PIECES_Z, strategy, pieceProfiles[PIECE_UNKNOWN], steps);
 }
 
 // Funzione per determinare l'altezza di viaggio sicura in base alla colonna
@@ -588,15 +1368,28 @@ float getSafeTravelHeight(int col) {
     return SAFE_TRAVEL_HEIGHT;
 }
 
-bool executeMove(float fromX, float fromY, float fromZ, float toX, float toY, float toZ) {
-    Serial.println("\n=== EXECUTING MOVE ===");
-    
+// Copy a planned transfer into the move, after checking every point
+uint8_t copyTransfer(const TransferStep plan[], uint8_t count, TransferStep steps[]) {
+    for (int i = 0; i < count; i++) {
+        if (!validateCoordinates(plan[i].x, plan[i].y, plan[i].z)) {
+            Serial.println("ERROR: Invalid coordinates in movement sequence!");
+            return 0;
+        }
+        steps[i] = plan[i];
+    }
+    return count;
+}
+
+// Plan one pick-and-place transfer, returns its number of steps, 0 if a point is out of range
+uint8_t planTransfer(float fromX, float fromY, float fromZ, float toX, float toY, float toZ,
+                     uint8_t strategy, const PieceProfile& piece, TransferStep steps[]) {
     // Determina le colonne di partenza e arrivo (0-7, dove 0='a' e 7='h')
     int fromCol = round((fromX - matrix[0][0][0]) / ((matrix[0][7][0] - matrix[0][0][0]) / 7.0));
     int toCol = round((toX - matrix[0][0][0]) / ((matrix[0][7][0] - matrix[0][0][0]) / 7.0));
     
     // Determina l'altezza di viaggio in base alle colonne
     float travelHeight = min(getSafeTravelHeight(fromCol), getSafeTravelHeight(toCol));
+    float travelZ = travelHeight - 15.0;
     
     Serial.print("Move from column: ");
     Serial.print((char)('a' + fromCol));
@@ -604,55 +1397,394 @@ bool executeMove(float fromX, float fromY, float fromZ, float toX, float toY, fl
     Serial.print((char)('a' + toCol));
     Serial.print(" - Using travel height: ");
     Serial.println(travelHeight);
-    
-    // Array of movement steps with dynamic height
-    struct {
-        const char* description;
-        float x, y, z;
-        float speed;
-    } steps[] = {
-        {"Moving to safe height above source", fromX, fromY, travelHeight - 15.0, FAST_SPEED},
-        {"Moving down to pickup position", fromX, fromY, fromZ + PIECE_GRAB_OFFSET, SLOW_SPEED},
-        {"Moving to safe height with piece", fromX, fromY, travelHeight - 15.0, FAST_SPEED},
-        {"Moving above destination", toX, toY, travelHeight - 15.0, FAST_SPEED},
-        {"Moving down to place position", toX, toY, toZ + PIECE_GRAB_OFFSET, SLOW_SPEED},
-        {"Moving to final safe height", toX, toY, travelHeight - 15.0, FAST_SPEED}
+
+    // Travel at the fast profile of the piece, pickup and place at its slow approach profile
+    const SpeedProfile* fast = &piece.travel;
+    const SpeedProfile* slow = &piece.approach;
+
+    if (strategy == TRANSFER_JUMP) {
+        // Each hop lifts the piece by its own height above the higher end, and never above the travel height.
+        // A hop is one command with one speed: it travels at the fast profile.
+        TransferStep plan[JUMP_TRANSFER_STEPS] = {
+            {"Jumping to pickup position", fromX, fromY, fromZ + PIECE_GRAB_OFFSET, fast, GRIPPER_CLOSE, MOTION_JUMP, piece.height, travelZ},
+            {"Jumping to place position", toX, toY, toZ + PIECE_GRAB_OFFSET, fast, GRIPPER_OPEN, MOTION_JUMP, piece.height, travelZ},
+            {"Moving to final safe height", toX, toY, travelZ, fast, GRIPPER_NONE, MOTION_PTP}
+        };
+        return copyTransfer(plan, JUMP_TRANSFER_STEPS, steps);
+    }
+
+    // Movement steps with dynamic height, lift -> travel -> descend as one path with TRANSFER_CP
+    uint8_t motion = strategy == TRANSFER_CP ? MOTION_CP : MOTION_PTP;
+    TransferStep plan[TRANSFER_STEPS] = {
+        {"Moving to safe height above source", fromX, fromY, travelZ, fast, GRIPPER_NONE, MOTION_PTP},
+        {"Moving down to pickup position", fromX, fromY, fromZ + PIECE_GRAB_OFFSET, slow, GRIPPER_CLOSE, MOTION_PTP},
+        {"Moving to safe height with piece", fromX, fromY, travelZ, fast, GRIPPER_NONE, motion},
+        {"Moving above destination", toX, toY, travelZ, fast, GRIPPER_NONE, motion},
+        {"Moving down to place position", toX, toY, toZ + PIECE_GRAB_OFFSET, slow, GRIPPER_OPEN, motion},
+        {"Moving to final safe height", toX, toY, travelZ, fast, GRIPPER_NONE, MOTION_PTP}
     };
+    return copyTransfer(plan, TRANSFER_STEPS, steps);
+}
 
-    // Execute each movement step
-    for (int i = 0; i < 6; i++) {
-        Serial.print(i + 1);
-        Serial.print(". ");
-        Serial.print(steps[i].description);
-        Serial.print(" (Z=");
-        Serial.print(steps[i].z);
-        Serial.println(")");
+// CP velocity of a profile, in mm/s
+float getCPVelocity(const SpeedProfile* profile) {
+    return CP_VELOCITY * profile->velocityRatio / 100.0;
+}
 
-        if (!validateCoordinates(steps[i].x, steps[i].y, steps[i].z)) {
-            Serial.println("ERROR: Invalid coordinates in movement sequence!");
-            return false;
+// Queue the CP point of a step. When the next step goes on along the path, its corner is rounded:
+// the arm leaves the incoming segment cpBlendRadius before the point, passes the midpoint of a
+// quadratic curve with the point as control, and joins the outgoing segment cpBlendRadius after it.
+CmdStatus queueCPStep(const TransferStep* prev, const TransferStep& step, const TransferStep* next) {
+    bool isBlended = prev != NULL && next != NULL && next->motion == MOTION_CP &&
+                     step.gripper == GRIPPER_NONE && cpBlendRadius > 0;
+    if (!isBlended) {
+        return Dobot_BatchCPCmd(CPAbsoluteMode, step.x, step.y, step.z, getCPVelocity(step.profile));
+    }
+
+    float corner[3] = {step.x, step.y, step.z};
+    float in[3] = {step.x - prev->x, step.y - prev->y, step.z - prev->z};
+    float out[3] = {next->x - step.x, next->y - step.y, next->z - step.z};
+    float inLength = sqrt(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+    float outLength = sqrt(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+    // At most half of each segment, the rounding of the next corner needs the other half
+    float radius = min(cpBlendRadius, min(inLength, outLength) / 2.0);
+    if (radius <= 0.01) {
+        return Dobot_BatchCPCmd(CPAbsoluteMode, step.x, step.y, step.z, getCPVelocity(step.profile));
+    }
+
+    float entry[3], middle[3], exit[3];
+    for (int i = 0; i < 3; i++) {
+        entry[i] = corner[i] - in[i] / inLength * radius;
+        exit[i] = corner[i] + out[i] / outLength * radius;
+        middle[i] = 0.25 * entry[i] + 0.5 * corner[i] + 0.25 * exit[i];
+    }
+    float velocity = getCPVelocity(step.profile);
+    CmdStatus status = Dobot_BatchCPCmd(CPAbsoluteMode, entry[0], entry[1], entry[2], velocity);
+    if (status == CmdStatusOk) {
+        status = Dobot_BatchCPCmd(CPAbsoluteMode, middle[0], middle[1], middle[2], velocity);
+    }
+    if (status == CmdStatusOk) {
+        status = Dobot_BatchCPCmd(CPAbsoluteMode, exit[0], exit[1], exit[2], getCPVelocity(next->profile));
+    }
+    return status;
+}
+
+// Queue the point and gripper action of one transfer step without waiting in between
+CmdStatus queueStep(const TransferStep* prev, const TransferStep& step, const TransferStep* next, int number) {
+    Serial.print(number);
+    Serial.print(". ");
+    Serial.print(step.description);
+    Serial.print(" (Z=");
+    Serial.print(step.z);
+    Serial.println(step.motion == MOTION_CP ? ", CP)" : step.motion == MOTION_JUMP ? ", JUMP)" : ")");
+
+    // The speed and jump params go in the queue before the point, and only when they change.
+    // The head stays at r = 0, the orientation of the gripper at calibration.
+    CmdStatus status;
+    if (step.motion == MOTION_CP) {
+        status = queueCPStep(prev, step, next);
+    } else {
+        status = Dobot_BatchPTPCommonParams(step.profile->velocityRatio, step.profile->accelerationRatio);
+        if (status == CmdStatusOk && step.motion == MOTION_JUMP) {
+            if ((status = Dobot_BatchPTPJumpParams(step.jumpHeight, step.jumpLimit)) == CmdStatusOk) {
+                status = Dobot_BatchPTPCmd(JUMP_XYZ, step.x, step.y, step.z, 0);
+            }
+        } else if (status == CmdStatusOk) {
+            status = Dobot_BatchPTPCmd(MOVJ_XYZ, step.x, step.y, step.z, 0);
         }
+    }
 
-        // Execute movement with speed control
-        Dobot_SetPTPCmd(MOVJ_XYZ, steps[i].x, steps[i].y, steps[i].z, steps[i].speed);
-        
-        // Minimal delay for movement completion
-        if (i == 1 || i == 4) { // Solo per pickup e place
-            delay(500);
+    // Settle before pickup and place, then let the gripper finish its stroke. The pauses are
+    // in the Dobot queue too, so the steps are queued without waiting for the arm.
+    if (status == CmdStatusOk && step.gripper == GRIPPER_CLOSE) {
+        if ((status = Dobot_BatchDwell(GRIPPER_SETTLE_MS)) == CmdStatusOk &&
+            (status = Dobot_BatchEndEffectorGripper(true, true)) == CmdStatusOk) {  // Close gripper
+            status = Dobot_BatchDwell(GRIPPER_STROKE_MS);
+        }
+    } else if (status == CmdStatusOk && step.gripper == GRIPPER_OPEN) {
+        if ((status = Dobot_BatchDwell(GRIPPER_SETTLE_MS)) == CmdStatusOk &&
+            (status = Dobot_BatchEndEffectorGripper(true, false)) == CmdStatusOk &&  // Open gripper
+            (status = Dobot_BatchDwell(GRIPPER_STROKE_MS)) == CmdStatusOk) {
+            status = Dobot_BatchEndEffectorGripper(false, false); // Deactivate gripper
+        }
+    }
+    return status;
+}
+
+// Step i of the stream, counted from its oldest step
+TransferStep& streamStep(uint8_t i) {
+    return motionStream.steps[(motionStream.first + i) % STREAM_STEPS];
+}
+
+// Append a planned transfer of the move in slot to the stream, marking its first and last step
+// and the bounds of its phases
+void appendToStream(const TransferStep steps[], uint8_t count, uint8_t slot, uint8_t firstMark, uint8_t lastMark) {
+    for (uint8_t i = 0; i < count; i++) {
+        TransferStep& step = streamStep(motionStream.count++);
+        step = steps[i];
+        step.number = i + 1;
+        step.move = slot;
+        step.marks = (i == 0 ? firstMark : 0) | (i == count - 1 ? lastMark : 0);
+        if (i == 0 || steps[i - 1].phase != step.phase) {
+            step.marks |= STEP_PHASE_START;
+        }
+        if (i == count - 1 || steps[i + 1].phase != step.phase) {
+            step.marks |= STEP_PHASE_END;
         }
+    }
+}
 
-        // Handle gripper operations
-        if (i == 1) {
-            Dobot_SetEndEffectorGripper(true, true);  // Close gripper
-            delay(300);
-        } else if (i == 4) {
-            Dobot_SetEndEffectorGripper(true, false);  // Open gripper
-            delay(300);
-            Dobot_SetEndEffectorGripper(false, false); // Deactivate gripper
+// Captures of one color planned in the stream, not in the deposit area yet
+int countStreamCaptures(bool isWhite) {
+    int count = 0;
+    for (uint8_t i = 0; i < motionStream.count; i++) {
+        uint8_t marks = streamStep(i).marks;
+        if ((marks & STEP_CAPTURE_END) && ((marks & STEP_WHITE_PIECE) != 0) == isWhite) {
+            count++;
         }
     }
+    return count;
+}
 
-    return true;
+// Drop the sent steps whose last command the arm has run. After a stop only the ones strictly
+// before doneIndex, the command at doneIndex may have been cut short. A capture counts once its
+// piece is in the deposit area.
+void retireStreamSteps(uint64_t doneIndex, bool isStopped) {
+    MotionStream& stream = motionStream;
+    while (stream.sent > 0) {
+        uint64_t end = stream.stepEnd[stream.first];
+        if (isStopped ? end >= doneIndex : end > doneIndex) {
+            break;
+        }
+        TransferStep& step = stream.steps[stream.first];
+        // A short phase can end between two polls, its start is reported first
+        announcePhase(step);
+        uint8_t marks = step.marks;
+        StreamMove& move = stream.moves[step.move];
+        uint32_t elapsed = millis() - move.startTime;
+        if (marks & STEP_CAPTURE_END) {
+            if (marks & STEP_WHITE_PIECE) {
+                capturedWhitePieces++;
+            } else {
+                capturedBlackPieces++;
+            }
+        }
+        if (marks & STEP_PHASE_END) {
+            sendMoveEvent(move.id, move.name, String("END:") + phaseNames[step.phase] + ":" + String(elapsed));
+        }
+        if (marks & STEP_MOVE_END) {
+            Serial.print("=== MOVE COMPLETE in ");
+            Serial.print(elapsed);
+            Serial.println(" ms ===\n");
+            sendMoveEvent(move.id, move.name, "DONE:" + String(elapsed));
+        }
+        stream.first = (stream.first + 1) % STREAM_STEPS;
+        stream.sent--;
+        stream.count--;
+    }
+}
+
+// Queue the oldest step not sent yet
+CmdStatus sendStreamStep() {
+    MotionStream& stream = motionStream;
+    uint8_t i = stream.sent;
+    const TransferStep& step = streamStep(i);
+
+    if (step.marks & STEP_CAPTURE_START) {
+        Serial.println("\n=== CAPTURING PIECE ===");
+    } else if (step.marks & STEP_MOVE_START) {
+        Serial.println("\n=== EXECUTING MOVE ===");
+    }
+    // The previous step is gone once the arm has run it, then the corner is not rounded
+    const TransferStep* prev = i > 0 ? &streamStep(i - 1) : NULL;
+    const TransferStep* next = i + 1 < stream.count ? &streamStep(i + 1) : NULL;
+    CmdStatus status = queueStep(prev, step, next, step.number);
+    if (status == CmdStatusOk) {
+        stream.stepEnd[(stream.first + i) % STREAM_STEPS] = Dobot_BatchIndex();
+        stream.sent++;
+    }
+    return status;
+}
+
+// Start running the stream from loop(), with feed as its planner. Nothing waits here.
+void startStream(MoveFeed feed) {
+    MotionStream& stream = motionStream;
+    stream.feed = feed;
+    stream.isInterrupted = false;
+    if (!stream.isRunning) {
+        stream.isRunning = true;
+        stream.isMoved = false;
+    }
+}
+
+// Executor of the stream, one tick per loop(): asks feed for more moves whenever there is room for
+// one, sends one step when at most streamLookahead commands wait in the Dobot queue, otherwise
+// follows the queue without waiting and retires the steps the arm has run, until the stream is
+// empty. On a Dobot error the queue is stopped and cleared, and the steps left stay for RESUME or ABORT.
+void streamTick() {
+    MotionStream& stream = motionStream;
+    CmdStatus status;
+
+    if (!stream.isRunning) {
+        return;
+    }
+    while (stream.feed && STREAM_STEPS - stream.count >= 2 * TRANSFER_STEPS) {
+        if (!stream.feed()) {
+            stream.feed = NULL;
+        }
+    }
+    if (stream.sent < stream.count && Dobot_BatchHasRoom(STEP_MAX_COMMANDS, streamLookahead)) {
+        if (!stream.isMoved) {
+            markArmMoving();
+            stream.isMoved = true;
+        }
+        status = sendStreamStep();
+    } else if (stream.count > 0) {
+        // The queue is full or everything is queued: the room comes as the arm runs the steps
+        status = Dobot_BatchPoll();
+    } else {
+        if (stream.isMoved) {
+            // The last retired step is still in its slot
+            const TransferStep& last = stream.steps[(stream.first + STREAM_STEPS - 1) % STREAM_STEPS];
+            saveArmPose(last.x, last.y, last.z);
+        }
+        stream.isRunning = false;
+        return;
+    }
+    if (status == CmdStatusStopped) {
+        // The e-stop ISR stopped the arm, finishEmergencyStop stops the stream at the next turn
+        return;
+    }
+    if (status != CmdStatusOk) {
+        Serial.print("ERROR: Dobot command failed, status ");
+        Serial.println(status);
+        if (status == CmdStatusAlarm) {
+            printDobotAlarms();
+        }
+        stopStream(status == CmdStatusAlarm ? String("Dobot alarm") : "Dobot status " + String(status));
+        return;
+    }
+    retireStreamSteps(Dobot_BatchDoneIndex(), false);
+    announceStreamPhase();
+}
+
+// Report the phase the arm is running once its first step is the oldest one sent: the steps
+// before it are done
+void announceStreamPhase() {
+    if (motionStream.sent > 0) {
+        announcePhase(motionStream.steps[motionStream.first]);
+    }
+}
+
+// Report the start of the phase of step if it is its first step, once. The first phase of a move
+// starts its clock.
+void announcePhase(TransferStep& step) {
+    if ((step.marks & STEP_PHASE_START) == 0 || (step.marks & STEP_ANNOUNCED) != 0) {
+        return;
+    }
+    step.marks |= STEP_ANNOUNCED;
+    StreamMove& move = motionStream.moves[step.move];
+    if (move.startTime == 0) {
+        move.startTime = millis();
+    }
+    sendMoveEvent(move.id, move.name, String("START:") + phaseNames[step.phase]);
+}
+
+// Stop the arm now and keep the steps it has not finished for RESUME or ABORT, the move
+// in progress is reported as failed for reason
+void stopStream(const String& reason) {
+    if (!abortStream()) {
+        Serial.println("ERROR: Dobot queue could not be stopped!");
+    }
+    reportStreamStop(reason);
+}
+
+// Drop the Dobot queue under the stream, false if the Dobot did not clear it
+bool abortStream() {
+    MotionStream& stream = motionStream;
+    uint64_t doneIndex;
+    bool isCleared = Dobot_BatchAbort(&doneIndex) == CmdStatusOk;
+    if (isCleared) {
+        retireStreamSteps(doneIndex, true);
+    }
+    // The queue was cleared, the steps left are sent again on resume
+    stream.sent = 0;
+    stream.isRunning = false;
+    stream.isInterrupted = true;
+    return isCleared;
+}
+
+void reportStreamStop(const String& reason) {
+    MotionStream& stream = motionStream;
+    Serial.print("Move interrupted, steps left: ");
+    Serial.println(stream.count);
+    sendToMKR("CALIB_MSG:ERROR: Move interrupted, send RESUME or ABORT");
+    if (stream.count > 0) {
+        const StreamMove& move = stream.moves[stream.steps[stream.first].move];
+        sendMoveEvent(move.id, move.name, "ERROR:" + reason);
+    }
+}
+
+// Print the alarms raised by the Dobot, to the MKR too
+void printDobotAlarms() {
+    uint8_t codes[8];
+    uint8_t count = 0;
+    if (Dobot_GetAlarms(codes, sizeof(codes), &count) != CmdStatusOk) {
+        Serial.println("ERROR: Dobot alarms not read");
+        return;
+    }
+    if (count == 0) {
+        Serial.println("Dobot alarms: none");
+        return;
+    }
+    for (uint8_t i = 0; i < count; i++) {
+        String alarm = "0x" + String(codes[i], HEX) + " " + Dobot_AlarmName(codes[i]);
+        Serial.println("Dobot alarm " + alarm);
+        sendToMKR("CALIB_MSG:ERROR: Dobot alarm " + alarm);
+    }
+}
+
+void resumeMove() {
+    if (motionStream.isRunning || !motionStream.isInterrupted) {
+        Serial.println("No interrupted move to resume");
+        return;
+    }
+    if (isEmergencyStop) {
+        Serial.println("ERROR: Emergency stop is active!");
+        return;
+    }
+    // The cause of the alarm is expected to be removed before RESUME
+    Dobot_ClearAlarms();
+    Serial.print("Resuming move, steps left: ");
+    Serial.println(motionStream.count);
+    if (motionStream.count > 0) {
+        const StreamMove& move = motionStream.moves[motionStream.steps[motionStream.first].move];
+        sendMoveEvent(move.id, move.name, "RESUMED");
+    }
+    // The moves queued meanwhile follow
+    startStream(feedQueue);
+}
+
+// Drop the steps left and the queued moves, a capture whose piece reached the deposit area stays counted
+void abortMove() {
+    if (!motionStream.isInterrupted) {
+        Serial.println("No interrupted move to abort");
+        return;
+    }
+    // Each move left once, its steps are contiguous
+    for (uint8_t i = 0; i < motionStream.count; i++) {
+        if (i == 0 || streamStep(i).move != streamStep(i - 1).move) {
+            const StreamMove& move = motionStream.moves[streamStep(i).move];
+            sendMoveEvent(move.id, move.name, "ABORTED");
+        }
+    }
+    motionStream.count = 0;
+    motionStream.feed = NULL;
+    motionStream.isInterrupted = false;
+    clearMoveQueue("move aborted");
+    Dobot_ClearAlarms();
+    Serial.println("Move aborted, check the pieces on the board");
+    sendToMKR("CALIB_MSG:Move aborted, check the pieces on the board");
 }
 
 // LED functions removed - now handled by MKR
@@ -660,10 +1792,8 @@ bool executeMove(float fromX, float fromY, float fromZ, float toX, float toY, fl
 // ===== FUNZIONI PER INPUT DA MONITOR SERIALE =====
 
 void handleSerialInput() {
-    if (Serial.available()) {
-        String input = Serial.readStringUntil('\n');
-        input.trim();
-        
+    String input;
+    if (readLine(Serial, serialLine, input)) {
         if (input.length() > 0) {
             Serial.println("Comando ricevuto: " + input);
             
@@ -674,10 +1804,25 @@ void handleSerialInput() {
             else if (input == "status") {
                 printSystemStatus();
             }
+            else if (input == "calib confirm" || input == "calib abort") {
+                // The calibration steps wait for these while they keep the console live
+                if (!isCalibrating) {
+                    Serial.println("ERROR: No calibration in progress");
+                    return;
+                }
+                if (input == "calib confirm") {
+                    isCalibrationConfirmed = true;
+                } else {
+                    isCalibrationAborted = true;
+                }
+            }
             else if (input == "calib") {
                 printCalibrationStatus();
             }
             else if (input == "calibrate") {
+                if (!isArmFree()) {
+                    return;
+                }
                 calibrateChessboard();
             }
             else if (input == "start") {
@@ -685,6 +1830,9 @@ void handleSerialInput() {
                     Serial.println("ERROR: Cannot start game without calibration!");
                     return;
                 }
+                if (!isArmFree() || !ensureHomed()) {
+                    return;
+                }
                 gameInProgress = true;
                 capturedPieceCount = 0;
                 capturedWhitePieces = 0;
@@ -696,25 +1844,121 @@ void handleSerialInput() {
                 Serial.println("Game stopped");
             }
             else if (input == "test") {
+                if (!isArmFree()) {
+                    return;
+                }
                 testDobotMovement();
             }
             else if (input == "gripper") {
+                if (!isArmFree()) {
+                    return;
+                }
                 testGripper();
             }
             else if (input.startsWith("move ")) {
                 String move = input.substring(5);
                 simulateMove(move);
             }
+            else if (input.startsWith("path ")) {
+                if (!parseTransferStrategy(input.substring(5), transferStrategy)) {
+                    Serial.println("ERROR: Use path movj, path cp or path jump");
+                    return;
+                }
+                Serial.print("Transfer strategy: ");
+                Serial.println(getTransferStrategyName(transferStrategy));
+            }
+            else if (input == "profile") {
+                printSpeedProfiles();
+            }
+            else if (input.startsWith("profile ")) {
+                setSpeedProfile(input.substring(8));
+            }
+            else if (input.startsWith("moves ")) {
+                if (!gameInProgress) {
+                    Serial.println("ERROR: Partita non in corso!");
+                    return;
+                }
+                processMoveData(input.substring(6));
+            }
+            else if (input == "queue") {
+                printMoveQueue();
+            }
+            else if (input == "queue clear") {
+                clearMoveQueue("cleared");
+            }
+            else if (input.startsWith("queue cancel ")) {
+                if (!cancelQueuedMove(input.substring(13).toInt())) {
+                    Serial.println("ERROR: Mossa non in coda!");
+                }
+            }
+            else if (input.startsWith("lookahead ")) {
+                long lookahead = input.substring(10).toInt();
+                if (lookahead < STEP_MAX_COMMANDS || lookahead > 255) {
+                    Serial.print("ERROR: Lookahead must be ");
+                    Serial.print(STEP_MAX_COMMANDS);
+                    Serial.println("..255 commands");
+                    return;
+                }
+                streamLookahead = lookahead;
+                Serial.print("Dobot queue lookahead: ");
+                Serial.print(streamLookahead);
+                Serial.println(" commands");
+            }
+            else if (input.startsWith("blend ")) {
+                float radius = input.substring(6).toFloat();
+                if (radius < 0) {
+                    Serial.println("ERROR: Blend radius must be >= 0");
+                    return;
+                }
+                cpBlendRadius = radius;
+                Serial.print("CP blend radius: ");
+                Serial.print(cpBlendRadius);
+                Serial.println(" mm");
+            }
             else if (input == "emergency") {
                 emergencyStop();
             }
+            else if (input == "resume") {
+                resumeMove();
+            }
+            else if (input == "abort") {
+                abortMove();
+            }
+            else if (input == "estop") {
+                testEstopButton();
+            }
             else if (input == "reset") {
+                if (digitalRead(ESTOP_PIN) == LOW) {
+                    Serial.println("ERROR: E-stop button still pressed");
+                    return;
+                }
                 isEmergencyStop = false;
+                Dobot_SetEndEffectorGripper(false, false);
                 Serial.println("Emergency stop reset");
             }
             else if (input == "home") {
+                if (!isArmFree()) {
+                    return;
+                }
                 Serial.println("Moving to home position...");
-                Dobot_SetPTPCmd(MOVJ_XYZ, 200, 0, 50, 50);
+                markArmMoving();
+                CmdStatus status = Dobot_SetPTPCmd(MOVJ_XYZ, 200, 0, 50, 0);
+                if (status != CmdStatusOk) {
+                    Serial.print("ERROR: Home position not reached, status ");
+                    Serial.println(status);
+                    return;
+                }
+                saveArmPose(200, 0, 50);
+            }
+            else if (input == "alarms") {
+                printDobotAlarms();
+            }
+            else if (input == "rehome") {
+                if (!isArmFree()) {
+                    return;
+                }
+                isHomed = false;
+                ensureHomed();
             }
             else {
                 Serial.println("Comando non riconosciuto. Digita 'help' per vedere i comandi disponibili.");
@@ -725,12 +1969,26 @@ void handleSerialInput() {
 
 void processMKRCommand(String data) {
     // Process commands from MKR
-    if (data.equalsIgnoreCase("CALIBRATE")) {
+    if (data.equalsIgnoreCase("STOP")) {
+        emergencyStop();
+    } else if (data.equalsIgnoreCase("CALIBRATE")) {
+        if (!isArmFree()) {
+            sendToMKR("CALIB_MSG:ERROR: Arm busy, calibration not started");
+            return;
+        }
         calibrateChessboard();
     } else if (data.equalsIgnoreCase("STARTGAME")) {
         if (!isCalibrated) {
             Serial.println("ERROR: Cannot start game without calibration!");
-            Serial1.println("CALIB_MSG:ERROR: Cannot start game without calibration!");
+            sendToMKR("CALIB_MSG:ERROR: Cannot start game without calibration!");
+            return;
+        }
+        if (!isArmFree()) {
+            sendToMKR("CALIB_MSG:ERROR: Arm busy, game not started");
+            return;
+        }
+        if (!ensureHomed()) {
+            sendToMKR("CALIB_MSG:ERROR: Homing failed, game not started");
             return;
         }
         gameInProgress = true;
@@ -740,14 +1998,37 @@ void processMKRCommand(String data) {
         Serial.println("Game started");
     } else if (data.equalsIgnoreCase("ENDGAME")) {
         gameInProgress = false;
+        clearMoveQueue("game ended");
         Serial.println("Game ended");
     } else if (data.startsWith("HIGHLIGHT:")) {
         String squares = data.substring(9);
         Serial.print("DEBUG - Highlighting squares string: '");
         Serial.print(squares);
         Serial.println("'");
+    } else if (data.equalsIgnoreCase("RESUME")) {
+        resumeMove();
+    } else if (data.equalsIgnoreCase("ABORT")) {
+        abortMove();
+    } else if (data.equalsIgnoreCase("CALIB_CONFIRM") || data.equalsIgnoreCase("CALIB_ABORT")) {
+        // Late, the calibration they were for is over
+        Serial.println("No calibration in progress, " + data + " ignored");
     } else if (data.equalsIgnoreCase("CLEAR")) {
         // LED control removed - now handled by MKR
+    } else if (data.startsWith("QUEUE:ADD:")) {
+        // Premoves: queued like a move, also while one is running
+        if (!gameInProgress || !isCalibrated) {
+            sendToMKR("CALIB_MSG:ERROR: No game in progress, moves not queued");
+            return;
+        }
+        processMoveData(data.substring(10));
+    } else if (data.startsWith("QUEUE:CANCEL:")) {
+        if (!cancelQueuedMove(data.substring(13).toInt())) {
+            sendToMKR("CALIB_MSG:ERROR: Move " + data.substring(13) + " not queued");
+        }
+    } else if (data.equalsIgnoreCase("QUEUE:CLEAR")) {
+        clearMoveQueue("cleared");
+    } else if (data.equalsIgnoreCase("QUEUE")) {
+        reportMoveQueue();
     } else if (gameInProgress) {
         if (!isCalibrated) {
             Serial.println("ERROR: Cannot make moves without calibration!");
@@ -772,6 +2053,8 @@ void printStartupInfo() {
     Serial.println(gameInProgress ? "IN PROGRESS" : "STOPPED");
     Serial.print("Emergency Stop: ");
     Serial.println(isEmergencyStop ? "ACTIVE" : "INACTIVE");
+    Serial.print("Homing: ");
+    Serial.println(isHomed ? "DONE" : "REQUIRED");
     Serial.println("========================================");
 }
 
@@ -782,15 +2065,32 @@ void printHelp() {
     Serial.println("help, ?          - Mostra questo aiuto");
     Serial.println("status           - Stato del sistema");
     Serial.println("calib            - Stato calibrazione");
+    Serial.println("calib confirm    - Conferma il passo di calibrazione (come CALIB_CONFIRM dal MKR)");
+    Serial.println("calib abort      - Annulla la calibrazione, resta quella precedente");
     Serial.println("calibrate        - Avvia calibrazione");
     Serial.println("start            - Avvia partita");
     Serial.println("stop             - Ferma partita");
     Serial.println("test             - Test movimento Dobot");
     Serial.println("gripper          - Test gripper");
     Serial.println("move e2e4        - Simula mossa (es: e2e4)");
-    Serial.println("emergency        - Stop di emergenza");
+    Serial.println("move e2e4 jump n - Mossa con strategia (movj, cp, jump) e pezzo (p r n b q k)");
+    Serial.println("moves e2e4, e7e5 - Sequenza di mosse senza fermate tra una e l'altra");
+    Serial.println("queue            - Mosse in coda (anche move/moves durante una mossa)");
+    Serial.println("queue cancel 7   - Toglie dalla coda la mossa con id 7");
+    Serial.println("queue clear      - Svuota la coda delle mosse");
+    Serial.println("lookahead 20     - Comandi tenuti nella coda del Dobot davanti al braccio");
+    Serial.println("path movj|cp|jump - Strategia di default dei trasferimenti");
+    Serial.println("blend 10         - Raggio di raccordo CP in mm (0 = spigolo vivo)");
+    Serial.println("profile          - Profili di velocità per tipo di pezzo");
+    Serial.println("profile n travel 90 70 - Velocità/accelerazione % di un profilo (travel|approach)");
+    Serial.println("emergency        - Stop di emergenza, ferma subito anche la mossa in corso");
+    Serial.println("estop            - Simula il pulsante di emergenza (pin A8) e ne misura la latenza");
     Serial.println("reset            - Reset stop di emergenza");
+    Serial.println("resume           - Riprende la mossa interrotta");
+    Serial.println("abort            - Annulla la mossa interrotta");
+    Serial.println("alarms           - Allarmi attivi del Dobot");
     Serial.println("home             - Vai a posizione home");
+    Serial.println("rehome           - Ciclo di homing completo del Dobot");
     Serial.println("========================================");
 }
 
@@ -804,6 +2104,40 @@ void printSystemStatus() {
     Serial.println(gameInProgress ? "In corso" : "Fermata");
     Serial.print("Stop di emergenza: ");
     Serial.println(isEmergencyStop ? "Attivo" : "Inattivo");
+    Serial.print("Homing: ");
+    Serial.println(isHomed ? "Eseguito" : "Da eseguire");
+    Serial.print("Mossa in corso: ");
+    if (motionStream.isRunning) {
+        Serial.print("Sì, passi rimasti ");
+        Serial.println(motionStream.count);
+    } else {
+        Serial.println("No");
+    }
+    Serial.print("Mossa interrotta: ");
+    Serial.println(motionStream.isInterrupted ? "Sì (resume/abort)" : "No");
+    Serial.print("Mosse in coda: ");
+    Serial.print(moveQueue.count);
+    Serial.print("/");
+    Serial.println(MOVE_QUEUE_SIZE);
+    Serial.print("Strategia trasferimento: ");
+    Serial.print(getTransferStrategyName(transferStrategy));
+    if (transferStrategy == TRANSFER_CP) {
+        Serial.print(", raccordo ");
+        Serial.print(cpBlendRadius);
+        Serial.print(" mm");
+    }
+    Serial.println();
+    Serial.print("Lookahead coda Dobot: ");
+    Serial.print(streamLookahead);
+    Serial.println(" comandi");
+    const ChessLinkStats& link = mkrLink.stats();
+    Serial.print("Collegamento MKR: ");
+    Serial.print(mkrLink.isPeerUp() ? "attivo" : "non risponde");
+    Serial.print(", inviati "); Serial.print(link.sent);
+    Serial.print(", ricevuti "); Serial.print(link.received);
+    Serial.print(", ritrasmessi "); Serial.print(link.retransmits);
+    Serial.print(", CRC errati "); Serial.print(link.crcErrors);
+    Serial.print(", persi "); Serial.println(link.failed + link.dropped);
     Serial.print("Pezzi catturati bianchi: ");
     Serial.println(capturedWhitePieces);
     Serial.print("Pezzi catturati neri: ");
@@ -847,7 +2181,8 @@ void testDobotMovement() {
     
     // Test movimento sicuro
     Serial.println("1. Movimento a posizione sicura...");
-    Dobot_SetPTPCmd(MOVJ_XYZ, 200, 0, 50, 50);
+    markArmMoving();
+    CmdStatus status = Dobot_SetPTPCmd(MOVJ_XYZ, 200, 0, 50, 0);
     delay(2000);
     
     Serial.println("2. Test movimento a coordinate scacchiera...");
@@ -864,12 +2199,23 @@ void testDobotMovement() {
         Serial.print(", Z=");
         Serial.println(testZ);
         
-        Dobot_SetPTPCmd(MOVJ_XYZ, testX, testY, testZ, 50);
+        if (status == CmdStatusOk) {
+            status = Dobot_SetPTPCmd(MOVJ_XYZ, testX, testY, testZ, 0);
+        }
         delay(3000);
     }
     
     Serial.println("3. Ritorno a posizione home...");
-    Dobot_SetPTPCmd(MOVJ_XYZ, 200, 0, 50, 50);
+    if (status == CmdStatusOk) {
+        status = Dobot_SetPTPCmd(MOVJ_XYZ, 200, 0, 50, 0);
+    }
+    if (status != CmdStatusOk) {
+        // The arm may be anywhere, the state stays dirty
+        Serial.print("ERROR: Test movimento interrotto, stato ");
+        Serial.println(status);
+        return;
+    }
+    saveArmPose(200, 0, 50);
     delay(2000);
     
     Serial.println("Test movimento completato!");
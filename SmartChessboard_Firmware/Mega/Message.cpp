@@ -29,14 +29,11 @@
 *********************************************************************************************************/
 ProtocolResult MessageRead(ProtocolHandler *protocolHandler, Message *message)
 {
-    RingBuffer *rxPacketQueue = &protocolHandler->rxPacketQueue;
-    Packet *packet = &protocolHandler->rxAppPacket;
+    const Packet *packet;
 
-    if (RingBufferIsEmpty(rxPacketQueue)) {
+    if (MessagePeek(protocolHandler, &packet) != ProtocolNoError) {
         return ProtocolReadMessageQueueEmpty;
     }
-    // Read a packet
-    RingBufferDequeue(rxPacketQueue, packet);
     // Transform to message
     message->id = packet->payload.id;
     message->rw = packet->payload.ctrl & 0x01;
@@ -45,36 +42,109 @@ ProtocolResult MessageRead(ProtocolHandler *protocolHandler, Message *message)
     if (message->paramsLen) {
         memcpy(&message->params[0], &packet->payload.params[0], message->paramsLen);
     }
+    MessageConsume(protocolHandler);
+    return ProtocolNoError;
+}
+
+/*********************************************************************************************************
+** Function name:       MessagePeek
+** Descriptions:        Get the oldest rx packet in place, without copying it
+** Input parameters:    protocolHandler
+** Output parameters:   packet: valid until MessageConsume
+** Returned value:      ProtocolResult
+*********************************************************************************************************/
+ProtocolResult MessagePeek(ProtocolHandler *protocolHandler, const Packet **packet)
+{
+    RingBuffer *rxPacketQueue = &protocolHandler->rxPacketQueue;
+
+    if (RingBufferIsEmpty(rxPacketQueue)) {
+        return ProtocolReadMessageQueueEmpty;
+    }
+    *packet = (const Packet *)RingBufferDataAt(rxPacketQueue, 0);
     return ProtocolNoError;
 }
 
+/*********************************************************************************************************
+** Function name:       MessageConsume
+** Descriptions:        Release the rx packet got by MessagePeek
+** Input parameters:    protocolHandler
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void MessageConsume(ProtocolHandler *protocolHandler)
+{
+    RingBufferDequeue(&protocolHandler->rxPacketQueue, 0);
+}
+
+/*********************************************************************************************************
+** Function name:       MessageHead
+** Descriptions:        Fill the frame header, id and ctrl of a message
+** Input parameters:    message
+** Output parameters:   head: sync bytes, payload length, id and ctrl
+** Returned value:      Checksum of the frame
+*********************************************************************************************************/
+static uint8_t MessageHead(const Message *message, uint8_t *head)
+{
+    uint8_t checksum;
+
+    head[0] = SYNC_BYTE;
+    head[1] = SYNC_BYTE;
+    head[2] = message->paramsLen + 2;
+    head[3] = message->id;
+    head[4] = (message->rw & 0x01) | ((message->isQueued << 1) & 0x02);
+
+    checksum = head[3] + head[4];
+    for (uint8_t i = 0; i < message->paramsLen; i++) {
+        checksum += message->params[i];
+    }
+    return (uint8_t)(0 - checksum);
+}
+
+/*********************************************************************************************************
+** Function name:       MessageSerialize
+** Descriptions:        Serialize a message as a frame into a plain buffer
+** Input parameters:    message
+** Output parameters:   frame: at least paramsLen + 6 bytes
+** Returned value:      Size of the frame
+*********************************************************************************************************/
+uint8_t MessageSerialize(const Message *message, uint8_t *frame)
+{
+    uint8_t headLen = sizeof(PacketHeader) + 2;
+    uint8_t checksum = MessageHead(message, frame);
+
+    memcpy(&frame[headLen], message->params, message->paramsLen);
+    frame[headLen + message->paramsLen] = checksum;
+    return headLen + message->paramsLen + 1;
+}
+
 /*********************************************************************************************************
 ** Function name:       MessageWrite
-** Descriptions:        Write a message to tx packet queue
+** Descriptions:        Serialize a message as a frame straight into the tx raw byte queue
 ** Input parameters:    protocolHandler and message
 ** Output parameters:   None
 ** Returned value:      ProtocolResult
 *********************************************************************************************************/
 ProtocolResult MessageWrite(ProtocolHandler *protocolHandler, const Message *message)
 {
-    RingBuffer *txPacketQueue = &protocolHandler->txPacketQueue;
-    Packet *packet = &protocolHandler->txAppPacket;
+    RingBuffer *txRawByteQueue = &protocolHandler->txRawByteQueue;
+    uint8_t head[sizeof(PacketHeader) + 2];
+    uint8_t checksum;
+    uint32_t frameLen = sizeof(head) + message->paramsLen + 1;
 
-    if (RingBufferIsFull(txPacketQueue)) {
+    // The whole frame or nothing, the UART sends what is queued
+    if (RingBufferGetLeft(txRawByteQueue) < frameLen) {
         return ProtocolWritePacketQueueFull;
     }
-    // Header
-    packet->header.payloadLen = message->paramsLen + 2;
-
-    // Payload
-    packet->payload.id = message->id;
-    packet->payload.ctrl = 0;
-    packet->payload.ctrl |= message->rw & 0x01;
-    packet->payload.ctrl |= (message->isQueued << 1) & 0x02;
-    if (message->paramsLen) {
-        memcpy(&packet->payload.params[0], &message->params[0], message->paramsLen);
-    }
-    RingBufferEnqueue(txPacketQueue, packet);
+    checksum = MessageHead(message, head);
+
+    // Three spans, no intermediate packet. The TX ISR reads the length byte as soon as the previous
+    // frame is out, so the frame is published with a single commit, never header first
+    RingBufferStageBulk(txRawByteQueue, 0, head, sizeof(head));
+    RingBufferStageBulk(txRawByteQueue, sizeof(head), message->params, message->paramsLen);
+    RingBufferStageBulk(txRawByteQueue, sizeof(head) + message->paramsLen, &checksum, 1);
+    // The copies must not move past the commit, even when inlined by the link time optimizer
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    RingBufferCommitWrite(txRawByteQueue, frameLen);
 
     return ProtocolNoError;
 }
@@ -90,4 +160,4 @@ void MessageProcess(ProtocolHandler *protocolHandler)
 {
     PacketProcess(protocolHandler);
 }
-
+
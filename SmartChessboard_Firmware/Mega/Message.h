@@ -40,15 +40,42 @@ extern "C" {
 *********************************************************************************************************/
 extern ProtocolResult MessageRead(ProtocolHandler *protocolHandler, Message *message);
 
+/*********************************************************************************************************
+** Function name:       MessagePeek
+** Descriptions:        Get the oldest rx packet in place, without copying it
+** Input parameters:    protocolHandler
+** Output parameters:   packet: valid until MessageConsume
+** Returned value:      ProtocolResult
+*********************************************************************************************************/
+extern ProtocolResult MessagePeek(ProtocolHandler *protocolHandler, const Packet **packet);
+
+/*********************************************************************************************************
+** Function name:       MessageConsume
+** Descriptions:        Release the rx packet got by MessagePeek
+** Input parameters:    protocolHandler
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void MessageConsume(ProtocolHandler *protocolHandler);
+
 /*********************************************************************************************************
 ** Function name:       MessageWrite
-** Descriptions:        Write a message to tx message queue
+** Descriptions:        Serialize a message as a frame straight into the tx raw byte queue
 ** Input parameters:    protocolHandler and message
 ** Output parameters:   None
 ** Returned value:      ProtocolResult
 *********************************************************************************************************/
 extern ProtocolResult MessageWrite(ProtocolHandler *protocolHandler, const Message *message);
 
+/*********************************************************************************************************
+** Function name:       MessageSerialize
+** Descriptions:        Serialize a message as a frame into a plain buffer
+** Input parameters:    message
+** Output parameters:   frame: at least paramsLen + 6 bytes
+** Returned value:      Size of the frame
+*********************************************************************************************************/
+extern uint8_t MessageSerialize(const Message *message, uint8_t *frame);
+
 /*********************************************************************************************************
 ** Function name:       MessageProcess
 ** Descriptions:
@@ -18,7 +18,7 @@
 *********************************************************************************************************/
 #include "Packet.h"
 #include <stdio.h>
-#include <arduino.h>
+#include <Arduino.h>
 #include "HardwareSerial.h"
 
 /*********************************************************************************************************
@@ -32,125 +32,92 @@ static void PacketReadProcess(ProtocolHandler *protocolHandler)
 {
     RingBuffer *rxRawByteQueue = &protocolHandler->rxRawByteQueue;
     RingBuffer *rxPacketQueue = &protocolHandler->rxPacketQueue;
-    Packet *packet = &protocolHandler->rxDLPacket;
+    PacketParser *parser = &protocolHandler->rxParser;
+    uint8_t *data;
+    uint32_t count;
 
-    while (1) {
-        uint8_t packetLen = RingBufferGetCount(rxRawByteQueue);
-        /*
-         * 2 sync bytes, 1 payload length, at least 2 payload(id, ctrl), and 1 checksum
-         * That is, 4 extra bytes, and at least 2 payload
-         */
-        if (packetLen < 6) {
-            break;
-        }
-        // The first sync byte
-        uint8_t syncByte1 = *(uint8_t *)RingBufferDataAt(rxRawByteQueue, 0);
-        if (syncByte1 != SYNC_BYTE) {
-            RingBufferDequeue(rxRawByteQueue, 0);
-            continue;
-        }
-        // The second sync byte
-        uint8_t syncByte2 = *(uint8_t *)RingBufferDataAt(rxRawByteQueue, 1);
-        if (syncByte2 != SYNC_BYTE) {
-            RingBufferDequeue(rxRawByteQueue, 0);
-            RingBufferDequeue(rxRawByteQueue, 0);
-            continue;
-        }
-        // The payload length
-        uint8_t payloadLen = *(uint8_t *)RingBufferDataAt(rxRawByteQueue, 2);
-        if (payloadLen >= SYNC_BYTE) {
-            RingBufferDequeue(rxRawByteQueue, 0);
-            continue;
-        } else if (payloadLen < 2) {
-            Serial.print("[ERROR]Wrong payload length:");
-            Serial.println(payloadLen);
-            RingBufferDequeue(rxRawByteQueue, 0);
-            continue;
-        }
+    /*
+     * Each raw byte is looked at once: the state, the byte count and the running checksum
+     * are kept in the parser, and the packet is built in the free slot of rxPacketQueue.
+     * While rxPacketQueue is full, the raw bytes wait in rxRawByteQueue.
+     */
+    while (RingBufferIsFull(rxPacketQueue) == false &&
+           (count = RingBufferPeekSpan(rxRawByteQueue, (void **)&data)) != 0) {
+        Packet *packet;
+        RingBufferWriteSpan(rxPacketQueue, (void **)&packet);
+        uint8_t *payload = (uint8_t *)&packet->payload;
+        bool isPacketDone = false;
+        uint32_t used = 0;
 
-        // If not enough data now, just break to wait
-        if (packetLen < payloadLen + 4) {
-            break;
-        }
-        // The payload will never larger than SYNC_BYTE
-        if (packetLen >= SYNC_BYTE) {
-            RingBufferDequeue(rxRawByteQueue, 0);
-            continue;
-        }
+        while (used < count && isPacketDone == false) {
+            uint8_t byte = data[used++];
+            switch (parser->state) {
+            case PacketParseSyncByte1:
+                if (byte == SYNC_BYTE) {
+                    parser->state = PacketParseSyncByte2;
+                }
+                break;
 
-        // Checksum
-        uint8_t checksum = 0;
-        // payloadLen + 1, so we also plus the original checksum!!!
-        for (uint32_t i = 0; i < (uint32_t)(payloadLen + 1); i++) {
-            checksum += *(uint8_t *)RingBufferDataAt(rxRawByteQueue, 3 + i);
-        }
-        if (checksum != 0) {
-            RingBufferDequeue(rxRawByteQueue, 0);
-            RingBufferDequeue(rxRawByteQueue, 0);
-            RingBufferDequeue(rxRawByteQueue, 0);
-            continue;
-        }
+            case PacketParseSyncByte2:
+                parser->state = byte == SYNC_BYTE ? PacketParsePayloadLen : PacketParseSyncByte1;
+                break;
 
-        // Now all are satisfied
-        RingBufferDequeue(rxRawByteQueue, &packet->header.syncBytes[0]);
-        RingBufferDequeue(rxRawByteQueue, &packet->header.syncBytes[1]);
-        RingBufferDequeue(rxRawByteQueue, &packet->header.payloadLen);
-        RingBufferDequeue(rxRawByteQueue, &packet->payload.id);
-        RingBufferDequeue(rxRawByteQueue, &packet->payload.ctrl);
-        for (uint32_t i = 0; i < (uint32_t)(payloadLen - 2); i++) {
-            RingBufferDequeue(rxRawByteQueue, &packet->payload.params[i]);
-        }
-        RingBufferDequeue(rxRawByteQueue, &packet->checksum);
-        // Enqueu to rxPacketQueue
+            case PacketParsePayloadLen:
+                // More sync bytes, keep waiting for the length
+                if (byte == SYNC_BYTE) {
+                    break;
+                }
+                // At least id and ctrl, and no more than the packet can hold
+                if (byte < 2 || byte > MAX_PAYLOAD_SIZE) {
+                    Serial.print("[ERROR]Wrong payload length:");
+                    Serial.println(byte);
+                    parser->state = PacketParseSyncByte1;
+                    break;
+                }
+                packet->header.syncBytes[0] = SYNC_BYTE;
+                packet->header.syncBytes[1] = SYNC_BYTE;
+                packet->header.payloadLen = byte;
+                parser->count = 0;
+                parser->checksum = 0;
+                parser->state = PacketParsePayload;
+                break;
 
-        RingBufferEnqueue(rxPacketQueue, packet);
-    }
-}
+            case PacketParsePayload:
+                payload[parser->count++] = byte;
+                parser->checksum += byte;
+                // Take the rest of the payload from this run in one go
+                while (parser->count < packet->header.payloadLen && used < count) {
+                    byte = data[used++];
+                    payload[parser->count++] = byte;
+                    parser->checksum += byte;
+                }
+                if (parser->count == packet->header.payloadLen) {
+                    parser->state = PacketParseChecksum;
+                }
+                break;
 
-/*********************************************************************************************************
-** Function name:       PacketWriteProcess
-** Descriptions:        Packet write process
-** Input parameters:    packetHandler
-** Output parameters:   None
-** Returned value:      None
-*********************************************************************************************************/
-static void PacketWriteProcess(ProtocolHandler *protocolHandler)
-{
-    RingBuffer *txPacketQueue = &protocolHandler->txPacketQueue;
-    RingBuffer *txRawByteQueue = &protocolHandler->txRawByteQueue;
+            case PacketParseChecksum:
+                parser->state = PacketParseSyncByte1;
+                if ((uint8_t)(parser->checksum + byte) != 0) {
+                    break;
+                }
+                packet->checksum = byte;
+                RingBufferCommitWrite(rxPacketQueue, 1);
+                isPacketDone = true;
+                break;
 
-    while (RingBufferGetCount(txPacketQueue) != 0) {
-        Packet *packet = (Packet *)RingBufferDataAt(txPacketQueue, 0);
-        if (RingBufferGetLeft(txRawByteQueue) >= (uint32_t)(packet->header.payloadLen + 4)) {
-            // Serial.write("X\r\n");
-            packet->header.syncBytes[0] = SYNC_BYTE;
-            packet->header.syncBytes[1] = SYNC_BYTE;
-            uint8_t checksum = 0;
-            checksum += packet->payload.id;
-            checksum += packet->payload.ctrl;
-            for (uint32_t i = 0; i < (uint32_t)(packet->header.payloadLen - 2); i++) {
-                checksum += packet->payload.params[i];
-            }
-            packet->checksum = (uint8_t)(0 - checksum);
-            RingBufferEnqueue(txRawByteQueue, &packet->header.syncBytes[0]);
-            RingBufferEnqueue(txRawByteQueue, &packet->header.syncBytes[1]);
-            RingBufferEnqueue(txRawByteQueue, &packet->header.payloadLen);
-            RingBufferEnqueue(txRawByteQueue, &packet->payload.id);
-            RingBufferEnqueue(txRawByteQueue, &packet->payload.ctrl);
-            for (uint32_t i = 0; i < (uint32_t)(packet->header.payloadLen - 2); i++) {
-                RingBufferEnqueue(txRawByteQueue, &packet->payload.params[i]);
+            default:
+                parser->state = PacketParseSyncByte1;
+                break;
             }
-            RingBufferEnqueue(txRawByteQueue, &packet->checksum);
-            RingBufferDequeue(txPacketQueue, 0);
-        } else {
-            break;
         }
+        RingBufferCommitRead(rxRawByteQueue, used);
     }
 }
 
 /*********************************************************************************************************
 ** Function name:       PacketProcess
-** Descriptions:        Packet write process
+** Descriptions:        Parse the received raw bytes into packets
 ** Input parameters:    packetHandler
 ** Output parameters:   None
 ** Returned value:      None
@@ -158,5 +125,4 @@ static void PacketWriteProcess(ProtocolHandler *protocolHandler)
 void PacketProcess(ProtocolHandler *protocolHandler)
 {
     PacketReadProcess(protocolHandler);
-    PacketWriteProcess(protocolHandler);
 }
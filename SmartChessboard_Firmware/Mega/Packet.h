@@ -23,7 +23,7 @@
 #include "symbol.h"
 /*********************************************************************************************************
 ** Function name:       PacketProcess
-** Descriptions:        Packet write process
+** Descriptions:        Parse the received raw bytes into packets
 ** Input parameters:    packetHandler
 ** Output parameters:   None
 ** Returned value:      None
@@ -22,13 +22,14 @@
 #include <HardwareSerial.h>
 #include "ProtocolID.h"
 #include "command.h"
-#include "symbol.h"
-#include "arduino.h"
+#include "DobotSerial.h"
+#include <Arduino.h>
 /*********************************************************************************************************
 ** Protocol buffer definition
 *********************************************************************************************************/
+// Queue sizes must be powers of two, the RingBuffer wraps with a mask
 #define RAW_BYTE_BUFFER_SIZE    256
-#define PACKET_BUFFER_SIZE  1
+#define PACKET_BUFFER_SIZE  4                               // RX only, the TX frames go straight to raw bytes
 #define PRINT_DEBUG_INFO    0
 #if PRINT_DEBUG_INFO
 static char __gPrintBuffer[16];
@@ -37,11 +38,30 @@ static char __gPrintBuffer[16];
 // Serial
 uint8_t gSerialTXRawByteBuffer[RAW_BYTE_BUFFER_SIZE];
 uint8_t gSerialRXRawByteBuffer[RAW_BYTE_BUFFER_SIZE];
-Packet gSerialTXPacketBuffer[PACKET_BUFFER_SIZE];
 Packet gSerialRXPacketBuffer[PACKET_BUFFER_SIZE];
 
 ProtocolHandler gSerialProtocolHandler;
-extern bool gIsCmdEchoReceived[ProtocolMax];
+
+typedef struct tagProtocolRequest {
+    uint8_t id;
+    uint8_t seq;
+    volatile uint8_t state;
+    bool isReplyOwed;                   // timed out, its reply may still come
+    bool isReplyShared;                 // an older owed request took a reply with this one pending
+    uint8_t paramsLen;
+    uint32_t sendTime;
+    uint32_t timeout;
+    uint8_t params[PROTOCOL_REQUEST_PARAMS_SIZE];
+}ProtocolRequest;
+
+// Requests in flight, replies are matched by protocol ID in submit order, the Dobot answers in order
+static ProtocolRequest gProtocolRequest[PROTOCOL_REQUEST_NUM];
+static uint8_t gProtocolRequestSeq;
+// Frame count of the RX ISR when the parser last ran
+static uint8_t gProtocolFrameCount;
+// Built once by ProtocolInit, an ISR can send it without building a message
+static uint8_t gForceStopFrame[sizeof(PacketHeader) + 3];
+static uint8_t gForceStopFrameLen;
 
 /*********************************************************************************************************
 ** Function name:       ProtocolInit
@@ -55,95 +75,281 @@ void ProtocolInit(void)
     // Init Serial protocol
     RingBufferInit(&gSerialProtocolHandler.txRawByteQueue, gSerialTXRawByteBuffer, RAW_BYTE_BUFFER_SIZE, sizeof(uint8_t));
     RingBufferInit(&gSerialProtocolHandler.rxRawByteQueue, gSerialRXRawByteBuffer, RAW_BYTE_BUFFER_SIZE, sizeof(uint8_t));
-    RingBufferInit(&gSerialProtocolHandler.txPacketQueue, gSerialTXPacketBuffer, PACKET_BUFFER_SIZE, sizeof(Packet));
     RingBufferInit(&gSerialProtocolHandler.rxPacketQueue, gSerialRXPacketBuffer, PACKET_BUFFER_SIZE, sizeof(Packet));
+    memset(&gSerialProtocolHandler.rxParser, 0, sizeof(PacketParser));
+
+    DobotSerialInit(DOBOT_SERIAL_BAUDRATE, &gSerialProtocolHandler.rxRawByteQueue,
+                    &gSerialProtocolHandler.txRawByteQueue);
+    gProtocolFrameCount = DobotSerialGetFrameCount();
+
+    memset(gProtocolRequest, 0, sizeof(gProtocolRequest));
+
+    Message message;
+    message.id = ProtocolQueuedCmdForceStopExec;
+    message.rw = true;
+    message.isQueued = false;
+    message.paramsLen = 0;
+    gForceStopFrameLen = MessageSerialize(&message, gForceStopFrame);
 }
 
 /*********************************************************************************************************
-** Function name:       Serialread
-** Descriptions:        import data to rxbuffer
-** Input parametersnone:
-** Output parameters:   
-** Returned value:      
+** Function name:       ProtocolForceStop
+** Descriptions:        Send the queue force stop ahead of the queued frames, no request waits for its
+**                      reply. Safe in an ISR
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      false if the previous one is still being sent
 *********************************************************************************************************/
-void Serialread()
+bool ProtocolForceStop(void)
 {
-#if PRINT_DEBUG_INFO
-    bool dataValid = false;
-    if (SERIALNUM.available()) {
-        Serial.print("[R]");
-        dataValid = true;
+    return DobotSerialSendUrgent(gForceStopFrame, gForceStopFrameLen);
+}
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestForget
+** Descriptions:        Stop waiting for the late reply of a timed out request, a released slot is freed
+** Input parameters:    request
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+static void ProtocolRequestForget(ProtocolRequest *request)
+{
+    request->isReplyOwed = false;
+    if (request->state == RequestLate) {
+        request->state = RequestFree;
     }
-#endif
-    while(SERIALNUM.available()) {
-        uint8_t data = SERIALNUM.read();
-#if PRINT_DEBUG_INFO
-        sprintf(__gPrintBuffer, "0x%02x ", data);
-        Serial.print(__gPrintBuffer);
-#endif
-        if (RingBufferIsFull(&gSerialProtocolHandler.rxRawByteQueue) == false) {
-            RingBufferEnqueue(&gSerialProtocolHandler.rxRawByteQueue, &data);
+}
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestDispatch
+** Descriptions:        Deliver a reply to the oldest request with the same protocol ID still waiting for
+**                      it, pending or timed out. The late reply of a timed out request is dropped, a newer
+**                      request with the same ID would take stale params
+** Input parameters:    packet: the reply, still in the rx packet queue
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+static void ProtocolRequestDispatch(const Packet *packet)
+{
+    ProtocolRequest *match = 0;
+    uint8_t paramsLen = packet->header.payloadLen - 2;
+
+    for (uint8_t i = 0; i < PROTOCOL_REQUEST_NUM; i++) {
+        ProtocolRequest *request = &gProtocolRequest[i];
+        if ((request->state != RequestPending && !request->isReplyOwed) || request->id != packet->payload.id) {
+            continue;
+        }
+        if (match == 0 || (int8_t)(request->seq - match->seq) < 0) {
+            match = request;
         }
-//        Serial.print(data,HEX);
-//        Serial.print(" ");
     }
-//    Serial.println(" ");
-#if PRINT_DEBUG_INFO
-    if (dataValid) {
-        Serial.println("");
+    // Echo of a request already given up
+    if (match == 0) {
+        return;
     }
-#endif
+    // The replies owed to older requests are not coming any more
+    for (uint8_t i = 0; i < PROTOCOL_REQUEST_NUM; i++) {
+        ProtocolRequest *request = &gProtocolRequest[i];
+        if (request->isReplyOwed && (int8_t)(request->seq - match->seq) < 0) {
+            ProtocolRequestForget(request);
+        }
+    }
+    if (match->isReplyOwed) {
+        ProtocolRequestForget(match);
+        // If the reply of the old request was lost this one was theirs: they are not owed another
+        // at their timeout, a retry after a lost reply gets its own
+        for (uint8_t i = 0; i < PROTOCOL_REQUEST_NUM; i++) {
+            ProtocolRequest *request = &gProtocolRequest[i];
+            if (request->state == RequestPending && request->id == packet->payload.id) {
+                request->isReplyShared = true;
+            }
+        }
+        return;
+    }
+    // The only copy of the reply params, from the packet slot to the request
+    match->paramsLen = paramsLen < PROTOCOL_REQUEST_PARAMS_SIZE ? paramsLen : PROTOCOL_REQUEST_PARAMS_SIZE;
+    memcpy(match->params, packet->payload.params, match->paramsLen);
+    match->state = RequestDone;
 }
 
 /*********************************************************************************************************
 ** Function name:       ProtocolProcess
-** Descriptions:        Process the protocol
+** Descriptions:        Parse the received bytes and dispatch the replies
 ** Input parameters:    None
 ** Output parameters:   None
 ** Returned value:      None
 *********************************************************************************************************/
-uint32_t ProtocolProcess(void)
+static void ProtocolProcess(void)
 {
-    static Message message;
-    // Translate message to raw byte to send
+    // Translate raw byte to message, the frames to send are already on their way
     MessageProcess(&gSerialProtocolHandler);
-    // Send the raw bytes!
-    if (RingBufferGetCount(&gSerialProtocolHandler.txRawByteQueue)) {
-#if PRINT_DEBUG_INFO
-        Serial.print("[W]");
-#endif
-        uint8_t data;
-        while (RingBufferIsEmpty(&gSerialProtocolHandler.txRawByteQueue) == false) {
-            RingBufferDequeue(&gSerialProtocolHandler.txRawByteQueue, &data);
-            SERIALNUM.write(data);
-#if PRINT_DEBUG_INFO
-            sprintf(__gPrintBuffer, "0x%02x ", data);
-            Serial.print(__gPrintBuffer);
-#endif
+
+    // Read the messages in place!
+    const Packet *packet;
+    while (MessagePeek(&gSerialProtocolHandler, &packet) == ProtocolNoError) {
+        ProtocolRequestDispatch(packet);
+        MessageConsume(&gSerialProtocolHandler);
+    }
+}
+
+/*********************************************************************************************************
+** Function name:       ProtocolPoll
+** Descriptions:        Read the replies and hand them to their requests
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void ProtocolPoll(void)
+{
+    // The RX ISR counts the frame ends, so the parser only runs when a reply is complete
+    uint8_t frameCount = DobotSerialGetFrameCount();
+    if (frameCount != gProtocolFrameCount) {
+        gProtocolFrameCount = frameCount;
+        ProtocolProcess();
+    }
+
+    // Expire the requests past their deadline, and give up their late replies after a while
+    uint32_t now = millis();
+    bool isProcessed = false;
+    for (uint8_t i = 0; i < PROTOCOL_REQUEST_NUM; i++) {
+        ProtocolRequest *request = &gProtocolRequest[i];
+        if (request->isReplyOwed && now - request->sendTime >= request->timeout + PROTOCOL_LATE_REPLY_TIME) {
+            ProtocolRequestForget(request);
+            continue;
+        }
+        if (request->state != RequestPending || now - request->sendTime < request->timeout) {
+            continue;
+        }
+        // Parse once more in case the ISR missed a frame end on a noisy link
+        if (isProcessed == false) {
+            ProtocolProcess();
+            isProcessed = true;
+        }
+        if (request->state == RequestPending) {
+            request->state = RequestTimeout;
+            if (request->isReplyShared == false) {
+                // One late reply owed per ID: nothing came for this one, the older one was lost too
+                for (uint8_t j = 0; j < PROTOCOL_REQUEST_NUM; j++) {
+                    if (gProtocolRequest[j].isReplyOwed && gProtocolRequest[j].id == request->id) {
+                        ProtocolRequestForget(&gProtocolRequest[j]);
+                    }
+                }
+                request->isReplyOwed = true;
+            }
         }
-#if PRINT_DEBUG_INFO
-        Serial.println("");
-#endif
     }
-    delay(50);
-    do {
-        if (SERIALNUM.available()) {
-			delay(4);
+}
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestSubmit
+** Descriptions:        Send a message without waiting for its reply
+** Input parameters:    message, timeout: deadline in ms for the reply
+** Output parameters:   None
+** Returned value:      Request slot, -1 if no slot is free or the frame could not be queued before timeout.
+**                      A RequestLate slot is taken back when no slot is free
+*********************************************************************************************************/
+int8_t ProtocolRequestSubmit(const Message *message, uint32_t timeout)
+{
+    int8_t slot = -1;
+
+    for (uint8_t i = 0; i < PROTOCOL_REQUEST_NUM; i++) {
+        ProtocolRequest *request = &gProtocolRequest[i];
+        if (request->state == RequestFree) {
+            slot = i;
             break;
         }
-        delay(150);
-    } while (0);
-    Serialread();
+        // With no slot free the oldest late one stops waiting for its reply
+        if (request->state == RequestLate && (slot < 0 || (int8_t)(request->seq - gProtocolRequest[slot].seq) < 0)) {
+            slot = i;
+        }
+    }
+    if (slot < 0) {
+        return -1;
+    }
+    ProtocolRequest *request = &gProtocolRequest[slot];
 
-    // Translate raw byte to message
-    MessageProcess(&gSerialProtocolHandler);
+    // The TX ISR frees the queue at the wire rate, a full queue only costs the time of a few frames
+    uint32_t start = millis();
+    while (MessageWrite(&gSerialProtocolHandler, message) != ProtocolNoError) {
+        if (millis() - start >= timeout) {
+            return -1;
+        }
+        ProtocolPoll();
+    }
+#if PRINT_DEBUG_INFO
+    sprintf(__gPrintBuffer, "[W]0x%02x %u", message->id, message->paramsLen);
+    Serial.println(__gPrintBuffer);
+#endif
+    request->id = message->id;
+    request->seq = gProtocolRequestSeq++;
+    request->isReplyOwed = false;
+    request->isReplyShared = false;
+    request->paramsLen = 0;
+    request->sendTime = millis();
+    request->timeout = timeout;
+    request->state = RequestPending;
+    // Put the frame on the wire right away, without waiting for it
+    DobotSerialSend();
+    return slot;
+}
 
-    // Read the message!
-    if(MessageRead(&gSerialProtocolHandler, &message)==ProtocolNoError) {
-        gIsCmdEchoReceived[message.id] = true;
-        return (uint32_t)&message.params;
-    } else {
-        Serial.println("Failed to read!!!");
+/*********************************************************************************************************
+** Function name:       ProtocolRequestGetState
+** Descriptions:        Get the state of a request
+** Input parameters:    request
+** Output parameters:   None
+** Returned value:      RequestState
+*********************************************************************************************************/
+RequestState ProtocolRequestGetState(int8_t request)
+{
+    if (request < 0 || request >= PROTOCOL_REQUEST_NUM) {
+        return RequestFree;
+    }
+    return (RequestState)gProtocolRequest[request].state;
+}
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestWait
+** Descriptions:        Poll the protocol until the request is answered or expired
+** Input parameters:    request
+** Output parameters:   None
+** Returned value:      RequestState
+*********************************************************************************************************/
+RequestState ProtocolRequestWait(int8_t request)
+{
+    while (ProtocolRequestGetState(request) == RequestPending) {
+        ProtocolPoll();
+    }
+    return ProtocolRequestGetState(request);
+}
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestParams
+** Descriptions:        Get the reply params of an answered request
+** Input parameters:    request
+** Output parameters:   paramsLen: length of the reply params, may be 0
+** Returned value:      Address of the reply params
+*********************************************************************************************************/
+uint8_t *ProtocolRequestParams(int8_t request, uint8_t *paramsLen)
+{
+    if (paramsLen) {
+        *paramsLen = gProtocolRequest[request].paramsLen;
+    }
+    return gProtocolRequest[request].params;
+}
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestRelease
+** Descriptions:        Free a request slot. A timed out one is kept as RequestLate until its late reply,
+**                      which is dropped, or PROTOCOL_LATE_REPLY_TIME
+** Input parameters:    request
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void ProtocolRequestRelease(int8_t request)
+{
+    if (request < 0 || request >= PROTOCOL_REQUEST_NUM) {
+        return;
     }
-    return 0;
+    gProtocolRequest[request].state = gProtocolRequest[request].isReplyOwed ? RequestLate : RequestFree;
 }
@@ -25,6 +25,20 @@ extern "C" {
 
 #include "Message.h"
 
+#define PROTOCOL_REQUEST_NUM            4
+#define PROTOCOL_REQUEST_PARAMS_SIZE    32
+// A request past its deadline still waits so long (ms) for its late reply, the next request with
+// the same ID does not get it
+#define PROTOCOL_LATE_REPLY_TIME        500
+
+typedef enum tagRequestState {
+    RequestFree,
+    RequestPending,
+    RequestDone,
+    RequestTimeout,
+    RequestLate                         // released after its timeout, the slot waits for the late reply
+}RequestState;
+
 extern ProtocolHandler gSerialProtocolHandler;
 
 /*********************************************************************************************************
@@ -37,17 +51,74 @@ extern ProtocolHandler gSerialProtocolHandler;
 extern void ProtocolInit(void);
 
 /*********************************************************************************************************
-** Function name:       ProtocolProcess
-** Descriptions:        Process the protocol
+** Function name:       ProtocolPoll
+** Descriptions:        Read the replies and hand them to their requests
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void ProtocolPoll(void);
+
+/*********************************************************************************************************
+** Function name:       ProtocolForceStop
+** Descriptions:        Send the queue force stop ahead of the queued frames, no request waits for its
+**                      reply. Safe in an ISR
 ** Input parameters:    None
 ** Output parameters:   None
+** Returned value:      false if the previous one is still being sent
+*********************************************************************************************************/
+extern bool ProtocolForceStop(void);
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestSubmit
+** Descriptions:        Send a message without waiting for its reply
+** Input parameters:    message, timeout: deadline in ms for the reply
+** Output parameters:   None
+** Returned value:      Request slot, -1 if no slot is free or the frame could not be queued before timeout.
+**                      A RequestLate slot is taken back when no slot is free
+*********************************************************************************************************/
+extern int8_t ProtocolRequestSubmit(const Message *message, uint32_t timeout);
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestGetState
+** Descriptions:        Get the state of a request
+** Input parameters:    request
+** Output parameters:   None
+** Returned value:      RequestState
+*********************************************************************************************************/
+extern RequestState ProtocolRequestGetState(int8_t request);
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestWait
+** Descriptions:        Poll the protocol until the request is answered or expired
+** Input parameters:    request
+** Output parameters:   None
+** Returned value:      RequestState
+*********************************************************************************************************/
+extern RequestState ProtocolRequestWait(int8_t request);
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestParams
+** Descriptions:        Get the reply params of an answered request
+** Input parameters:    request
+** Output parameters:   paramsLen: length of the reply params, may be 0
+** Returned value:      Address of the reply params
+*********************************************************************************************************/
+extern uint8_t *ProtocolRequestParams(int8_t request, uint8_t *paramsLen);
+
+/*********************************************************************************************************
+** Function name:       ProtocolRequestRelease
+** Descriptions:        Free a request slot. A timed out one is kept as RequestLate until its late reply,
+**                      which is dropped, or PROTOCOL_LATE_REPLY_TIME
+** Input parameters:    request
+** Output parameters:   None
 ** Returned value:      None
 *********************************************************************************************************/
-extern uint32_t ProtocolProcess(void);
+extern void ProtocolRequestRelease(int8_t request);
 
 #ifdef __cplusplus
 }
 #endif
 
 #endif
-
+
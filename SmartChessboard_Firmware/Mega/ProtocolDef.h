@@ -57,17 +57,31 @@ typedef struct tagPacket {
 
 typedef void (*SendFunc)(void);
 
+// Receive state, kept between two PacketProcess calls
+typedef enum tagPacketParseState {
+    PacketParseSyncByte1,
+    PacketParseSyncByte2,
+    PacketParsePayloadLen,
+    PacketParsePayload,
+    PacketParseChecksum
+}PacketParseState;
+
+typedef struct tagPacketParser {
+    uint8_t state;
+    uint8_t count;
+    uint8_t checksum;
+}PacketParser;
+
 typedef struct tagProtocolHandler {
     // For hardware
     RingBuffer txRawByteQueue;
     RingBuffer rxRawByteQueue;
 
-    Packet txAppPacket;
-    Packet rxAppPacket;
-    Packet rxDLPacket;
+    // The tx frames are serialized by MessageWrite straight into txRawByteQueue
+    // The rx packet is built in place in the free slot of rxPacketQueue
+    PacketParser rxParser;
 
     // For application
-    RingBuffer txPacketQueue;
     RingBuffer rxPacketQueue;
 }ProtocolHandler;
 
@@ -18,11 +18,10 @@
 *********************************************************************************************************/
 #include "RingBuffer.h"
 #include <string.h>
-#include "arduino.h"
 /*********************************************************************************************************
 ** Function name:       RingBufferInit
 ** Descriptions:        RingBuffer init
-** Input parameters:    None
+** Input parameters:    capacity: power of two, at most 256
 ** Output parameters:   None
 ** Returned value:      None
 *********************************************************************************************************/
@@ -31,16 +30,11 @@ void RingBufferInit(RingBuffer *ringBuffer, void *addr, uint32_t capacity, int32
     // Static property
     ringBuffer->addr = addr;
     ringBuffer->capacity = capacity;
+    ringBuffer->mask = capacity - 1;
     ringBuffer->elemSize = elemSize;
     // Dynamic property
-    ringBuffer->isEmpty = true;
-    ringBuffer->isFull = false;
-    ringBuffer->count = 0;
     ringBuffer->readAddress = 0;
     ringBuffer->writeAddress = 0;
-
-    ringBuffer->readIndex = 1;
-    ringBuffer->writeIndex = 1;
 }
 
 /*********************************************************************************************************
@@ -53,13 +47,7 @@ void RingBufferInit(RingBuffer *ringBuffer, void *addr, uint32_t capacity, int32
 void RingBufferClear(RingBuffer *ringBuffer)
 {
     // Dynamic property
-    ringBuffer->isEmpty = true;
-    ringBuffer->isFull = false;
-    ringBuffer->count = 0;
-    ringBuffer->readAddress = 0;
-    ringBuffer->writeAddress = 0;
-
-    ringBuffer->readIndex = ringBuffer->writeIndex;
+    ringBuffer->readAddress = ringBuffer->writeAddress;
 }
 
 /*********************************************************************************************************
@@ -71,16 +59,16 @@ void RingBufferClear(RingBuffer *ringBuffer)
 *********************************************************************************************************/
 void RingBufferEnqueue(RingBuffer *ringBuffer, void *addr)
 {
+    uint8_t writeAddress = ringBuffer->writeAddress;
+
     if (addr) {
-        memcpy((uint8_t *)ringBuffer->addr + ringBuffer->writeAddress * ringBuffer->elemSize, addr, ringBuffer->elemSize);
-    }
-    ringBuffer->writeAddress = (ringBuffer->writeAddress + 1) % ringBuffer->capacity;
-    ringBuffer->writeIndex++;
-    ringBuffer->count++;
-    ringBuffer->isEmpty = false;
-    if (ringBuffer->count == ringBuffer->capacity) {
-        ringBuffer->isFull = true;
+        if (ringBuffer->elemSize == 1) {
+            ((uint8_t *)ringBuffer->addr)[writeAddress] = *(uint8_t *)addr;
+        } else {
+            memcpy((uint8_t *)ringBuffer->addr + writeAddress * ringBuffer->elemSize, addr, ringBuffer->elemSize);
+        }
     }
+    ringBuffer->writeAddress = (writeAddress + 1) & ringBuffer->mask;
 }
 
 /*********************************************************************************************************
@@ -92,16 +80,96 @@ void RingBufferEnqueue(RingBuffer *ringBuffer, void *addr)
 *********************************************************************************************************/
 void RingBufferDequeue(RingBuffer *ringBuffer, void *addr)
 {
+    uint8_t readAddress = ringBuffer->readAddress;
+
     if (addr) {
-        memcpy(addr, (uint8_t *)ringBuffer->addr + ringBuffer->readAddress * ringBuffer->elemSize, ringBuffer->elemSize);
+        if (ringBuffer->elemSize == 1) {
+            *(uint8_t *)addr = ((uint8_t *)ringBuffer->addr)[readAddress];
+        } else {
+            memcpy(addr, (uint8_t *)ringBuffer->addr + readAddress * ringBuffer->elemSize, ringBuffer->elemSize);
+        }
     }
-    ringBuffer->readAddress = (ringBuffer->readAddress + 1) % ringBuffer->capacity;
-    ringBuffer->readIndex++;
+    ringBuffer->readAddress = (readAddress + 1) & ringBuffer->mask;
+}
 
-    ringBuffer->count--;
-    if (ringBuffer->count == 0) {
-        ringBuffer->isEmpty = true;
+/*********************************************************************************************************
+** Function name:       RingBufferEnqueueBulk
+** Descriptions:        Copy up to count elements in, with at most two memcpy
+** Input parameters:    addr, count
+** Output parameters:   None
+** Returned value:      Number of elements enqueued
+*********************************************************************************************************/
+uint32_t RingBufferEnqueueBulk(RingBuffer *ringBuffer, const void *addr, uint32_t count)
+{
+    const uint8_t *src = (const uint8_t *)addr;
+    uint32_t done = 0;
+
+    // The free space wraps at most once
+    for (uint8_t i = 0; i < 2 && done < count; i++) {
+        void *span;
+        uint32_t n = RingBufferWriteSpan(ringBuffer, &span);
+        if (n == 0) {
+            break;
+        }
+        if (n > count - done) {
+            n = count - done;
+        }
+        memcpy(span, src + done * ringBuffer->elemSize, n * ringBuffer->elemSize);
+        RingBufferCommitWrite(ringBuffer, n);
+        done += n;
     }
-    ringBuffer->isFull = false;
+    return done;
 }
 
+/*********************************************************************************************************
+** Function name:       RingBufferStageBulk
+** Descriptions:        Copy count elements offset elements past the tail, without publishing them.
+**                      RingBufferCommitWrite publishes all the staged elements at once
+** Input parameters:    offset: elements already staged, addr, count: the free space must hold offset + count
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void RingBufferStageBulk(RingBuffer *ringBuffer, uint32_t offset, const void *addr, uint32_t count)
+{
+    const uint8_t *src = (const uint8_t *)addr;
+    uint8_t start = (ringBuffer->writeAddress + offset) & ringBuffer->mask;
+    uint32_t first = ringBuffer->capacity - start;
+
+    // The free space wraps at most once
+    if (first > count) {
+        first = count;
+    }
+    memcpy((uint8_t *)ringBuffer->addr + start * ringBuffer->elemSize, src, first * ringBuffer->elemSize);
+    memcpy(ringBuffer->addr, src + first * ringBuffer->elemSize, (count - first) * ringBuffer->elemSize);
+}
+
+/*********************************************************************************************************
+** Function name:       RingBufferDequeueBulk
+** Descriptions:        Copy up to count elements out, with at most two memcpy
+** Input parameters:    count, addr may be 0 to drop the elements
+** Output parameters:   addr
+** Returned value:      Number of elements dequeued
+*********************************************************************************************************/
+uint32_t RingBufferDequeueBulk(RingBuffer *ringBuffer, void *addr, uint32_t count)
+{
+    uint8_t *dst = (uint8_t *)addr;
+    uint32_t done = 0;
+
+    // The stored elements wrap at most once
+    for (uint8_t i = 0; i < 2 && done < count; i++) {
+        void *span;
+        uint32_t n = RingBufferPeekSpan(ringBuffer, &span);
+        if (n == 0) {
+            break;
+        }
+        if (n > count - done) {
+            n = count - done;
+        }
+        if (dst) {
+            memcpy(dst + done * ringBuffer->elemSize, span, n * ringBuffer->elemSize);
+        }
+        RingBufferCommitRead(ringBuffer, n);
+        done += n;
+    }
+    return done;
+}
@@ -29,19 +29,19 @@ extern "C" {
 #pragma pack(push)
 #pragma pack(1)
 
+/*
+ * The capacity is a power of two up to 256, so the addresses wrap with a mask and fit in one byte.
+ * One element is always kept free to tell a full buffer from an empty one.
+ */
 typedef struct tagRingBuffer {
     // Static property
     void *addr;
-    uint32_t capacity;
-    uint32_t elemSize;
+    uint16_t capacity;
+    uint8_t mask;
+    uint8_t elemSize;
     // Dynamic property
-    volatile bool isEmpty;
-    volatile bool isFull;
-    volatile uint32_t count;
-    volatile uint32_t readAddress;
-    volatile uint32_t writeAddress;
-    volatile uint64_t readIndex;
-    volatile uint64_t writeIndex;
+    volatile uint8_t readAddress;
+    volatile uint8_t writeAddress;
 }RingBuffer;
 
 #pragma pack(pop)
@@ -49,7 +49,7 @@ typedef struct tagRingBuffer {
 /*********************************************************************************************************
 ** Function name:       RingBufferInit
 ** Descriptions:        RingBuffer init
-** Input parameters:    None
+** Input parameters:    capacity: power of two, at most 256
 ** Output parameters:   None
 ** Returned value:      None
 *********************************************************************************************************/
@@ -73,7 +73,7 @@ extern void RingBufferClear(RingBuffer *ringBuffer);
 *********************************************************************************************************/
 inline bool RingBufferIsEmpty(RingBuffer *ringBuffer)
 {
-    return ringBuffer->isEmpty;
+    return ringBuffer->readAddress == ringBuffer->writeAddress;
 }
 
 /*********************************************************************************************************
@@ -85,7 +85,7 @@ inline bool RingBufferIsEmpty(RingBuffer *ringBuffer)
 *********************************************************************************************************/
 inline bool RingBufferIsFull(RingBuffer *ringBuffer)
 {
-    return ringBuffer->isFull;
+    return ((ringBuffer->writeAddress + 1) & ringBuffer->mask) == ringBuffer->readAddress;
 }
 
 /*********************************************************************************************************
@@ -97,7 +97,7 @@ inline bool RingBufferIsFull(RingBuffer *ringBuffer)
 *********************************************************************************************************/
 inline uint32_t RingBufferGetCount(RingBuffer *ringBuffer)
 {
-    return ringBuffer->count;
+    return (uint8_t)(ringBuffer->writeAddress - ringBuffer->readAddress) & ringBuffer->mask;
 }
 
 /*********************************************************************************************************
@@ -109,7 +109,7 @@ inline uint32_t RingBufferGetCount(RingBuffer *ringBuffer)
 *********************************************************************************************************/
 inline uint32_t RingBufferGetLeft(RingBuffer *ringBuffer)
 {
-    return ringBuffer->capacity - ringBuffer->count;
+    return ringBuffer->mask - RingBufferGetCount(ringBuffer);
 }
 
 /*********************************************************************************************************
@@ -121,11 +121,73 @@ inline uint32_t RingBufferGetLeft(RingBuffer *ringBuffer)
 *********************************************************************************************************/
 inline void *RingBufferDataAt(RingBuffer *ringBuffer, uint32_t index)
 {
-    uint32_t trueIndex = (ringBuffer->readAddress + index) % ringBuffer->capacity;
+    uint8_t trueIndex = (ringBuffer->readAddress + index) & ringBuffer->mask;
 
     return (uint8_t *)ringBuffer->addr + trueIndex * ringBuffer->elemSize;
 }
 
+/*********************************************************************************************************
+** Function name:       RingBufferPeekSpan
+** Descriptions:        Get the elements that can be read in one piece from the head
+** Input parameters:    None
+** Output parameters:   span: address of the first element
+** Returned value:      Number of contiguous elements
+*********************************************************************************************************/
+inline uint32_t RingBufferPeekSpan(RingBuffer *ringBuffer, void **span)
+{
+    uint8_t readAddress = ringBuffer->readAddress;
+    uint8_t writeAddress = ringBuffer->writeAddress;
+
+    *span = (uint8_t *)ringBuffer->addr + readAddress * ringBuffer->elemSize;
+    if (writeAddress >= readAddress) {
+        return writeAddress - readAddress;
+    }
+    return ringBuffer->capacity - readAddress;
+}
+
+/*********************************************************************************************************
+** Function name:       RingBufferWriteSpan
+** Descriptions:        Get the free elements that can be written in one piece at the tail
+** Input parameters:    None
+** Output parameters:   span: address of the first free element
+** Returned value:      Number of contiguous free elements
+*********************************************************************************************************/
+inline uint32_t RingBufferWriteSpan(RingBuffer *ringBuffer, void **span)
+{
+    uint8_t readAddress = ringBuffer->readAddress;
+    uint8_t writeAddress = ringBuffer->writeAddress;
+
+    *span = (uint8_t *)ringBuffer->addr + writeAddress * ringBuffer->elemSize;
+    if (readAddress > writeAddress) {
+        return readAddress - writeAddress - 1;
+    }
+    return ringBuffer->capacity - writeAddress - (readAddress == 0 ? 1 : 0);
+}
+
+/*********************************************************************************************************
+** Function name:       RingBufferCommitRead
+** Descriptions:        Drop count elements read through RingBufferPeekSpan
+** Input parameters:    count
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+inline void RingBufferCommitRead(RingBuffer *ringBuffer, uint32_t count)
+{
+    ringBuffer->readAddress = (ringBuffer->readAddress + count) & ringBuffer->mask;
+}
+
+/*********************************************************************************************************
+** Function name:       RingBufferCommitWrite
+** Descriptions:        Publish count elements written through RingBufferWriteSpan
+** Input parameters:    count
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+inline void RingBufferCommitWrite(RingBuffer *ringBuffer, uint32_t count)
+{
+    ringBuffer->writeAddress = (ringBuffer->writeAddress + count) & ringBuffer->mask;
+}
+
 /*********************************************************************************************************
 ** Function name:       RingBufferEnqueue
 ** Descriptions:        RingBuffer enqueue
@@ -144,9 +206,37 @@ extern void RingBufferEnqueue(RingBuffer *ringBuffer, void *addr);
 *********************************************************************************************************/
 extern void RingBufferDequeue(RingBuffer *ringBuffer, void *addr);
 
+/*********************************************************************************************************
+** Function name:       RingBufferEnqueueBulk
+** Descriptions:        Copy up to count elements in, with at most two memcpy
+** Input parameters:    addr, count
+** Output parameters:   None
+** Returned value:      Number of elements enqueued
+*********************************************************************************************************/
+extern uint32_t RingBufferEnqueueBulk(RingBuffer *ringBuffer, const void *addr, uint32_t count);
+
+/*********************************************************************************************************
+** Function name:       RingBufferStageBulk
+** Descriptions:        Copy count elements offset elements past the tail, without publishing them.
+**                      RingBufferCommitWrite publishes all the staged elements at once
+** Input parameters:    offset: elements already staged, addr, count: the free space must hold offset + count
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void RingBufferStageBulk(RingBuffer *ringBuffer, uint32_t offset, const void *addr, uint32_t count);
+
+/*********************************************************************************************************
+** Function name:       RingBufferDequeueBulk
+** Descriptions:        Copy up to count elements out, with at most two memcpy
+** Input parameters:    count, addr may be 0 to drop the elements
+** Output parameters:   addr
+** Returned value:      Number of elements dequeued
+*********************************************************************************************************/
+extern uint32_t RingBufferDequeueBulk(RingBuffer *ringBuffer, void *addr, uint32_t count);
+
 #ifdef __cplusplus
 }
 #endif
 
 #endif
-
+
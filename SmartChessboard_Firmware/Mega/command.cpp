@@ -18,95 +18,477 @@
 *********************************************************************************************************/
 #include <stdio.h>
 #include <string.h>
-#include <arduino.h>
+#include <Arduino.h>
 #include "command.h"
+#include "DobotCmd.h"
 #include "Protocol.h"
 #include "ProtocolID.h"
 #include "type.h"
 
-bool gIsCmdEchoReceived[ProtocolMax];
 static uint64_t gQueuedCmdWriteIndex = 0;
 static uint64_t gQueuedCmdCurrentIndex = 0;
 
-static Message gMessage;
-static uint32_t gParamsPointer = 0;
+// Set by SendQueuedCmdForceStop, from an ISR too, cleared when the queue is started again
+static volatile bool gIsQueuedCmdStopped = false;
 
-static char gPrintBuffer[32];
+static uint16_t gAlarmsPeriod = QUEUED_CMD_ALARM_PERIOD;
+static uint32_t gAlarmsTime = 0;
 
-#define INIT_MESSAGE()\
-    memset(&gMessage, 0, sizeof(Message))
+// PollQueuedCmdProgress: its requests in flight between two calls, and the last progress of the queue
+static int8_t gPollIndexRequest = -1;
+static int8_t gPollAlarmsRequest = -1;
+static uint32_t gPollTime = 0;
+static uint64_t gProgressIndex = 0;
+static uint32_t gProgressTime = 0;
+
+static uint8_t gCmdRetries = CMD_ECHO_RETRIES;
+static uint16_t gCmdBackoff = CMD_ECHO_BACKOFF;
+
+/*********************************************************************************************************
+** Command table: ID, params, result, mode, and the wire sizes where they differ from the types
+*********************************************************************************************************/
+// type.h structs are packed, so their aligned attribute, dropped in template arguments, never changed a size
+#pragma GCC diagnostic ignored "-Wignored-attributes"
+
+typedef DobotCmd<ProtocolDeviceID, CmdNone, uint32_t, CmdGet> GetDeviceIDCmd;
+typedef DobotCmd<ProtocolDeviceTime, CmdNone, uint32_t, CmdGet> GetDeviceTimeCmd;
+typedef DobotCmd<ProtocolDeviceWithL, bool, CmdNone, CmdSet> SetDeviceWithLCmd;
+
+typedef DobotCmd<ProtocolGetPose, CmdNone, Pose, CmdGet> GetPoseCmd;
+typedef DobotCmd<ProtocolGetPoseL, CmdNone, float, CmdGet> GetPoseLCmd;
+typedef DobotCmd<ProtocolAlarmsState, CmdNone, uint8_t, CmdGet, 0, 0> GetAlarmsStateCmd;
+typedef DobotCmd<ProtocolAlarmsState, CmdNone, CmdNone, CmdSet> ClearAllAlarmsStateCmd;
+
+typedef DobotCmd<ProtocolHOMECmd, CmdNone, uint64_t, CmdQueued> SetHomeCmdCmd;
+// The home params have always been sent empty
+typedef DobotCmd<ProtocolHOMEParams, Pose, CmdNone, CmdSet, 0> SetHomeParamsCmdCmd;
+
+typedef DobotCmd<ProtocolEndEffectorParams, EndEffectorParams, CmdNone, CmdSet> SetEndEffectorParamsCmd;
+typedef DobotCmd<ProtocolEndEffectorLaser, bool, CmdNone, CmdSet> SetEndEffectorLaserCmd;
+typedef DobotCmd<ProtocolEndEffectorSuctionCup, uint8_t, CmdNone, CmdSet, 2> SetEndEffectorSuctionCupCmd;
+typedef DobotCmd<ProtocolEndEffectorGripper, EndEffectorGripper, CmdNone, CmdSet> SetEndEffectorGripperCmd;
+typedef DobotCmd<ProtocolEndEffectorGripper, EndEffectorGripper, uint64_t, CmdQueued> SetQueuedEndEffectorGripperCmd;
+
+typedef DobotCmd<ProtocolJOGJointParams, JOGJointParams, CmdNone, CmdSet> SetJOGJointParamsCmd;
+typedef DobotCmd<ProtocolJOGCoordinateParams, JOGCoordinateParams, CmdNone, CmdSet> SetJOGCoordinateParamsCmd;
+typedef DobotCmd<ProtocolJOGCommonParams, JOGCommonParams, CmdNone, CmdSet> SetJOGCommonParamsCmd;
+typedef DobotCmd<ProtocolJOGCmd, JOGCmd, CmdNone, CmdSet> SetJOGCmdCmd;
+
+typedef DobotCmd<ProtocolPTPJointParams, PTPJointParams, CmdNone, CmdSet> SetPTPJointParamsCmd;
+typedef DobotCmd<ProtocolPTPCoordinateParams, PTPCoordinateParams, CmdNone, CmdSet> SetPTPCoordinateParamsCmd;
+typedef DobotCmd<ProtocolPTPJumpParams, PTPJumpParams, CmdNone, CmdSet> SetPTPJumpParamsCmd;
+typedef DobotCmd<ProtocolPTPJumpParams, PTPJumpParams, uint64_t, CmdQueued> SetQueuedPTPJumpParamsCmd;
+typedef DobotCmd<ProtocolPTPCommonParams, PTPCommonParams, CmdNone, CmdSet> SetPTPCommonParamsCmd;
+typedef DobotCmd<ProtocolPTPCommonParams, PTPCommonParams, uint64_t, CmdQueued> SetQueuedPTPCommonParamsCmd;
+typedef DobotCmd<ProtocolPTPLParams, PTPLParams, CmdNone, CmdSet> SetPTPLParamsCmd;
+typedef DobotCmd<ProtocolPTPCmd, PTPCmd, uint64_t, CmdQueued> SetPTPCmdCmd;
+typedef DobotCmd<ProtocolPTPWithLCmd, PTPWithLCmd, uint64_t, CmdQueued> SetPTPCmdWithLCmd;
+
+typedef DobotCmd<ProtocolCPParams, CPParams, CmdNone, CmdSet> SetCPParamsCmd;
+// cpMode, x, y, z and velocity, the laser fields are not sent
+typedef DobotCmd<ProtocolCPCmd, CPCmd, uint64_t, CmdQueued, 17> SetCPCmdCmd;
+// cpMode, x, y, z and the laser power in place of the velocity
+typedef DobotCmd<ProtocolCPLECmd, CPCmd, uint64_t, CmdQueued, 17> SetCPLECmdCmd;
+typedef DobotCmd<ProtocolARCParams, ARCParams, CmdNone, CmdSet> SetARCParamsCmd;
+typedef DobotCmd<ProtocolARCCmd, ARCCmd, uint64_t, CmdQueued> SetARCCmdCmd;
+typedef DobotCmd<ProtocolWAITCmd, WAITCmd, uint64_t, CmdQueued, sizeof(uint32_t)> SetWAITCmdCmd;
+
+typedef DobotCmd<ProtocolIOMultiplexing, IOConfig, CmdNone, CmdSet> SetIOMultiplexingCmd;
+// address and value
+typedef DobotCmd<ProtocolIODO, EIODO, CmdNone, CmdSet, 2> SetIODOCmd;
+typedef DobotCmd<ProtocolIOPWM, EIOPWM, CmdNone, CmdSet> SetIOPWMCmd;
+typedef DobotCmd<ProtocolIODI, EIODI, EIODI, CmdGet> GetIODICmd;
+typedef DobotCmd<ProtocolIOADC, EIOADC, EIOADC, CmdGet> GetIOADCCmd;
+typedef DobotCmd<ProtocolEMotor, EMotor, CmdNone, CmdSet> SetEMotorCmd;
+typedef DobotCmd<ProtocolEMotorS, EMotorS, CmdNone, CmdSet> SetEMotorSCmd;
+typedef DobotCmd<ProtocolColorSensor, ColorSensor, CmdNone, CmdSet, sizeof(ColorSensor) - 3> SetColorSensorCmd;
+// The reply is copied from the r field on
+typedef DobotCmd<ProtocolColorSensor, CmdNone, uint8_t, CmdGet, 0, sizeof(ColorSensor) - 3> GetColorSensorCmd;
+typedef DobotCmd<ProtocolIRSwitch, IRSwitch, CmdNone, CmdSet, sizeof(IRSwitch) - 1> SetIRSwitchCmd;
+typedef DobotCmd<ProtocolIRSwitch, uint8_t, uint8_t, CmdGet> GetIRSwitchCmd;
+typedef DobotCmd<ProtocolFunctionPulseMode, PulseCmd, CmdNone, CmdSet> SetMotorPulseCmd;
+
+typedef DobotCmd<ProtocolQueuedCmdCurrentIndex, CmdNone, uint64_t, CmdGet> GetQueuedCmdCurrentIndexCmd;
+typedef DobotCmd<ProtocolQueuedCmdStartExec, CmdNone, CmdNone, CmdGet> SetQueuedCmdStartExecCmd;
+typedef DobotCmd<ProtocolQueuedCmdStopExec, CmdNone, CmdNone, CmdGet> SetQueuedCmdStopExecCmd;
+typedef DobotCmd<ProtocolQueuedCmdForceStopExec, CmdNone, CmdNone, CmdSet> SetQueuedCmdForceStopExecCmd;
+typedef DobotCmd<ProtocolQueuedCmdClear, CmdNone, CmdNone, CmdSet> SetQueuedCmdClearCmd;
+
+/*********************************************************************************************************
+** Function name:       CommandInitMessage
+** Descriptions:        Fill a message for a command
+** Input parameters:    id, mode, params, paramsLen
+** Output parameters:   message
+** Returned value:      None
+*********************************************************************************************************/
+static void CommandInitMessage(Message *message, uint8_t id, uint8_t mode, const void *params, uint8_t paramsLen)
+{
+    message->id = id;
+    message->rw = mode != CmdGet;
+    message->isQueued = mode == CmdQueued;
+    message->paramsLen = paramsLen;
+    if (paramsLen) {
+        memcpy(message->params, params, paramsLen);
+    }
+}
+
+/*********************************************************************************************************
+** Function name:       SetCmdRetryPolicy
+** Descriptions:        Set the retry budget of all the commands
+** Input parameters:    retries: tries after the first one, backoff: ms before the first retry, doubled each time
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+void SetCmdRetryPolicy(uint8_t retries, uint16_t backoff)
+{
+    gCmdRetries = retries;
+    gCmdBackoff = backoff;
+}
+
+/*********************************************************************************************************
+** Function name:       CommandExec
+** Descriptions:        Send a command and wait its echo, each try returns as soon as the echo is parsed
+** Input parameters:    id, mode, params, paramsLen, resultLen, timeout: deadline in ms of a single try
+** Output parameters:   result: may be 0
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus CommandExec(uint8_t id, uint8_t mode, const void *params, uint8_t paramsLen,
+                      void *result, uint8_t resultLen, uint32_t timeout)
+{
+    Message message;
+    int8_t request = -1;
+    uint8_t tries = gCmdRetries + 1;
+    uint16_t backoff = gCmdBackoff;
+
+    /*
+     * A queued command is never sent twice: its echo may be lost after the controller queued it,
+     * and a second copy would run the motion again. It gets the whole budget as one deadline.
+     */
+    if (mode == CmdQueued) {
+        timeout *= tries;
+        tries = 1;
+    }
+    CommandInitMessage(&message, id, mode, params, paramsLen);
+    while (1) {
+        request = ProtocolRequestSubmit(&message, timeout);
+        if (ProtocolRequestWait(request) == RequestDone) {
+            break;
+        }
+        ProtocolRequestRelease(request);
+        Serial.print("[ERROR]Command timeout:0x");
+        Serial.println(id, HEX);
+        if (--tries == 0) {
+            return CmdStatusTimeout;
+        }
+        delay(backoff);
+        backoff *= 2;
+    }
+    if (mode == CmdQueued) {
+        uint64_t queuedCmdIndex = 0;
+        CommandRead(request, &queuedCmdIndex, sizeof(uint64_t));
+        gQueuedCmdWriteIndex = queuedCmdIndex;
+        if (result) {
+            memcpy(result, &queuedCmdIndex, sizeof(uint64_t));
+        }
+    } else {
+        CommandRead(request, result, result ? resultLen : 0);
+    }
+    return CmdStatusOk;
+}
+
+/*********************************************************************************************************
+** Function name:       CommandSubmit
+** Descriptions:        Send a command without waiting its echo
+** Input parameters:    id, mode, params, paramsLen, timeout: deadline in ms of the echo
+** Output parameters:   None
+** Returned value:      Request slot, -1 if none is free or the frame could not be queued
+*********************************************************************************************************/
+int8_t CommandSubmit(uint8_t id, uint8_t mode, const void *params, uint8_t paramsLen, uint32_t timeout)
+{
+    Message message;
+
+    CommandInitMessage(&message, id, mode, params, paramsLen);
+    return ProtocolRequestSubmit(&message, timeout);
+}
+
+/*********************************************************************************************************
+** Function name:       CommandRead
+** Descriptions:        Read the echo of a submitted command, the slot is freed unless it is still pending
+** Input parameters:    request, resultLen
+** Output parameters:   result
+** Returned value:      RequestState
+*********************************************************************************************************/
+RequestState CommandRead(int8_t request, void *result, uint8_t resultLen)
+{
+    RequestState state = ProtocolRequestGetState(request);
+
+    if (state == RequestDone && resultLen) {
+        uint8_t paramsLen;
+        uint8_t *params = ProtocolRequestParams(request, &paramsLen);
+        memcpy(result, params, paramsLen < resultLen ? paramsLen : resultLen);
+    }
+    if (state != RequestPending) {
+        ProtocolRequestRelease(request);
+    }
+    return state;
+}
 
 /*********************************************************************************************************
-** Function name:       WaitCmdEcho
-** Descriptions:        Wait the echo of command
+** Function name:       PollQueuedCmd
+** Descriptions:        Read the current index, and the alarm bits once per alarm period. The two requests
+**                      are in flight together, so the alarms cost no round trip of their own
 ** Input parameters:    
 ** Output parameters:   
-** Returned value:      
+** Returned value:      CmdStatusAlarm if an alarm bit is set, CmdStatusStopped after a force stop
 *********************************************************************************************************/
-#define WaitCmdEcho()                                           \
-                                                                \
-    gParamsPointer = 0;                                         \
-    while (1) {                                                 \
-        RingBufferClear(&gSerialProtocolHandler.txPacketQueue); \
-        RingBufferClear(&gSerialProtocolHandler.rxPacketQueue); \
-        RingBufferClear(&gSerialProtocolHandler.txRawByteQueue);\
-        RingBufferClear(&gSerialProtocolHandler.rxRawByteQueue);\
-                                                                \
-        gIsCmdEchoReceived[gMessage.id] = false;                \
-        MessageWrite(&gSerialProtocolHandler, &gMessage);       \
-                                                                \
-        gParamsPointer = ProtocolProcess();                     \
-        if (gIsCmdEchoReceived[gMessage.id]) {                  \
-            break;                                              \
-        }                                                       \
-        sprintf(gPrintBuffer, "[ERROR]������Command timeout:0x%02x\r\n", gMessage.id);\
-        Serial.print(gPrintBuffer);\
-        delay(MESSAGE_TIMEOUT);                                 \
-    }                                                           \
-    if (gParamsPointer == 0) {                                  \
-        Serial.println("Parameter pointer error!!!");           \
-        while(1);                                               \
-    }                                                           \
-    (void)gParamsPointer;
+static CmdStatus PollQueuedCmd(void)
+{
+    int8_t alarmsRequest = -1;
+
+    // The index would not move again, the waits end now instead of at the stall timeout
+    if (gIsQueuedCmdStopped) {
+        return CmdStatusStopped;
+    }
+
+    if (gAlarmsPeriod && millis() - gAlarmsTime >= gAlarmsPeriod) {
+        gAlarmsTime = millis();
+        alarmsRequest = RequestAlarmsState();
+    }
+    CmdStatus status = GetQueuedCmdCurrentIndex(0);
+    if (alarmsRequest < 0) {
+        return status;
+    }
+
+    // A lost reply is read again at the next period
+    uint8_t alarmsState[ALARMS_STATE_SIZE];
+    uint8_t len = 0;
+    ProtocolRequestWait(alarmsRequest);
+    ReadAlarmsState(alarmsRequest, alarmsState, &len, sizeof(alarmsState));
+    for (uint8_t i = 0; i < len && status == CmdStatusOk; i++) {
+        if (alarmsState[i]) {
+            status = CmdStatusAlarm;
+        }
+    }
+    return status;
+}
 
 /*********************************************************************************************************
 ** Function name:       WaitQueuedCmdFinished
-** Descriptions:        Wait a queued command to finish
+** Descriptions:        Wait the last queued command to finish
 ** Input parameters:    
 ** Output parameters:   
-** Returned value:      
+** Returned value:      CmdStatusStalled if the queue does not move for QUEUED_CMD_STALL_TIMEOUT
+*********************************************************************************************************/
+CmdStatus WaitQueuedCmdFinished(void)
+{
+    return WaitQueuedCmdIndex(gQueuedCmdWriteIndex);
+}
+
+/*********************************************************************************************************
+** Function name:       WaitQueuedCmdIndex
+** Descriptions:        Wait the queued command of the given index to finish
+** Input parameters:    index
+** Output parameters:   
+** Returned value:      CmdStatusStalled if the queue does not move for QUEUED_CMD_STALL_TIMEOUT,
+**                      CmdStatusAlarm as soon as the Dobot raises an alarm, CmdStatusStopped after a force stop
 *********************************************************************************************************/
-void WaitQueuedCmdFinished(void)
+CmdStatus WaitQueuedCmdIndex(uint64_t index)
 {
+    uint64_t lastIndex = gQueuedCmdCurrentIndex;
+    uint32_t progressTime = millis();
+
     while (1) {
         delay(50);
-        GetQueuedCmdCurrentIndex();
-        if (gQueuedCmdCurrentIndex >= gQueuedCmdWriteIndex) {
-            break;
+        CmdStatus status = PollQueuedCmd();
+        if (status != CmdStatusOk) {
+            return status;
+        }
+        if (gQueuedCmdCurrentIndex >= index) {
+            return CmdStatusOk;
+        }
+        if (gQueuedCmdCurrentIndex != lastIndex) {
+            lastIndex = gQueuedCmdCurrentIndex;
+            progressTime = millis();
+        } else if (millis() - progressTime >= QUEUED_CMD_STALL_TIMEOUT) {
+            return CmdStatusStalled;
         }
     }
 }
 
 /*********************************************************************************************************
-** Function name:       GetDeviceID
-** Descriptions:        Get device ID
+** Function name:       WaitQueuedCmdSpace
+** Descriptions:        Wait until count more commands fit in a window of lookahead queued commands not
+**                      finished yet. The current index is asked only when the cached one shows no room:
+**                      it only grows, so room seen with the cached index is there
+** Input parameters:    count, lookahead
+** Output parameters:   
+** Returned value:      CmdStatusStalled if the queue does not move for QUEUED_CMD_STALL_TIMEOUT,
+**                      CmdStatusAlarm as soon as the Dobot raises an alarm, CmdStatusStopped after a force stop
+*********************************************************************************************************/
+CmdStatus WaitQueuedCmdSpace(uint8_t count, uint8_t lookahead)
+{
+    uint64_t lastIndex = gQueuedCmdCurrentIndex;
+    uint32_t progressTime = millis();
+    bool isPolled = false;
+
+    if (count > lookahead) {
+        count = lookahead;
+    }
+    while (GetQueuedCmdInFlight() + count > lookahead) {
+        if (isPolled) {
+            delay(50);
+        }
+        CmdStatus status = PollQueuedCmd();
+        if (status != CmdStatusOk) {
+            return status;
+        }
+        isPolled = true;
+        if (gQueuedCmdCurrentIndex != lastIndex) {
+            lastIndex = gQueuedCmdCurrentIndex;
+            progressTime = millis();
+        } else if (millis() - progressTime >= QUEUED_CMD_STALL_TIMEOUT) {
+            return CmdStatusStalled;
+        }
+    }
+    return CmdStatusOk;
+}
+
+/*********************************************************************************************************
+** Function name:       PollQueuedCmdProgress
+** Descriptions:        Follow the queue without waiting: read the replies that are in, and once per poll
+**                      period ask again for the current index, with the alarm bits once per alarm period.
+**                      Meant to be called at every turn of a loop that has other work to do
 ** Input parameters:    
 ** Output parameters:   
-** Returned value:      true
+** Returned value:      CmdStatusStalled if the queue does not move for QUEUED_CMD_STALL_TIMEOUT,
+**                      CmdStatusAlarm as soon as the Dobot raises an alarm, CmdStatusStopped after a force stop
 *********************************************************************************************************/
-int GetDeviceID(uint32_t *devicetime)
+CmdStatus PollQueuedCmdProgress(void)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolDeviceID;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
+    CmdStatus status = CmdStatusOk;
 
-    WaitCmdEcho();
+    ProtocolPoll();
+    if (gIsQueuedCmdStopped) {
+        return CmdStatusStopped;
+    }
+    // A lost reply frees its request, the next period asks again
+    if (gPollIndexRequest >= 0) {
+        uint64_t index;
+        if (ReadQueuedCmdCurrentIndex(gPollIndexRequest, &index) != RequestPending) {
+            gPollIndexRequest = -1;
+        }
+    }
+    if (gPollAlarmsRequest >= 0) {
+        uint8_t alarmsState[ALARMS_STATE_SIZE];
+        uint8_t len = 0;
+        if (ReadAlarmsState(gPollAlarmsRequest, alarmsState, &len, sizeof(alarmsState)) != RequestPending) {
+            gPollAlarmsRequest = -1;
+        }
+        for (uint8_t i = 0; i < len; i++) {
+            if (alarmsState[i]) {
+                status = CmdStatusAlarm;
+            }
+        }
+    }
+    if (status != CmdStatusOk || gPollIndexRequest >= 0 || gPollAlarmsRequest >= 0) {
+        return status;
+    }
+
+    // The stall clock only runs while commands wait in the queue
+    if (gQueuedCmdCurrentIndex != gProgressIndex || GetQueuedCmdInFlight() == 0) {
+        gProgressIndex = gQueuedCmdCurrentIndex;
+        gProgressTime = millis();
+    } else if (millis() - gProgressTime >= QUEUED_CMD_STALL_TIMEOUT) {
+        return CmdStatusStalled;
+    }
+
+    if (millis() - gPollTime < QUEUED_CMD_POLL_PERIOD) {
+        return CmdStatusOk;
+    }
+    gPollTime = millis();
+    if (gAlarmsPeriod && millis() - gAlarmsTime >= gAlarmsPeriod) {
+        gAlarmsTime = millis();
+        gPollAlarmsRequest = RequestAlarmsState();
+    }
+    gPollIndexRequest = RequestQueuedCmdCurrentIndex();
+    return CmdStatusOk;
+}
+
+/*********************************************************************************************************
+** Function name:       HasQueuedCmdSpace
+** Descriptions:        Whether count more commands fit in a window of lookahead queued commands not
+**                      finished yet, at the last current index read, no command is sent
+** Input parameters:    count, lookahead
+** Output parameters:   
+** Returned value:      true if they fit
+*********************************************************************************************************/
+bool HasQueuedCmdSpace(uint8_t count, uint8_t lookahead)
+{
+    if (count > lookahead) {
+        count = lookahead;
+    }
+    return GetQueuedCmdInFlight() + count <= lookahead;
+}
+
+/*********************************************************************************************************
+** Function name:       GetQueuedCmdInFlight
+** Descriptions:        Queued commands not finished at the last current index read, no command is sent
+** Input parameters:    
+** Output parameters:   
+** Returned value:      Number of commands
+*********************************************************************************************************/
+uint32_t GetQueuedCmdInFlight(void)
+{
+    return gQueuedCmdWriteIndex > gQueuedCmdCurrentIndex ? gQueuedCmdWriteIndex - gQueuedCmdCurrentIndex : 0;
+}
 
-    memcpy(devicetime, (void *)gParamsPointer, sizeof(uint32_t));
+/*********************************************************************************************************
+** Function name:       GetQueuedCmdDoneIndex
+** Descriptions:        Queue index of the last command finished at the last current index read,
+**                      no command is sent
+** Input parameters:    
+** Output parameters:   
+** Returned value:      Queue index
+*********************************************************************************************************/
+uint64_t GetQueuedCmdDoneIndex(void)
+{
+    return gQueuedCmdCurrentIndex;
+}
 
-    return true;
+/*********************************************************************************************************
+** Function name:       SetQueuedCmdAlarmPeriod
+** Descriptions:        Set how often the waits on the queue read the alarm bits
+** Input parameters:    period: ms, 0 to never read them
+** Output parameters:   
+** Returned value:      
+*********************************************************************************************************/
+void SetQueuedCmdAlarmPeriod(uint16_t period)
+{
+    gAlarmsPeriod = period;
+}
+
+/*********************************************************************************************************
+** Function name:       GetQueuedCmdWriteIndex
+** Descriptions:        Queue index echoed for the last queued command, no command is sent
+** Input parameters:    
+** Output parameters:   
+** Returned value:      Queue index
+*********************************************************************************************************/
+uint64_t GetQueuedCmdWriteIndex(void)
+{
+    return gQueuedCmdWriteIndex;
+}
+
+/*********************************************************************************************************
+** Function name:       GetDeviceID
+** Descriptions:        Get device ID
+** Input parameters:    
+** Output parameters:   
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus GetDeviceID(uint32_t *devicetime)
+{
+    return GetDeviceIDCmd::Exec(0, devicetime);
 }
 
 /*********************************************************************************************************
@@ -114,21 +496,11 @@ int GetDeviceID(uint32_t *devicetime)
 ** Descriptions:        Get DeviceTime
 ** Input parameters:    deviceTime, isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetDeviceTime(uint32_t *deviceTime)
+CmdStatus GetDeviceTime(uint32_t *deviceTime)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolDeviceTime;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
-
-    WaitCmdEcho();
-
-    memcpy(deviceTime, (void *)gParamsPointer, sizeof(uint32_t));
-
-    return true;
+    return GetDeviceTimeCmd::Exec(0, deviceTime);
 }
 
 /*********************************************************************************************************
@@ -136,20 +508,11 @@ int GetDeviceTime(uint32_t *deviceTime)
 ** Descriptions:        Set end effector parameters
 ** Input parameters:    endEffectorParams, isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetDeviceWIthL(bool isWithL)
+CmdStatus SetDeviceWIthL(bool isWithL)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolDeviceWithL;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(isWithL);
-    gMessage.params[0] = isWithL;
-
-    WaitCmdEcho();
-
-    return true;
+    return SetDeviceWithLCmd::Exec(&isWithL, 0);
 }
 
 /*********************************************************************************************************
@@ -157,21 +520,11 @@ int SetDeviceWIthL(bool isWithL)
 ** Descriptions:        Set end effector parameters
 ** Input parameters:    endEffectorParams, isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetPose(Pose *pose)
+CmdStatus GetPose(Pose *pose)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolGetPose;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
-
-    WaitCmdEcho();
-
-    memcpy(pose, (void *)gParamsPointer, sizeof(Pose));
-
-    return true;
+    return GetPoseCmd::Exec(0, pose);
 }
 
 /*********************************************************************************************************
@@ -179,21 +532,11 @@ int GetPose(Pose *pose)
 ** Descriptions:        Set end effector parameters
 ** Input parameters:    endEffectorParams, isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetPoseL(float *poseL)
+CmdStatus GetPoseL(float *poseL)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolGetPoseL;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
-
-    WaitCmdEcho();
-
-    memcpy(poseL, (void *)gParamsPointer, sizeof(float));
-
-    return true;
+    return GetPoseLCmd::Exec(0, poseL);
 }
 
 /*********************************************************************************************************
@@ -201,21 +544,11 @@ int GetPoseL(float *poseL)
 ** Descriptions:        Set Hmoe
 ** Input parameters:     isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetHomeCmd()
+CmdStatus SetHomeCmd()
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolHOMECmd;
-    gMessage.rw = true;
-    gMessage.isQueued = true;
-    gMessage.paramsLen = 0;
-
-    WaitCmdEcho();
-
-    memcpy(&gQueuedCmdWriteIndex, (void *)gParamsPointer, sizeof(uint64_t));
-
-    return true;
+    return SetHomeCmdCmd::Exec(0, 0, CMD_ECHO_TIMEOUT_SLOW);
 }
 
 /*********************************************************************************************************
@@ -223,20 +556,11 @@ int SetHomeCmd()
 ** Descriptions:        Set Hmoe
 ** Input parameters:     isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetHomeParamsCmd(Pose *pose)
+CmdStatus SetHomeParamsCmd(Pose *pose)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolHOMEParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
-    memcpy(gMessage.params, (uint8_t *)pose, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetHomeParamsCmdCmd::Exec(pose, 0);
 }
 
 /*********************************************************************************************************
@@ -244,20 +568,11 @@ int SetHomeParamsCmd(Pose *pose)
 ** Descriptions:        Set end effector parameters
 ** Input parameters:    endEffectorParams, isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetEndEffectorParams(EndEffectorParams *endEffectorParams)
+CmdStatus SetEndEffectorParams(EndEffectorParams *endEffectorParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolEndEffectorParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(EndEffectorParams);
-    memcpy(gMessage.params, (uint8_t *)endEffectorParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetEndEffectorParamsCmd::Exec(endEffectorParams, 0);
 }
 
 /*********************************************************************************************************
@@ -265,20 +580,11 @@ int SetEndEffectorParams(EndEffectorParams *endEffectorParams)
 ** Descriptions:        Set the laser output
 ** Input parameters:    on,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetEndEffectorLaser(bool ison)
+CmdStatus SetEndEffectorLaser(bool ison)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolEndEffectorLaser;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(ison);
-    gMessage.params[0] = ison;
-
-    WaitCmdEcho();
-
-    return true;
+    return SetEndEffectorLaserCmd::Exec(&ison, 0);
 }
 
 /*********************************************************************************************************
@@ -286,22 +592,13 @@ int SetEndEffectorLaser(bool ison)
 ** Descriptions:        Set the suctioncup output
 ** Input parameters:    suck,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetEndEffectorSuctionCup(bool issuck)
+CmdStatus SetEndEffectorSuctionCup(bool issuck)
 {
-    Message gMessage;
-    memset(&gMessage, 0, sizeof(Message));
-    gMessage.id = ProtocolEndEffectorSuctionCup;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 2;
-    gMessage.params[0] = issuck;
-    gMessage.params[1] = issuck;
-
-    WaitCmdEcho();
+    uint8_t params[2] = {issuck, issuck};
 
-    return true;
+    return SetEndEffectorSuctionCupCmd::Exec(params, 0);
 }
 
 /*********************************************************************************************************
@@ -309,21 +606,23 @@ int SetEndEffectorSuctionCup(bool issuck)
 ** Descriptions:        Set the gripper output
 ** Input parameters:    grip,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SeEndEffectorGritpper(EndEffectorGripper *endEffectorGripper)
+CmdStatus SeEndEffectorGritpper(EndEffectorGripper *endEffectorGripper)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolEndEffectorGripper;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(EndEffectorGripper);
-    gMessage.params[0] = endEffectorGripper->isEnable;
-    gMessage.params[1] = endEffectorGripper->isGriped;
-
-    WaitCmdEcho();
+    return SetEndEffectorGripperCmd::Exec(endEffectorGripper, 0);
+}
 
-    return true;
+/*********************************************************************************************************
+** Function name:       SetQueuedEndEffectorGripper
+** Descriptions:        Queue the gripper output behind the pending motion commands
+** Input parameters:    grip
+** Output parameters:   queuedCmdIndex
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetQueuedEndEffectorGripper(EndEffectorGripper *endEffectorGripper)
+{
+    return SetQueuedEndEffectorGripperCmd::Exec(endEffectorGripper, 0);
 }
 
 /*********************************************************************************************************
@@ -331,20 +630,11 @@ int SeEndEffectorGritpper(EndEffectorGripper *endEffectorGripper)
 ** Descriptions:        Sets the joint jog parameter
 ** Input parameters:    jogJointParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetJOGJointParams(JOGJointParams *jogJointParams)
+CmdStatus SetJOGJointParams(JOGJointParams *jogJointParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolJOGJointParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(JOGJointParams);
-    memcpy(gMessage.params, (uint8_t *)jogJointParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetJOGJointParamsCmd::Exec(jogJointParams, 0);
 }
 
 /*********************************************************************************************************
@@ -352,20 +642,11 @@ int SetJOGJointParams(JOGJointParams *jogJointParams)
 ** Descriptions:        Sets the axis jog parameter
 ** Input parameters:    jogCoordinateParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetJOGCoordinateParams(JOGCoordinateParams *jogCoordinateParams)
+CmdStatus SetJOGCoordinateParams(JOGCoordinateParams *jogCoordinateParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolJOGCoordinateParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(JOGCoordinateParams);
-    memcpy(gMessage.params, (uint8_t *)jogCoordinateParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetJOGCoordinateParamsCmd::Exec(jogCoordinateParams, 0);
 }
 
 /*********************************************************************************************************
@@ -373,20 +654,11 @@ int SetJOGCoordinateParams(JOGCoordinateParams *jogCoordinateParams)
 ** Descriptions:        Sets the jog common parameter
 ** Input parameters:    jogCommonParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetJOGCommonParams(JOGCommonParams *jogCommonParams)
+CmdStatus SetJOGCommonParams(JOGCommonParams *jogCommonParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolJOGCommonParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(JOGCommonParams);
-    memcpy(gMessage.params, (uint8_t *)jogCommonParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetJOGCommonParamsCmd::Exec(jogCommonParams, 0);
 }
 
 /*********************************************************************************************************
@@ -394,20 +666,11 @@ int SetJOGCommonParams(JOGCommonParams *jogCommonParams)
 ** Descriptions:        Execute the jog function
 ** Input parameters:    jogCmd,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetJOGCmd(JOGCmd *jogCmd)
+CmdStatus SetJOGCmd(JOGCmd *jogCmd)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolJOGCmd;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(JOGCmd);
-    memcpy(gMessage.params, (uint8_t *)jogCmd, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetJOGCmdCmd::Exec(jogCmd, 0);
 }
 
 /*********************************************************************************************************
@@ -415,21 +678,11 @@ int SetJOGCmd(JOGCmd *jogCmd)
 ** Descriptions:        Sets the articulation point parameter
 ** Input parameters:    ptpJointParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetPTPJointParams(PTPJointParams *ptpJointParams)
+CmdStatus SetPTPJointParams(PTPJointParams *ptpJointParams)
 {
-    Message gMessage;
-    memset(&gMessage, 0, sizeof(Message));
-    gMessage.id = ProtocolPTPJointParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(PTPJointParams);
-    memcpy(gMessage.params,(uint8_t *)ptpJointParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetPTPJointParamsCmd::Exec(ptpJointParams, 0);
 }
 
 /*********************************************************************************************************
@@ -437,20 +690,11 @@ int SetPTPJointParams(PTPJointParams *ptpJointParams)
 ** Descriptions:        Sets the coordinate position parameter
 ** Input parameters:    ptpCoordinateParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetPTPCoordinateParams(PTPCoordinateParams *ptpCoordinateParams)
+CmdStatus SetPTPCoordinateParams(PTPCoordinateParams *ptpCoordinateParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolPTPCoordinateParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(PTPCoordinateParams);
-    memcpy(gMessage.params, (uint8_t *)ptpCoordinateParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetPTPCoordinateParamsCmd::Exec(ptpCoordinateParams, 0);
 }
 
 /*********************************************************************************************************
@@ -458,20 +702,23 @@ int SetPTPCoordinateParams(PTPCoordinateParams *ptpCoordinateParams)
 ** Descriptions:        Set the gate type parameter
 ** Input parameters:    ptpJumpParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetPTPJumpParams(PTPJumpParams *ptpJumpParams)
+CmdStatus SetPTPJumpParams(PTPJumpParams *ptpJumpParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolPTPJumpParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(PTPJumpParams);
-    memcpy(gMessage.params,(uint8_t *)ptpJumpParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
+    return SetPTPJumpParamsCmd::Exec(ptpJumpParams, 0);
+}
 
-    return true;
+/*********************************************************************************************************
+** Function name:       SetQueuedPTPJumpParams
+** Descriptions:        Queue the jump params, they apply to the JUMP commands queued behind them
+** Input parameters:    ptpJumpParams
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetQueuedPTPJumpParams(PTPJumpParams *ptpJumpParams)
+{
+    return SetQueuedPTPJumpParamsCmd::Exec(ptpJumpParams, 0);
 }
 
 /*********************************************************************************************************
@@ -479,20 +726,23 @@ int SetPTPJumpParams(PTPJumpParams *ptpJumpParams)
 ** Descriptions:        Set point common parameters
 ** Input parameters:    ptpCommonParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetPTPCommonParams(PTPCommonParams *ptpCommonParams)
+CmdStatus SetPTPCommonParams(PTPCommonParams *ptpCommonParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolPTPCommonParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(PTPCommonParams);
-    memcpy(gMessage.params, (uint8_t *)ptpCommonParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
+    return SetPTPCommonParamsCmd::Exec(ptpCommonParams, 0);
+}
 
-    return true;
+/*********************************************************************************************************
+** Function name:       SetQueuedPTPCommonParams
+** Descriptions:        Queue the velocity and acceleration ratios, they apply to the PTP commands queued behind them
+** Input parameters:    ptpCommonParams
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetQueuedPTPCommonParams(PTPCommonParams *ptpCommonParams)
+{
+    return SetQueuedPTPCommonParamsCmd::Exec(ptpCommonParams, 0);
 }
 
 /*********************************************************************************************************
@@ -500,20 +750,11 @@ int SetPTPCommonParams(PTPCommonParams *ptpCommonParams)
 ** Descriptions:        Set point common parameters
 ** Input parameters:    ptpCommonParams,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetPTPLParams(PTPLParams *ptpLParams)
+CmdStatus SetPTPLParams(PTPLParams *ptpLParams)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolPTPLParams;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(PTPLParams);
-    memcpy(gMessage.params, (uint8_t *)ptpLParams, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetPTPLParamsCmd::Exec(ptpLParams, 0);
 }
 
 /*********************************************************************************************************
@@ -521,22 +762,11 @@ int SetPTPLParams(PTPLParams *ptpLParams)
 ** Descriptions:        Execute the position function
 ** Input parameters:    ptpCmd,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetPTPCmd(PTPCmd *ptpCmd)
+CmdStatus SetPTPCmd(PTPCmd *ptpCmd)
 {
-    INIT_MESSAGE();
-    memset(&gMessage, 0, sizeof(Message));
-    gMessage.id = ProtocolPTPCmd;
-    gMessage.rw = true;
-    gMessage.isQueued = true;
-    gMessage.paramsLen = sizeof(PTPCmd);
-
-    memcpy(gMessage.params, (uint8_t *)ptpCmd, gMessage.paramsLen);
-    WaitCmdEcho();
-    memcpy(&gQueuedCmdWriteIndex, (void *)gParamsPointer, sizeof(uint64_t));
-
-    return true;
+    return SetPTPCmdCmd::Exec(ptpCmd, 0);
 }
 
 /*********************************************************************************************************
@@ -544,22 +774,83 @@ int SetPTPCmd(PTPCmd *ptpCmd)
 ** Descriptions:        Execute the position function
 ** Input parameters:    ptpCmd,isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetPTPCmdWithL(PTPWithLCmd *ptpWithLCmd)
+{
+    return SetPTPCmdWithLCmd::Exec(ptpWithLCmd, 0);
+}
+
+/*********************************************************************************************************
+** Function name:       SetCPParams
+** Descriptions:        Set the continuous path params
+** Input parameters:    cpParams
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetCPParams(CPParams *cpParams)
+{
+    return SetCPParamsCmd::Exec(cpParams, 0);
+}
+
+/*********************************************************************************************************
+** Function name:       SetCPCmd
+** Descriptions:        Queue a continuous path point
+** Input parameters:    cpCmd
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetCPCmd(CPCmd *cpCmd)
+{
+    return SetCPCmdCmd::Exec(cpCmd, 0);
+}
+
+/*********************************************************************************************************
+** Function name:       SetCPLECmd
+** Descriptions:        Queue a continuous path point with the laser on
+** Input parameters:    cpCmd: laserPower in place of velocity
+** Output parameters:   None
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetPTPCmdWithL(PTPWithLCmd *ptpWithLCmd)
+CmdStatus SetCPLECmd(CPCmd *cpCmd)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolPTPWithLCmd;
-    gMessage.rw = true;
-    gMessage.isQueued = true;
-    gMessage.paramsLen = sizeof(PTPWithLCmd);
-    memcpy(gMessage.params, (uint8_t *)ptpWithLCmd, gMessage.paramsLen);
+    return SetCPLECmdCmd::Exec(cpCmd, 0);
+}
 
-    WaitCmdEcho();
+/*********************************************************************************************************
+** Function name:       SetARCParams
+** Descriptions:        Set the arc velocity and acceleration
+** Input parameters:    arcParams
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetARCParams(ARCParams *arcParams)
+{
+    return SetARCParamsCmd::Exec(arcParams, 0);
+}
 
-    memcpy(&gQueuedCmdWriteIndex, (void *)gParamsPointer, sizeof(uint64_t));
+/*********************************************************************************************************
+** Function name:       SetARCCmd
+** Descriptions:        Queue an arc through cirPoint to toPoint
+** Input parameters:    arcCmd
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetARCCmd(ARCCmd *arcCmd)
+{
+    return SetARCCmdCmd::Exec(arcCmd, 0);
+}
 
-    return true;
+/*********************************************************************************************************
+** Function name:       SetWAITCmd
+** Descriptions:        Queue a wait, the controller delays the next queued command
+** Input parameters:    waitCmd: timeout in ms
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetWAITCmd(WAITCmd *waitCmd)
+{
+    return SetWAITCmdCmd::Exec(waitCmd, 0);
 }
 
 /*********************************************************************************************************
@@ -573,20 +864,57 @@ int SetPTPCmdWithL(PTPWithLCmd *ptpWithLCmd)
 ** Descriptions:        SetIOMultiplexing
 ** Input parameters:    *iOConfig,endEffectorParams, isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetIOMultiplexing(IOConfig *iOConfig)
+CmdStatus SetIOMultiplexing(IOConfig *iOConfig)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolIOMultiplexing;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(IOConfig);
-    memcpy(gMessage.params, (uint8_t *)iOConfig, gMessage.paramsLen);
-
-    WaitCmdEcho();
+    return SetIOMultiplexingCmd::Exec(iOConfig, 0);
+}
 
-    return true;
+/*********************************************************************************************************
+** Function name:       SetIOMultiplexingList
+** Descriptions:        Send several IO configs back to back, up to PROTOCOL_REQUEST_NUM echoes in flight
+** Input parameters:    ioConfigs, count
+** Output parameters:   None
+** Returned value:      CmdStatus, a config whose echo is lost is sent again with the retry policy
+*********************************************************************************************************/
+CmdStatus SetIOMultiplexingList(const IOPortConfig *ioConfigs, uint8_t count)
+{
+    IOConfig iOConfig;
+    int8_t requests[PROTOCOL_REQUEST_NUM];
+    uint8_t sent = 0;
+    uint8_t done = 0;
+    CmdStatus status = CmdStatusOk;
+
+    while (done < count) {
+        while (sent < count && sent - done < PROTOCOL_REQUEST_NUM) {
+            iOConfig.address = ioConfigs[sent].address;
+            iOConfig.function = ioConfigs[sent].function;
+            int8_t request = SetIOMultiplexingCmd::Submit(&iOConfig);
+            if (request < 0) {
+                break;
+            }
+            requests[sent % PROTOCOL_REQUEST_NUM] = request;
+            sent++;
+        }
+        // The echoes come back in order, a lost one or a busy slot falls back to stop-and-wait
+        int8_t request = sent > done ? requests[done % PROTOCOL_REQUEST_NUM] : -1;
+        if (request >= 0 && ProtocolRequestWait(request) == RequestDone) {
+            SetIOMultiplexingCmd::Read(request, 0);
+        } else {
+            ProtocolRequestRelease(request);
+            iOConfig.address = ioConfigs[done].address;
+            iOConfig.function = ioConfigs[done].function;
+            if (SetIOMultiplexing(&iOConfig) != CmdStatusOk) {
+                status = CmdStatusTimeout;
+            }
+            if (sent == done) {
+                sent++;
+            }
+        }
+        done++;
+    }
+    return status;
 }
 
 /*********************************************************************************************************
@@ -594,20 +922,11 @@ int SetIOMultiplexing(IOConfig *iOConfig)
 ** Descriptions:
 ** Input parameters:     
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetIODO(EIODO *eIODO)
+CmdStatus SetIODO(EIODO *eIODO)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolIODO;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(eIODO);
-    memcpy(gMessage.params, (uint8_t *)eIODO, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetIODOCmd::Exec(eIODO, 0);
 }
 
 /*********************************************************************************************************
@@ -615,20 +934,11 @@ int SetIODO(EIODO *eIODO)
 ** Descriptions:
 ** Input parameters:    
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetIOPWM(EIOPWM *eIOPWM)
+CmdStatus SetIOPWM(EIOPWM *eIOPWM)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolIOPWM;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(EIOPWM);
-    memcpy(gMessage.params, (uint8_t *)eIOPWM, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetIOPWMCmd::Exec(eIOPWM, 0);
 }
 
 /*********************************************************************************************************
@@ -636,22 +946,11 @@ int SetIOPWM(EIOPWM *eIOPWM)
 ** Descriptions:
 ** Input parameters:     
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetIODI(EIODI *eIODI)
+CmdStatus GetIODI(EIODI *eIODI)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolIODI;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(EIODI);
-    memcpy(gMessage.params, (uint8_t *)eIODI, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    memcpy(eIODI, (void *)gParamsPointer, sizeof(EIODI));
-
-    return true;
+    return GetIODICmd::Exec(eIODI, eIODI);
 }
 
 /*********************************************************************************************************
@@ -659,22 +958,11 @@ int GetIODI(EIODI *eIODI)
 ** Descriptions:
 ** Input parameters:    
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetIOADC(EIOADC *eIOADC)
+CmdStatus GetIOADC(EIOADC *eIOADC)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolIOADC;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(EIOADC);
-    memcpy(gMessage.params, (uint8_t *)eIOADC, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    memcpy(eIOADC, (void *)gParamsPointer, sizeof(EIOADC));
-
-    return true;
+    return GetIOADCCmd::Exec(eIOADC, eIOADC);
 }
 
 /*********************************************************************************************************
@@ -682,20 +970,11 @@ int GetIOADC(EIOADC *eIOADC)
 ** Descriptions:
 ** Input parameters:    
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetEMotor(EMotor *eMotor)
+CmdStatus SetEMotor(EMotor *eMotor)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolEMotor;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(EMotor);
-    memcpy(gMessage.params, (uint8_t *)eMotor, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetEMotorCmd::Exec(eMotor, 0);
 }
 
 /*********************************************************************************************************
@@ -703,20 +982,11 @@ int SetEMotor(EMotor *eMotor)
 ** Descriptions:
 ** Input parameters:    
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetEMotorS(EMotorS *eMotorS)
+CmdStatus SetEMotorS(EMotorS *eMotorS)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolEMotorS;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(EMotorS);
-    memcpy(gMessage.params, (uint8_t *)eMotorS, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetEMotorSCmd::Exec(eMotorS, 0);
 }
 
 /*********************************************************************************************************
@@ -724,20 +994,11 @@ int SetEMotorS(EMotorS *eMotorS)
 ** Descriptions:
 ** Input parameters:    
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetColorSensor(ColorSensor *colorSensor)
+CmdStatus SetColorSensor(ColorSensor *colorSensor)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolColorSensor;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(ColorSensor) - 3;
-    memcpy(gMessage.params, (uint8_t *)colorSensor, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetColorSensorCmd::Exec(colorSensor, 0);
 }
 
 /*********************************************************************************************************
@@ -745,41 +1006,22 @@ int SetColorSensor(ColorSensor *colorSensor)
 ** Descriptions:
 ** Input parameters:    
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetColorSensor(ColorSensor *colorSensor)
+CmdStatus GetColorSensor(ColorSensor *colorSensor)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolColorSensor;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
-
-    WaitCmdEcho();
-
-    memcpy(&colorSensor->r, (void *)gParamsPointer,sizeof(ColorSensor)-3);
-
-    return true;
+    return GetColorSensorCmd::Exec(0, &colorSensor->r);
 }
 /*********************************************************************************************************
 ** Function name:       SetIRSwitch
 ** Descriptions:
 ** Input parameters:    
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetIRSwitch(IRSwitch *iRSwitch)
+CmdStatus SetIRSwitch(IRSwitch *iRSwitch)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolIRSwitch;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(IRSwitch) - 1;
-    memcpy(gMessage.params, (uint8_t *)iRSwitch, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetIRSwitchCmd::Exec(iRSwitch, 0);
 }
 
 /*********************************************************************************************************
@@ -787,23 +1029,11 @@ int SetIRSwitch(IRSwitch *iRSwitch)
 ** Descriptions:
 ** Input parameters:     isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetIRSwitch(IRSwitch *iRSwitch)
+CmdStatus GetIRSwitch(IRSwitch *iRSwitch)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolIRSwitch;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(iRSwitch->port);
-    memcpy(gMessage.params, &iRSwitch->port, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    //copy params receive
-    memcpy(&iRSwitch->value, (void *)gParamsPointer,sizeof(iRSwitch->value));
-
-    return true;
+    return GetIRSwitchCmd::Exec(&iRSwitch->port, &iRSwitch->value);
 }
 
 /*********************************************************************************************************
@@ -811,20 +1041,11 @@ int GetIRSwitch(IRSwitch *iRSwitch)
 ** Descriptions:
 ** Input parameters:     isQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetMotorPulse(PulseCmd *pulseCmd)
+CmdStatus SetMotorPulse(PulseCmd *pulseCmd)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolFunctionPulseMode;
-    gMessage.rw = true;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = sizeof(PulseCmd);
-    memcpy(gMessage.params, pulseCmd, gMessage.paramsLen);
-
-    WaitCmdEcho();
-
-    return true;
+    return SetMotorPulseCmd::Exec(pulseCmd, 0);
 }
 
 /*********************************************************************************************************
@@ -832,20 +1053,16 @@ int SetMotorPulse(PulseCmd *pulseCmd)
 ** Descriptions:        check current index
 ** Input parameters:    noQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int GetQueuedCmdCurrentIndex()
+CmdStatus GetQueuedCmdCurrentIndex(uint64_t *queuedCmdIndex)
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolQueuedCmdCurrentIndex;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
-
-    WaitCmdEcho();
-    memcpy(&gQueuedCmdCurrentIndex, (void *)gParamsPointer,sizeof(uint64_t));
+    CmdStatus status = GetQueuedCmdCurrentIndexCmd::Exec(0, &gQueuedCmdCurrentIndex);
 
-    return true;
+    if (queuedCmdIndex) {
+        *queuedCmdIndex = gQueuedCmdCurrentIndex;
+    }
+    return status;
 }
 
 /*********************************************************************************************************
@@ -853,19 +1070,16 @@ int GetQueuedCmdCurrentIndex()
 ** Descriptions:        check current index
 ** Input parameters:    noQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetQueuedCmdStartExec()
+CmdStatus SetQueuedCmdStartExec()
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolQueuedCmdStartExec;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0;
-
-    WaitCmdEcho();
+    CmdStatus status = SetQueuedCmdStartExecCmd::Exec(0, 0, CMD_ECHO_TIMEOUT_SLOW);
 
-    return true;
+    if (status == CmdStatusOk) {
+        gIsQueuedCmdStopped = false;
+    }
+    return status;
 }
 
 /*********************************************************************************************************
@@ -873,17 +1087,168 @@ int SetQueuedCmdStartExec()
 ** Descriptions:        check current index
 ** Input parameters:    noQueued
 ** Output parameters:   queuedCmdIndex
-** Returned value:      true
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetQueuedCmdStopExec()
+{
+    return SetQueuedCmdStopExecCmd::Exec(0, 0);
+}
+
+/*********************************************************************************************************
+** Function name:       SetQueuedCmdForceStopExec
+** Descriptions:        Stop the queue at once, the running command is cut short
+** Input parameters:    
+** Output parameters:   
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus SetQueuedCmdForceStopExec()
+{
+    return SetQueuedCmdForceStopExecCmd::Exec(0, 0);
+}
+
+/*********************************************************************************************************
+** Function name:       SendQueuedCmdForceStop
+** Descriptions:        Force stop the queue without waiting: the frame goes out ahead of the queued ones and
+**                      the waits on the queue return CmdStatusStopped until SetQueuedCmdStartExec. Safe in an ISR
+** Input parameters:    
+** Output parameters:   
+** Returned value:      false if the previous force stop is still being sent and this one was not queued
+*********************************************************************************************************/
+bool SendQueuedCmdForceStop()
+{
+    gIsQueuedCmdStopped = true;
+    return ProtocolForceStop();
+}
+
+/*********************************************************************************************************
+** Function name:       SetQueuedCmdClear
+** Descriptions:        Drop the queued commands not run yet
+** Input parameters:    
+** Output parameters:   
+** Returned value:      CmdStatus
 *********************************************************************************************************/
-int SetQueuedCmdStopExec()
+CmdStatus SetQueuedCmdClear()
 {
-    INIT_MESSAGE();
-    gMessage.id = ProtocolQueuedCmdStopExec ;
-    gMessage.rw = false;
-    gMessage.isQueued = false;
-    gMessage.paramsLen = 0 ;
+    return SetQueuedCmdClearCmd::Exec(0, 0);
+}
 
-    WaitCmdEcho();
+/*********************************************************************************************************
+** Function name:       RequestPose
+** Descriptions:        Ask for the pose without waiting for the reply
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      request, -1 if it could not be sent
+*********************************************************************************************************/
+int8_t RequestPose()
+{
+    return GetPoseCmd::Submit(0);
+}
 
-    return true;
+/*********************************************************************************************************
+** Function name:       RequestQueuedCmdCurrentIndex
+** Descriptions:        Ask for the current queue index without waiting for the reply
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      request, -1 if it could not be sent
+*********************************************************************************************************/
+int8_t RequestQueuedCmdCurrentIndex()
+{
+    return GetQueuedCmdCurrentIndexCmd::Submit(0);
+}
+
+/*********************************************************************************************************
+** Function name:       RequestAlarmsState
+** Descriptions:        Ask for the alarm bits without waiting for the reply
+** Input parameters:    none
+** Output parameters:   none
+** Returned value:      request, -1 if it could not be sent
+*********************************************************************************************************/
+int8_t RequestAlarmsState()
+{
+    return GetAlarmsStateCmd::Submit(0);
+}
+
+/*********************************************************************************************************
+** Function name:       ReadPose
+** Descriptions:        Read the reply of RequestPose, the request is released unless still pending
+** Input parameters:    request
+** Output parameters:   pose
+** Returned value:      RequestState
+*********************************************************************************************************/
+RequestState ReadPose(int8_t request, Pose *pose)
+{
+    return GetPoseCmd::Read(request, pose);
+}
+
+/*********************************************************************************************************
+** Function name:       ReadQueuedCmdCurrentIndex
+** Descriptions:        Read the reply of RequestQueuedCmdCurrentIndex, the request is released unless still pending
+** Input parameters:    request
+** Output parameters:   queuedCmdIndex
+** Returned value:      RequestState
+*********************************************************************************************************/
+RequestState ReadQueuedCmdCurrentIndex(int8_t request, uint64_t *queuedCmdIndex)
+{
+    RequestState state = GetQueuedCmdCurrentIndexCmd::Read(request, queuedCmdIndex);
+
+    if (state == RequestDone) {
+        gQueuedCmdCurrentIndex = *queuedCmdIndex;
+    }
+    return state;
+}
+
+/*********************************************************************************************************
+** Function name:       ReadAlarmsState
+** Descriptions:        Read the reply of RequestAlarmsState, the request is released unless still pending
+** Input parameters:    request, maxLen: size of alarmsState
+** Output parameters:   alarmsState, len: bytes copied
+** Returned value:      RequestState
+*********************************************************************************************************/
+RequestState ReadAlarmsState(int8_t request, uint8_t *alarmsState, uint8_t *len, uint8_t maxLen)
+{
+    RequestState state = ProtocolRequestGetState(request);
+
+    if (state == RequestDone) {
+        uint8_t paramsLen;
+        uint8_t *params = ProtocolRequestParams(request, &paramsLen);
+        *len = paramsLen < maxLen ? paramsLen : maxLen;
+        memcpy(alarmsState, params, *len);
+    }
+    if (state != RequestPending) {
+        ProtocolRequestRelease(request);
+    }
+    return state;
+}
+
+/*********************************************************************************************************
+** Function name:       GetAlarmsState
+** Descriptions:        Read the alarm bits
+** Input parameters:    maxLen: size of alarmsState
+** Output parameters:   alarmsState, len: bytes copied
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus GetAlarmsState(uint8_t *alarmsState, uint8_t *len, uint8_t maxLen)
+{
+    uint8_t tries = gCmdRetries + 1;
+
+    while (tries--) {
+        int8_t request = RequestAlarmsState();
+        ProtocolRequestWait(request);
+        if (ReadAlarmsState(request, alarmsState, len, maxLen) == RequestDone) {
+            return CmdStatusOk;
+        }
+    }
+    return CmdStatusTimeout;
+}
+
+/*********************************************************************************************************
+** Function name:       ClearAllAlarmsState
+** Descriptions:        Clear the alarm bits
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      CmdStatus
+*********************************************************************************************************/
+CmdStatus ClearAllAlarmsState()
+{
+    return ClearAllAlarmsStateCmd::Exec(0, 0);
 }
@@ -21,79 +21,148 @@
 
 #include <stdint.h>
 #include "ProtocolID.h"
+#include "Protocol.h"
 #include "type.h"
 
-#define MESSAGE_TIMEOUT 50
+// Deadline of a single command echo, the reply is usually parsed within a few ms
+#define CMD_ECHO_TIMEOUT 100
+// Deadline for the commands the controller may answer late (home, queue start)
+#define CMD_ECHO_TIMEOUT_SLOW 500
+// Default retry budget: tries after the first one, and the pause before the first retry, doubled each time
+#define CMD_ECHO_RETRIES 3
+#define CMD_ECHO_BACKOFF 10
+// The queue is reported stalled when its current index does not move for so long
+#define QUEUED_CMD_STALL_TIMEOUT 10000
+// The waits on the queue read the alarm bits with their index poll at most this often (ms), 0 never
+#define QUEUED_CMD_ALARM_PERIOD 250
+// PollQueuedCmdProgress asks for the current index at most this often (ms), as the waits do
+#define QUEUED_CMD_POLL_PERIOD 50
+// Bytes of alarm bits, alarm code n is bit n % 8 of byte n / 8
+#define ALARMS_STATE_SIZE 16
+
+typedef enum tagCmdStatus {
+    CmdStatusOk,
+    CmdStatusTimeout,                   // No echo within the retry budget
+    CmdStatusStalled,                   // The queued commands stopped making progress
+    CmdStatusAlarm,                     // The Dobot raised an alarm while the queue was waited
+    CmdStatusStopped                    // The queue was force stopped, until it is started again
+}CmdStatus;
 
 /*********************************************************************************************************
 ** Device function
 *********************************************************************************************************/
-extern int GetDeviceID(uint32_t *devicetime);
-extern int GetDeviceTime(uint32_t *deviceTime);
-extern int SetDeviceWIthL(bool isWithL);
+extern CmdStatus GetDeviceID(uint32_t *devicetime);
+extern CmdStatus GetDeviceTime(uint32_t *deviceTime);
+extern CmdStatus SetDeviceWIthL(bool isWithL);
 
 /*********************************************************************************************************
 ** Pose
 *********************************************************************************************************/
-extern int GetPose(Pose *pose);
-extern int GetPoseL(float *poseL);
+extern CmdStatus GetPose(Pose *pose);
+extern CmdStatus GetPoseL(float *poseL);
 
 /*********************************************************************************************************
 ** Home
 *********************************************************************************************************/
-extern int SetHomeCmd();
-extern int SetHomeParamsCmd(Pose *pose);
+extern CmdStatus SetHomeCmd();
+extern CmdStatus SetHomeParamsCmd(Pose *pose);
 
 /*********************************************************************************************************
 ** End effector function
 *********************************************************************************************************/
-extern int SetEndEffectorParams(EndEffectorParams *endEffectorParams);
-extern int SetEndEffectorLaser(bool ison);
-extern int SetEndEffectorSuctionCup(bool issuck);
-extern int SeEndEffectorGritpper(EndEffectorGripper *endEffectorGripper);
+extern CmdStatus SetEndEffectorParams(EndEffectorParams *endEffectorParams);
+extern CmdStatus SetEndEffectorLaser(bool ison);
+extern CmdStatus SetEndEffectorSuctionCup(bool issuck);
+extern CmdStatus SeEndEffectorGritpper(EndEffectorGripper *endEffectorGripper);
+extern CmdStatus SetQueuedEndEffectorGripper(EndEffectorGripper *endEffectorGripper);
 
 /*********************************************************************************************************
 ** jog function
 *********************************************************************************************************/
-extern int SetJOGJointParams(JOGJointParams *jogJointParams);
-extern int SetJOGCommonParams(JOGCommonParams *jogCommonParams);
-extern int SetJOGCmd(JOGCmd *jogCmd);
-extern int SetJOGCoordinateParams(JOGCoordinateParams *jogCoordinateParams);
+extern CmdStatus SetJOGJointParams(JOGJointParams *jogJointParams);
+extern CmdStatus SetJOGCommonParams(JOGCommonParams *jogCommonParams);
+extern CmdStatus SetJOGCmd(JOGCmd *jogCmd);
+extern CmdStatus SetJOGCoordinateParams(JOGCoordinateParams *jogCoordinateParams);
 
 /*********************************************************************************************************
 ** PTP function
 *********************************************************************************************************/
-extern int SetPTPJointParams(PTPJointParams *ptpJointParams);
-extern int SetPTPCoordinateParams(PTPCoordinateParams *ptpCoordinateParams);
-extern int SetPTPJumpParams(PTPJumpParams *ptpJumpParams);
-extern int SetPTPCommonParams(PTPCommonParams *ptpCommonParams);
-extern int SetPTPCmd(PTPCmd *ptpCmd);
-extern int SetPTPLParams(PTPLParams *ptpLParams);
-extern int SetPTPCmdWithL(PTPWithLCmd *ptpWithLCmd);
+extern CmdStatus SetPTPJointParams(PTPJointParams *ptpJointParams);
+extern CmdStatus SetPTPCoordinateParams(PTPCoordinateParams *ptpCoordinateParams);
+extern CmdStatus SetPTPJumpParams(PTPJumpParams *ptpJumpParams);
+extern CmdStatus SetQueuedPTPJumpParams(PTPJumpParams *ptpJumpParams);
+extern CmdStatus SetPTPCommonParams(PTPCommonParams *ptpCommonParams);
+extern CmdStatus SetQueuedPTPCommonParams(PTPCommonParams *ptpCommonParams);
+extern CmdStatus SetPTPCmd(PTPCmd *ptpCmd);
+extern CmdStatus SetPTPLParams(PTPLParams *ptpLParams);
+extern CmdStatus SetPTPCmdWithL(PTPWithLCmd *ptpWithLCmd);
+
+/*********************************************************************************************************
+** CP, ARC and WAIT function
+*********************************************************************************************************/
+extern CmdStatus SetCPParams(CPParams *cpParams);
+extern CmdStatus SetCPCmd(CPCmd *cpCmd);
+extern CmdStatus SetCPLECmd(CPCmd *cpCmd);
+extern CmdStatus SetARCParams(ARCParams *arcParams);
+extern CmdStatus SetARCCmd(ARCCmd *arcCmd);
+extern CmdStatus SetWAITCmd(WAITCmd *waitCmd);
 
 /*********************************************************************************************************
 ** EIO function
 *********************************************************************************************************/
-extern int SetIOMultiplexing(IOConfig *iOConfig);
-extern int SetIODO(EIODO *eIODO);
-extern int SetIOPWM(EIOPWM *eIOPWM);
-extern int GetIODI(EIODI *eIODI);
-extern int GetIOADC(EIOADC *eIOADC);
-extern int SetEMotor(EMotor *eMotor);
-extern int SetEMotorS(EMotorS *eMotorS);
-extern int SetColorSensor(ColorSensor *colorSensor);
-extern int GetColorSensor(ColorSensor *colorSensor);
-extern int SetIRSwitch(IRSwitch *iRSwitch);
-extern int GetIRSwitch(IRSwitch *iRSwitch);
-
-extern int SetMotorPulse(PulseCmd *pulseCmd);
+extern CmdStatus SetIOMultiplexing(IOConfig *iOConfig);
+extern CmdStatus SetIOMultiplexingList(const IOPortConfig *ioConfigs, uint8_t count);
+extern CmdStatus SetIODO(EIODO *eIODO);
+extern CmdStatus SetIOPWM(EIOPWM *eIOPWM);
+extern CmdStatus GetIODI(EIODI *eIODI);
+extern CmdStatus GetIOADC(EIOADC *eIOADC);
+extern CmdStatus SetEMotor(EMotor *eMotor);
+extern CmdStatus SetEMotorS(EMotorS *eMotorS);
+extern CmdStatus SetColorSensor(ColorSensor *colorSensor);
+extern CmdStatus GetColorSensor(ColorSensor *colorSensor);
+extern CmdStatus SetIRSwitch(IRSwitch *iRSwitch);
+extern CmdStatus GetIRSwitch(IRSwitch *iRSwitch);
+
+extern CmdStatus SetMotorPulse(PulseCmd *pulseCmd);
 
 /*********************************************************************************************************
 ** QueueCmd function
 *********************************************************************************************************/
-extern int GetQueuedCmdCurrentIndex();
-extern int SetQueuedCmdStartExec();
-extern int SetQueuedCmdStopExec();
-extern void WaitQueuedCmdFinished();
+extern CmdStatus GetQueuedCmdCurrentIndex(uint64_t *queuedCmdIndex);
+extern CmdStatus SetQueuedCmdStartExec();
+extern CmdStatus SetQueuedCmdStopExec();
+extern CmdStatus SetQueuedCmdForceStopExec();
+extern bool SendQueuedCmdForceStop();
+extern CmdStatus SetQueuedCmdClear();
+extern uint64_t GetQueuedCmdWriteIndex();
+extern CmdStatus WaitQueuedCmdFinished();
+extern CmdStatus WaitQueuedCmdIndex(uint64_t index);
+extern CmdStatus WaitQueuedCmdSpace(uint8_t count, uint8_t lookahead);
+extern CmdStatus PollQueuedCmdProgress();
+extern bool HasQueuedCmdSpace(uint8_t count, uint8_t lookahead);
+extern uint32_t GetQueuedCmdInFlight();
+extern uint64_t GetQueuedCmdDoneIndex();
+extern void SetQueuedCmdAlarmPeriod(uint16_t period);
+
+/*********************************************************************************************************
+** Alarm function
+*********************************************************************************************************/
+extern CmdStatus GetAlarmsState(uint8_t *alarmsState, uint8_t *len, uint8_t maxLen);
+extern CmdStatus ClearAllAlarmsState();
+
+/*********************************************************************************************************
+** Retry policy of all the commands
+*********************************************************************************************************/
+extern void SetCmdRetryPolicy(uint8_t retries, uint16_t backoff);
+
+/*********************************************************************************************************
+** Request function, several of them may be in flight at once
+*********************************************************************************************************/
+extern int8_t RequestPose();
+extern int8_t RequestQueuedCmdCurrentIndex();
+extern int8_t RequestAlarmsState();
+extern RequestState ReadPose(int8_t request, Pose *pose);
+extern RequestState ReadQueuedCmdCurrentIndex(int8_t request, uint64_t *queuedCmdIndex);
+extern RequestState ReadAlarmsState(int8_t request, uint8_t *alarmsState, uint8_t *len, uint8_t maxLen);
 
 #endif
@@ -0,0 +1,309 @@
+/*
+ * The MKR <-> Mega link on a noisy wire: the old newline terminated text at 9600 baud against
+ * ChessLink (libraries/ChessLink) at CHESSLINK_BAUDRATE.
+ *
+ * Both ends exchange the same traffic as a game: the MKR sends moves and game commands, the
+ * Mega sends CALIB_MSG lines. Each byte on the wire is corrupted (one bit flipped) with
+ * probability --error, or lost with probability --drop.
+ *
+ * text     - every line is written once, as Serial1.println did; the output counts the lines
+ *            read back different from the ones sent (a corrupted move nobody notices) and the
+ *            lines lost. The wire time follows from the byte count.
+ * chesslink - two ChessLink objects, the MKR and the Mega, on two in-memory wires paced at the
+ *            baud rate against the real clock, with a UART buffer of 64 bytes as on the Mega.
+ *            Each side sends a message every --interval ms and polls the link in between.
+ *            A message that does not fit in the TX buffer waits for canSend(), since a blocking
+ *            send() would stop the other board too in this single thread.
+ *            The output counts the messages delivered intact and in order, the corrupted ones
+ *            (always 0 unless the CRC16 misses) and the ones given up, with the retransmits.
+ *
+ * Usage: ChessLinkBench [-n N] [--error P] [--drop P] [--interval MS] [--seed N]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <ChessLink.h>
+
+#define TEXT_BAUDRATE   9600
+#define UART_BUFFER     64
+
+static double gError = 0.001;
+static double gDrop = 0.0;
+
+static double Random(void)
+{
+    return rand() / ((double)RAND_MAX + 1);
+}
+
+// A byte through the noise, false if it is lost
+static bool Noise(uint8_t *data)
+{
+    if (gDrop > 0 && Random() < gDrop) {
+        return false;
+    }
+    if (Random() < gError) {
+        *data ^= 1 << (rand() % 8);
+    }
+    return true;
+}
+
+// Wire time of a byte in µs, start and stop bits included
+static double ByteTime(uint32_t baud)
+{
+    return 10e6 / baud;
+}
+
+/*
+ * One direction of the wire: the writer sees a UART buffer that empties at the baud rate,
+ * the reader sees each byte once its stop bit is on the wire.
+ */
+struct Wire {
+    uint32_t baud;
+    double lastEnd;                     // µs at which the last byte written leaves the UART
+    std::deque<std::pair<double, uint8_t> > bytes;
+    uint32_t written;
+
+    explicit Wire(uint32_t baud) : baud(baud), lastEnd(0), written(0) {}
+
+    int room(void)
+    {
+        double now = micros();
+        int busy = lastEnd > now ? (int)((lastEnd - now) / ByteTime(baud)) : 0;
+        return busy < UART_BUFFER ? UART_BUFFER - busy : 0;
+    }
+
+    void write(uint8_t data)
+    {
+        double now = micros();
+        lastEnd = (lastEnd > now ? lastEnd : now) + ByteTime(baud);
+        written++;
+        if (Noise(&data)) {
+            bytes.push_back(std::make_pair(lastEnd, data));
+        }
+    }
+
+    int available(void)
+    {
+        double now = micros();
+        int count = 0;
+        for (size_t i = 0; i < bytes.size() && bytes[i].first <= now; i++) {
+            count++;
+        }
+        return count;
+    }
+};
+
+// The end of a board: writes on one wire, reads the other
+class WireStream : public Stream {
+public:
+    WireStream(Wire &tx, Wire &rx) : tx(tx), rx(rx) {}
+
+    size_t write(uint8_t data)
+    {
+        tx.write(data);
+        return 1;
+    }
+    int availableForWrite(void) { return tx.room(); }
+    int available(void) { return rx.available(); }
+    int peek(void) { return available() > 0 ? rx.bytes.front().second : -1; }
+    int read(void)
+    {
+        if (available() == 0) {
+            return -1;
+        }
+        uint8_t data = rx.bytes.front().second;
+        rx.bytes.pop_front();
+        return data;
+    }
+
+private:
+    Wire &tx;
+    Wire &rx;
+};
+
+static std::vector<std::string> MkrTraffic(uint32_t n)
+{
+    static const char *commands[] = {"e2e4", "e7e5", "g1f3", "b8c6", "f1b5", "a7a6", "STARTGAME",
+                                     "HIGHLIGHT:e2", "CALIB_CONFIRM", "e4d5", "STOP", "RESUME"};
+    std::vector<std::string> traffic;
+    for (uint32_t i = 0; i < n; i++) {
+        traffic.push_back(commands[i % (sizeof(commands) / sizeof(commands[0]))]);
+    }
+    return traffic;
+}
+
+static std::vector<std::string> MegaTraffic(uint32_t n)
+{
+    std::vector<std::string> traffic;
+    char line[CHESSLINK_MAX_PAYLOAD + 1];
+    for (uint32_t i = 0; i < n; i++) {
+        if (i % 3 == 0) {
+            // The longest line of the calibration
+            snprintf(line, sizeof(line), "CALIB_MSG:Posizione salvata a1: X=%.2f Y=%.2f Z=%.2f - "
+                     "Muovi il braccio su h8 e premi CONFERMA", 125.0 + i % 7, -80.0 - i % 5, -42.5);
+        } else {
+            snprintf(line, sizeof(line), "CALIB_MSG:Passo %u di 3", (unsigned)(i % 3 + 1));
+        }
+        traffic.push_back(line);
+    }
+    return traffic;
+}
+
+static void RunText(const char *name, const std::vector<std::string> &traffic)
+{
+    uint32_t bytes = 0, corrupt = 0, lost = 0;
+    double longest = 0;
+
+    // Each line alone on the wire, read back up to the newline as readLine did
+    for (size_t i = 0; i < traffic.size(); i++) {
+        std::string sent = traffic[i] + "\r\n";
+        std::string got;
+        bool hasNewline = false;
+        for (size_t j = 0; j < sent.size(); j++) {
+            uint8_t data = sent[j];
+            if (Noise(&data)) {
+                got += (char)data;
+                hasNewline |= data == '\n';
+            }
+        }
+        bytes += sent.size();
+        if (sent.size() * ByteTime(TEXT_BAUDRATE) > longest) {
+            longest = sent.size() * ByteTime(TEXT_BAUDRATE);
+        }
+        // A lost newline merges the line into the next one, both are gone
+        if (!hasNewline) {
+            lost++;
+        } else if (got != sent) {
+            corrupt++;
+        }
+    }
+    printf("%-10s %-9s %6zu %9zu %8u %6u %8s %8u %9.1f %9.2f\n", "text", name, traffic.size(),
+           traffic.size() - corrupt - lost, corrupt, lost, "-", bytes,
+           bytes * ByteTime(TEXT_BAUDRATE) / 1000, longest / 1000);
+}
+
+struct Side {
+    const char *name;
+    ChessLink link;
+    std::vector<std::string> traffic;
+    size_t nextSend;
+    size_t nextReceive;                 // index in the traffic of the other side
+    uint32_t ok;
+    uint32_t corrupt;
+    uint32_t rejected;                  // send() returned false
+};
+
+static void Deliver(Side &receiver, const Side &sender)
+{
+    while (receiver.link.receive()) {
+        std::string got(receiver.link.text(), receiver.link.length());
+        // Frames given up by the sender are skipped, the rest must arrive in order
+        bool isFound = false;
+        while (receiver.nextReceive < sender.traffic.size() && !isFound) {
+            isFound = sender.traffic[receiver.nextReceive++] == got;
+        }
+        if (isFound) {
+            receiver.ok++;
+        } else {
+            receiver.corrupt++;
+        }
+    }
+}
+
+static void RunChessLink(uint32_t n, uint32_t interval)
+{
+    Wire toMega(CHESSLINK_BAUDRATE), toMkr(CHESSLINK_BAUDRATE);
+    WireStream mkrPort(toMega, toMkr), megaPort(toMkr, toMega);
+    Side mkr = {"mkr->mega", ChessLink(), MkrTraffic(n), 0, 0, 0, 0, 0};
+    Side mega = {"mega->mkr", ChessLink(), MegaTraffic(n), 0, 0, 0, 0, 0};
+    mkr.link.begin(mkrPort);
+    mega.link.begin(megaPort);
+
+    uint32_t start = millis();
+    // Until both sides sent everything and the last frames are acknowledged or given up
+    while (mkr.nextSend < n || mega.nextSend < n ||
+           mkr.link.stats().sent + mkr.link.stats().failed + mkr.rejected < n ||
+           mega.link.stats().sent + mega.link.stats().failed + mega.rejected < n) {
+        uint32_t due = (millis() - start) / interval;
+        Side *sides[2] = {&mkr, &mega};
+        for (int i = 0; i < 2; i++) {
+            Side &side = *sides[i];
+            if (side.nextSend < n && side.nextSend <= due &&
+                side.link.canSend(side.traffic[side.nextSend].size())) {
+                uint8_t type = &side == &mkr ? ChessLinkCommand : ChessLinkMessage;
+                if (!side.link.send(type, side.traffic[side.nextSend].c_str())) {
+                    side.rejected++;
+                }
+                side.nextSend++;
+            }
+        }
+        Deliver(mega, mkr);
+        Deliver(mkr, mega);
+        if (millis() - start > 60000) {
+            fprintf(stderr, "chesslink: no progress after 60 s\n");
+            break;
+        }
+    }
+    uint32_t elapsed = millis() - start;
+
+    const Side *sides[2] = {&mkr, &mega};
+    const Side *receivers[2] = {&mega, &mkr};
+    const Wire *wires[2] = {&toMega, &toMkr};
+    for (int i = 0; i < 2; i++) {
+        const ChessLinkStats &stats = sides[i]->link.stats();
+        size_t longestLine = 0;
+        for (size_t j = 0; j < sides[i]->traffic.size(); j++) {
+            if (sides[i]->traffic[j].size() > longestLine) {
+                longestLine = sides[i]->traffic[j].size();
+            }
+        }
+        double longest = (CHESSLINK_OVERHEAD + longestLine) * ByteTime(CHESSLINK_BAUDRATE);
+        printf("%-10s %-9s %6u %9u %8u %6u %8u %8u %9.1f %9.2f\n", "chesslink", sides[i]->name, n,
+               receivers[i]->ok, receivers[i]->corrupt, (unsigned)(stats.failed + sides[i]->rejected),
+               stats.retransmits, wires[i]->written, wires[i]->written * ByteTime(CHESSLINK_BAUDRATE) / 1000,
+               longest / 1000);
+    }
+    printf("chesslink: %u ms for %u messages each way at %u ms, %u CRC errors and %u duplicates seen by the Mega, "
+           "%u and %u by the MKR\n", elapsed, n, interval, mega.link.stats().crcErrors, mega.link.stats().duplicates,
+           mkr.link.stats().crcErrors, mkr.link.stats().duplicates);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 500;
+    uint32_t interval = 10;
+    unsigned seed = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--error") == 0 && i + 1 < argc) {
+            gError = strtod(argv[++i], 0);
+        } else if (strcmp(argv[i], "--drop") == 0 && i + 1 < argc) {
+            gDrop = strtod(argv[++i], 0);
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], 0, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [-n N] [--error P] [--drop P] [--interval MS] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (n == 0 || interval == 0) {
+        fprintf(stderr, "-n and --interval must be at least 1\n");
+        return 1;
+    }
+    srand(seed);
+
+    printf("%-10s %-9s %6s %9s %8s %6s %8s %8s %9s %9s\n", "link", "direction", "sent", "delivered", "corrupt",
+           "lost", "retrans", "bytes", "wire_ms", "line_ms");
+    RunText("mkr->mega", MkrTraffic(n));
+    RunText("mega->mkr", MegaTraffic(n));
+    RunChessLink(n, interval);
+    return 0;
+}
@@ -0,0 +1,553 @@
+/*
+ * Round-trip latency of every public Dobot_* call of Dobot.h, on the host build of the
+ * protocol stack (build/libmega.a), against the simulator or a real arm.
+ *
+ * Each call runs N times (the calls that wait for a motion run --motion-n times). For each
+ * call and each protocol ID it sends, the output row has:
+ *   calls, min/median/p99/mean time of the call in us,
+ *   frames and bytes on the wire per direction, retries
+ * A retry is a frame sent again with the same ID while the previous one has no reply yet.
+ * CommandSubmit times only the hand over of a frame to the TX queue, not its echo.
+ *
+ * The port is DOBOT_PORT (default /tmp/dobot-sim). `make latency` runs it on the simulator.
+ *
+ * Usage: DobotLatencyBench [-n N] [--motion-n N] [--format csv|json] [--out FILE]
+ *                          [--label TEXT] [--only NAME] [--baseline FILE.csv]
+ *
+ * --baseline reads the CSV of an earlier run and prints the median/p99 change of each row
+ * to stderr, so two commits can be compared on the same machine.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Arduino.h"
+#include "Dobot.h"
+#include "ProtocolDef.h"
+#include "ProtocolID.h"
+#include "DobotCmd.h"
+#include "DobotSerialHost.h"
+
+#define ID_NUM      256
+
+typedef struct tagIdStats {
+    uint32_t txFrames;
+    uint32_t rxFrames;
+    uint32_t txBytes;
+    uint32_t rxBytes;
+    uint32_t retries;
+}IdStats;
+
+// Frame decoder of one direction of the link
+typedef struct tagTapParser {
+    uint8_t state;
+    uint8_t len;
+    uint8_t count;
+    uint8_t id;
+    uint8_t checksum;
+}TapParser;
+
+typedef struct tagBenchCase {
+    const char *name;
+    bool isMotion;
+    void (*run)(uint32_t i);
+    void (*settle)(uint32_t i);                     // Untimed, after each call, may be 0
+}BenchCase;
+
+typedef struct tagBenchRow {
+    std::string call;
+    int id;
+    uint32_t calls;
+    double minUs, medianUs, p99Us, meanUs;
+    IdStats stats;
+}BenchRow;
+
+static IdStats gIdStats[ID_NUM];
+// Set when a frame of the ID is sent, cleared by its reply
+static volatile uint8_t gIsPending[ID_NUM];
+static TapParser gTxParser, gRxParser;
+
+/*
+ * Tap, the RX side runs in the reader thread of the shim and the TX side in its writer thread
+ */
+static void TapFrame(bool isTx, uint8_t id, uint8_t len)
+{
+    IdStats *stats = &gIdStats[id];
+    uint32_t bytes = sizeof(PacketHeader) + len + 1;
+
+    if (isTx) {
+        if (__atomic_load_n(&gIsPending[id], __ATOMIC_ACQUIRE)) {
+            __atomic_add_fetch(&stats->retries, 1, __ATOMIC_RELAXED);
+        }
+        __atomic_store_n(&gIsPending[id], 1, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&stats->txFrames, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->txBytes, bytes, __ATOMIC_RELAXED);
+    } else {
+        __atomic_store_n(&gIsPending[id], 0, __ATOMIC_RELEASE);
+        __atomic_add_fetch(&stats->rxFrames, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats->rxBytes, bytes, __ATOMIC_RELAXED);
+    }
+}
+
+static void TapParse(bool isTx, TapParser *parser, uint8_t byte)
+{
+    switch (parser->state) {
+    case PacketParseSyncByte1:
+        if (byte == SYNC_BYTE) {
+            parser->state = PacketParseSyncByte2;
+        }
+        break;
+    case PacketParseSyncByte2:
+        parser->state = byte == SYNC_BYTE ? PacketParsePayloadLen : PacketParseSyncByte1;
+        break;
+    case PacketParsePayloadLen:
+        if (byte == SYNC_BYTE) {
+            break;
+        }
+        if (byte < 2 || byte > MAX_PAYLOAD_SIZE) {
+            parser->state = PacketParseSyncByte1;
+            break;
+        }
+        parser->len = byte;
+        parser->count = 0;
+        parser->checksum = 0;
+        parser->state = PacketParsePayload;
+        break;
+    case PacketParsePayload:
+        if (parser->count == 0) {
+            parser->id = byte;
+        }
+        parser->checksum += byte;
+        if (++parser->count == parser->len) {
+            parser->state = PacketParseChecksum;
+        }
+        break;
+    case PacketParseChecksum:
+        parser->state = PacketParseSyncByte1;
+        if ((uint8_t)(parser->checksum + byte) == 0) {
+            TapFrame(isTx, parser->id, parser->len);
+        }
+        break;
+    }
+}
+
+static void Tap(bool isTx, const uint8_t *data, uint32_t len)
+{
+    TapParser *parser = isTx ? &gTxParser : &gRxParser;
+    for (uint32_t i = 0; i < len; i++) {
+        TapParse(isTx, parser, data[i]);
+    }
+}
+
+static void StatsReset(void)
+{
+    memset(gIdStats, 0, sizeof(gIdStats));
+    for (int i = 0; i < ID_NUM; i++) {
+        __atomic_store_n(&gIsPending[i], 0, __ATOMIC_RELEASE);
+    }
+}
+
+/*
+ * Cases, one per Dobot_* call, with arguments that leave a real arm where it was
+ */
+static const float gPointA[4] = {200, 0, 50, 0};
+static const float gPointB[4] = {200, 40, 50, 0};
+
+static bool gIsAtPointB;
+
+// Every motion goes to the other point, so none of them is empty
+static const float *NextPoint(void)
+{
+    gIsAtPointB = !gIsAtPointB;
+    return gIsAtPointB ? gPointB : gPointA;
+}
+
+static void RunInit(uint32_t) { Dobot_Init(); }
+static void RunGetDeviceTime(uint32_t) { Dobot_GetDeviceTime(); }
+static void RunSetDeviceWIthL(uint32_t) { Dobot_SetDeviceWIthL(false); }
+static void RunSetHOMECmd(uint32_t) { Dobot_SetHOMECmd(); }
+static void RunGetPose(uint32_t) { Dobot_GetPose(X); }
+
+static void RunGetPoseSnapshot(uint32_t)
+{
+    Pose pose;
+    Dobot_GetPoseSnapshot(pose);
+}
+
+// Within the freshness window only the first call reaches the Dobot
+static void RunGetPoseSnapshotCached(uint32_t)
+{
+    Pose pose;
+    Dobot_GetPoseSnapshot(pose, 60000);
+}
+static void RunSetEndEffectorParams(uint32_t) { Dobot_SetEndEffectorParams(59.7f, 0, 0); }
+static void RunSetEndEffectorLaser(uint32_t) { Dobot_SetEndEffectorLaser(0, 0); }
+static void RunSetEndEffectorSuctionCup(uint32_t) { Dobot_SetEndEffectorSuctionCup(false); }
+static void RunSetEndEffectorGripper(uint32_t) { Dobot_SetEndEffectorGripper(false, false); }
+static void RunSetJOGCommonParams(uint32_t) { Dobot_SetJOGCommonParams(50, 50); }
+static void RunSetJOGJointParams(uint32_t) { Dobot_SetJOGJointParams(50, 50, 50, 50, 50, 50, 50, 50); }
+static void RunSetJOGCoordinateParams(uint32_t) { Dobot_SetJOGCoordinateParams(50, 50, 50, 50, 50, 50, 50, 50); }
+static void RunSetJOGCmd(uint32_t) { Dobot_SetJOGCmd(IDLE); }
+static void RunSetPTPCommonParams(uint32_t) { Dobot_SetPTPCommonParams(100, 100); }
+static void RunSetPTPJointParams(uint32_t) { Dobot_SetPTPJointParams(200, 200, 200, 200, 200, 200, 200, 200); }
+static void RunSetPTPLParams(uint32_t) { Dobot_SetPTPLParams(100, 100); }
+static void RunSetPTPCoordinateParams(uint32_t) { Dobot_SetPTPCoordinateParams(200, 200, 200, 200); }
+static void RunSetPTPJumpParams(uint32_t) { Dobot_SetPTPJumpParams(20); }
+
+// Only the hand over of a PTP sized frame is timed, the echo is waited for untimed
+static int8_t gSubmitRequest = -1;
+
+static void RunCommandSubmit(uint32_t)
+{
+    static PTPCoordinateParams params = {200, 200, 200, 200};
+    gSubmitRequest = CommandSubmit(ProtocolPTPCoordinateParams, CmdSet, &params, sizeof(params), 1000);
+}
+
+static void SettleCommandSubmit(uint32_t)
+{
+    ProtocolRequestWait(gSubmitRequest);
+    ProtocolRequestRelease(gSubmitRequest);
+}
+
+static void RunSetPTPCmd(uint32_t)
+{
+    const float *p = NextPoint();
+    Dobot_SetPTPCmd(MOVJ_XYZ, p[0], p[1], p[2], p[3]);
+}
+
+static void RunSetPTPWithLCmd(uint32_t)
+{
+    const float *p = NextPoint();
+    Dobot_SetPTPWithLCmd(MOVJ_XYZ, p[0], p[1], p[2], p[3], 0);
+}
+
+static void RunBatchPTPCmd(uint32_t)
+{
+    const float *p = NextPoint();
+    Dobot_BatchPTPCmd(MOVJ_XYZ, p[0], p[1], p[2], p[3]);
+}
+
+static void RunSetCPParams(uint32_t) { Dobot_SetCPParams(200, 80, 200, 0); }
+
+static void RunBatchCPCmd(uint32_t)
+{
+    const float *p = NextPoint();
+    Dobot_BatchCPCmd(CPAbsoluteMode, p[0], p[1], p[2], 100);
+}
+
+// The batch params are cached, the value changes on each call so that each call is sent
+static void RunBatchPTPCommonParams(uint32_t i) { Dobot_BatchPTPCommonParams(i % 2 ? 100 : 50, 80); }
+static void RunBatchPTPJumpParams(uint32_t i) { Dobot_BatchPTPJumpParams(i % 2 ? 20 : 30, 100); }
+static void RunBatchEndEffectorGripper(uint32_t) { Dobot_BatchEndEffectorGripper(false, false); }
+static void RunBatchDwell(uint32_t) { Dobot_BatchDwell(0); }
+
+static void RunBatchWait(uint32_t)
+{
+    // Queue a point first, so there is a motion to wait for
+    RunBatchPTPCmd(0);
+    Dobot_BatchWait();
+}
+
+static void RunBatchIndex(uint32_t) { Dobot_BatchIndex(); }
+
+static void RunBatchAbort(uint32_t)
+{
+    uint64_t doneIndex;
+    Dobot_BatchAbort(&doneIndex);
+}
+
+// The function alternates, a port already set to it is not sent again
+static void RunSetIOMultiplexing(uint32_t i) { Dobot_SetIOMultiplexing(1, i % 2 ? IOFunctionDIPU : IOFunctionDI); }
+
+// All the ports one by one, then the same configs back to back
+static void RunSetIOMultiplexingAll(uint32_t i)
+{
+    for (uint8_t address = 0; address < IO_PORT_NUM; address++) {
+        Dobot_SetIOMultiplexing(address, i % 2 ? IOFunctionDIPU : IOFunctionDI);
+    }
+}
+
+static void RunSetIOMultiplexingList(uint32_t i)
+{
+    IOPortConfig ioConfigs[IO_PORT_NUM];
+    for (uint8_t address = 0; address < IO_PORT_NUM; address++) {
+        ioConfigs[address].address = address;
+        ioConfigs[address].function = i % 2 ? IOFunctionDI : IOFunctionDIPU;
+    }
+    Dobot_SetIOMultiplexingList(ioConfigs, IO_PORT_NUM);
+}
+static void RunSetIODO(uint32_t) { Dobot_SetIODO(1, 0); }
+static void RunSetIOPWM(uint32_t) { Dobot_SetIOPWM(1, 0, 0); }
+static void RunGetIODI(uint32_t) { Dobot_GetIODI(1); }
+static void RunGetIOADC(uint32_t) { Dobot_GetIOADC(1); }
+static void RunSetEMotor(uint32_t) { Dobot_SetEMotor(0, 0, 0); }
+static void RunSetEMotorS(uint32_t) { Dobot_SetEMotorS(0, 0, 0, 0); }
+static void RunSetColorSensor(uint32_t) { Dobot_SetColorSensor(0, 0, 0); }
+static void RunGetColorSensor(uint32_t) { Dobot_GetColorSensor(0); }
+static void RunSetIRSwitch(uint32_t) { Dobot_SetIRSwitch(0, 0); }
+static void RunGetIRSwitch(uint32_t) { Dobot_GetIRSwitch(0); }
+static void RunSetMotorPulse(uint32_t) { Dobot_SetMotorPulse(0, 0, 0, 0, 0, 0); }
+
+static const BenchCase gCases[] = {
+    {"Dobot_Init", true, RunInit},
+    {"Dobot_GetDeviceTime", false, RunGetDeviceTime},
+    {"Dobot_SetDeviceWIthL", false, RunSetDeviceWIthL},
+    {"Dobot_SetHOMECmd", true, RunSetHOMECmd},
+    {"Dobot_GetPose", false, RunGetPose},
+    {"Dobot_GetPoseSnapshot", false, RunGetPoseSnapshot},
+    {"Dobot_GetPoseSnapshot/cached", false, RunGetPoseSnapshotCached},
+    {"Dobot_SetEndEffectorParams", false, RunSetEndEffectorParams},
+    {"Dobot_SetEndEffectorLaser", false, RunSetEndEffectorLaser},
+    {"Dobot_SetEndEffectorSuctionCup", false, RunSetEndEffectorSuctionCup},
+    {"Dobot_SetEndEffectorGripper", false, RunSetEndEffectorGripper},
+    {"Dobot_SetJOGCommonParams", false, RunSetJOGCommonParams},
+    {"Dobot_SetJOGJointParams", false, RunSetJOGJointParams},
+    {"Dobot_SetJOGCoordinateParams", false, RunSetJOGCoordinateParams},
+    {"Dobot_SetJOGCmd", false, RunSetJOGCmd},
+    {"Dobot_SetPTPCommonParams", false, RunSetPTPCommonParams},
+    {"Dobot_SetPTPJointParams", false, RunSetPTPJointParams},
+    {"Dobot_SetPTPLParams", false, RunSetPTPLParams},
+    {"Dobot_SetPTPCoordinateParams", false, RunSetPTPCoordinateParams},
+    {"Dobot_SetPTPJumpParams", false, RunSetPTPJumpParams},
+    {"CommandSubmit", false, RunCommandSubmit, SettleCommandSubmit},
+    {"Dobot_SetPTPCmd", true, RunSetPTPCmd},
+    {"Dobot_SetPTPWithLCmd", true, RunSetPTPWithLCmd},
+    {"Dobot_SetCPParams", false, RunSetCPParams},
+    {"Dobot_BatchPTPCmd", false, RunBatchPTPCmd},
+    {"Dobot_BatchCPCmd", false, RunBatchCPCmd},
+    {"Dobot_BatchPTPCommonParams", false, RunBatchPTPCommonParams},
+    {"Dobot_BatchPTPJumpParams", false, RunBatchPTPJumpParams},
+    {"Dobot_BatchEndEffectorGripper", false, RunBatchEndEffectorGripper},
+    {"Dobot_BatchDwell", false, RunBatchDwell},
+    {"Dobot_BatchWait", true, RunBatchWait},
+    {"Dobot_BatchIndex", false, RunBatchIndex},
+    {"Dobot_BatchAbort", false, RunBatchAbort},
+    {"Dobot_SetIOMultiplexing", false, RunSetIOMultiplexing},
+    {"Dobot_SetIOMultiplexing/all", false, RunSetIOMultiplexingAll},
+    {"Dobot_SetIOMultiplexingList", false, RunSetIOMultiplexingList},
+    {"Dobot_SetIODO", false, RunSetIODO},
+    {"Dobot_SetIOPWM", false, RunSetIOPWM},
+    {"Dobot_GetIODI", false, RunGetIODI},
+    {"Dobot_GetIOADC", false, RunGetIOADC},
+    {"Dobot_SetEMotor", false, RunSetEMotor},
+    {"Dobot_SetEMotorS", false, RunSetEMotorS},
+    {"Dobot_SetColorSensor", false, RunSetColorSensor},
+    {"Dobot_GetColorSensor", false, RunGetColorSensor},
+    {"Dobot_SetIRSwitch", false, RunSetIRSwitch},
+    {"Dobot_GetIRSwitch", false, RunGetIRSwitch},
+    {"Dobot_SetMotorPulse", false, RunSetMotorPulse},
+};
+
+/*
+ * Run and report
+ */
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+    size_t rank = (size_t)(p * sorted.size() + 0.999999);
+    if (rank == 0) {
+        rank = 1;
+    }
+    return sorted[std::min(rank, sorted.size()) - 1];
+}
+
+static void RunCase(const BenchCase *benchCase, uint32_t n, std::vector<BenchRow> *rows)
+{
+    std::vector<double> times;
+
+    StatsReset();
+    for (uint32_t i = 0; i < n; i++) {
+        uint32_t start = micros();
+        benchCase->run(i);
+        times.push_back((double)(uint32_t)(micros() - start));
+        if (benchCase->settle) {
+            benchCase->settle(i);
+        }
+    }
+    // Late replies still count for the call, the frames of the cleanup below do not
+    delay(20);
+    IdStats idStats[ID_NUM];
+    memcpy(idStats, gIdStats, sizeof(idStats));
+    // Let the queued commands finish before the next call, and start the motions from the first point
+    Dobot_BatchWait();
+    if (strcmp(benchCase->name, "Dobot_Init") == 0) {
+        Dobot_SetPTPCmd(MOVJ_XYZ, gPointA[0], gPointA[1], gPointA[2], gPointA[3]);
+        gIsAtPointB = false;
+    }
+
+    std::sort(times.begin(), times.end());
+    double sum = 0;
+    for (size_t i = 0; i < times.size(); i++) {
+        sum += times[i];
+    }
+    BenchRow row;
+    row.call = benchCase->name;
+    row.calls = n;
+    row.minUs = times.front();
+    row.medianUs = Percentile(times, 0.5);
+    row.p99Us = Percentile(times, 0.99);
+    row.meanUs = sum / times.size();
+
+    bool isAny = false;
+    for (int id = 0; id < ID_NUM; id++) {
+        if (idStats[id].txFrames == 0 && idStats[id].rxFrames == 0) {
+            continue;
+        }
+        row.id = id;
+        row.stats = idStats[id];
+        rows->push_back(row);
+        isAny = true;
+    }
+    // No frame at all, the call is served from the Mega side
+    if (isAny == false) {
+        row.id = -1;
+        memset(&row.stats, 0, sizeof(row.stats));
+        rows->push_back(row);
+    }
+    fprintf(stderr, "%-32s median %9.0f us  p99 %9.0f us\n", benchCase->name, row.medianUs, row.p99Us);
+}
+
+static void IdText(int id, char *text, size_t size)
+{
+    if (id < 0) {
+        snprintf(text, size, "-");
+    } else {
+        snprintf(text, size, "%d", id);
+    }
+}
+
+static void WriteCsv(FILE *out, const char *label, const std::vector<BenchRow> &rows)
+{
+    fprintf(out, "label,call,id,calls,min_us,median_us,p99_us,mean_us,"
+                 "tx_frames,rx_frames,tx_bytes,rx_bytes,retries\n");
+    for (size_t i = 0; i < rows.size(); i++) {
+        const BenchRow &row = rows[i];
+        char id[12];
+        IdText(row.id, id, sizeof(id));
+        fprintf(out, "%s,%s,%s,%u,%.0f,%.0f,%.0f,%.1f,%u,%u,%u,%u,%u\n",
+                label, row.call.c_str(), id, row.calls, row.minUs, row.medianUs, row.p99Us, row.meanUs,
+                row.stats.txFrames, row.stats.rxFrames, row.stats.txBytes, row.stats.rxBytes,
+                row.stats.retries);
+    }
+}
+
+static void WriteJson(FILE *out, const char *label, const std::vector<BenchRow> &rows)
+{
+    fprintf(out, "{\n  \"label\": \"%s\",\n  \"rows\": [\n", label);
+    for (size_t i = 0; i < rows.size(); i++) {
+        const BenchRow &row = rows[i];
+        char id[12];
+        IdText(row.id, id, sizeof(id));
+        fprintf(out, "    {\"call\": \"%s\", \"id\": %s, \"calls\": %u, "
+                     "\"min_us\": %.0f, \"median_us\": %.0f, \"p99_us\": %.0f, \"mean_us\": %.1f, "
+                     "\"tx_frames\": %u, \"rx_frames\": %u, \"tx_bytes\": %u, \"rx_bytes\": %u, "
+                     "\"retries\": %u}%s\n",
+                row.call.c_str(), row.id < 0 ? "null" : id, row.calls,
+                row.minUs, row.medianUs, row.p99Us, row.meanUs,
+                row.stats.txFrames, row.stats.rxFrames, row.stats.txBytes, row.stats.rxBytes,
+                row.stats.retries, i + 1 < rows.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// Median and p99 change against the rows of an earlier CSV with the same call and id
+static void CompareBaseline(const char *path, const std::vector<BenchRow> &rows)
+{
+    FILE *in = fopen(path, "r");
+    char line[512];
+
+    if (in == 0) {
+        perror(path);
+        return;
+    }
+    fprintf(stderr, "\n%-32s %5s %12s %12s %12s %12s\n", "call", "id", "median_us", "change", "p99_us", "change");
+    while (fgets(line, sizeof(line), in)) {
+        char call[64], id[8];
+        double medianUs, p99Us;
+        if (sscanf(line, "%*[^,],%63[^,],%7[^,],%*u,%*f,%lf,%lf", call, id, &medianUs, &p99Us) != 4) {
+            continue;
+        }
+        for (size_t i = 0; i < rows.size(); i++) {
+            char rowId[12];
+            IdText(rows[i].id, rowId, sizeof(rowId));
+            if (rows[i].call != call || strcmp(rowId, id) != 0) {
+                continue;
+            }
+            fprintf(stderr, "%-32s %5s %12.0f %+11.1f%% %12.0f %+11.1f%%\n", call, id,
+                    rows[i].medianUs, medianUs > 0 ? 100 * (rows[i].medianUs - medianUs) / medianUs : 0,
+                    rows[i].p99Us, p99Us > 0 ? 100 * (rows[i].p99Us - p99Us) / p99Us : 0);
+        }
+    }
+    fclose(in);
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 50, motionN = 5;
+    const char *format = "csv", *outPath = 0, *label = "", *only = 0, *baseline = 0;
+
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : 0;
+        if (value == 0) {
+            fprintf(stderr, "Missing value of %s\n", argv[i]);
+            return 2;
+        }
+        if (strcmp(argv[i], "-n") == 0) {
+            n = strtoul(value, 0, 10);
+        } else if (strcmp(argv[i], "--motion-n") == 0) {
+            motionN = strtoul(value, 0, 10);
+        } else if (strcmp(argv[i], "--format") == 0) {
+            format = value;
+        } else if (strcmp(argv[i], "--out") == 0) {
+            outPath = value;
+        } else if (strcmp(argv[i], "--label") == 0) {
+            label = value;
+        } else if (strcmp(argv[i], "--only") == 0) {
+            only = value;
+        } else if (strcmp(argv[i], "--baseline") == 0) {
+            baseline = value;
+        } else {
+            fprintf(stderr, "Usage: %s [-n N] [--motion-n N] [--format csv|json] [--out FILE]\n"
+                            "       [--label TEXT] [--only NAME] [--baseline FILE.csv]\n", argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (n == 0 || motionN == 0) {
+        fprintf(stderr, "N must be at least 1\n");
+        return 2;
+    }
+
+    DobotSerialSetTap(Tap);
+    std::vector<BenchRow> rows;
+    for (size_t i = 0; i < sizeof(gCases) / sizeof(gCases[0]); i++) {
+        const BenchCase *benchCase = &gCases[i];
+        // Dobot_Init opens the port, it always runs and only once
+        bool isInit = i == 0;
+        if (isInit == false && only && strstr(benchCase->name, only) == 0) {
+            continue;
+        }
+        RunCase(benchCase, isInit ? 1 : benchCase->isMotion ? motionN : n, &rows);
+    }
+
+    FILE *out = outPath ? fopen(outPath, "w") : stdout;
+    if (out == 0) {
+        perror(outPath);
+        return 1;
+    }
+    if (strcmp(format, "json") == 0) {
+        WriteJson(out, label, rows);
+    } else {
+        WriteCsv(out, label, rows);
+    }
+    if (outPath) {
+        fclose(out);
+    }
+    if (baseline) {
+        CompareBaseline(baseline, rows);
+    }
+    return 0;
+}
@@ -0,0 +1,732 @@
+/*
+ * Time of a chess move with each transfer strategy of Mega.ino, on the host build of the
+ * protocol stack (build/libmega.a), against the simulator or a real arm:
+ *   MOVJ  - six MOVJ points per transfer, the arm stops at each of them
+ *   CP    - lift, travel and descend as one CP path, corners rounded by the blend radius
+ *   JUMP  - one JUMP_XYZ hop to the pickup and one to the place point, jump params queued before each
+ *
+ * The commands are queued the way planTransfer/queueStep of Mega.ino queue them, with the same
+ * heights, speed profiles and dwells, on a board calibrated with a8 at (BOARD_X, BOARD_Y) and
+ * BOARD_SQUARE mm squares. Each run starts at rest at the home point and ends when the Dobot
+ * queue is finished. The output has the median time of each move and strategy over N runs,
+ * and its ratio to MOVJ.
+ *
+ * --sequence runs the moves one after the other instead, in three ways: drained queues each
+ * move at once and waits for it before the next one; streamed keeps at most --lookahead
+ * commands in the Dobot queue (Dobot_BatchReserve before each step) and waits only at the end;
+ * ticked sends one step per turn of a loop when Dobot_BatchHasRoom, and otherwise calls
+ * Dobot_BatchPoll, as streamTick of Mega.ino does. Each way also reports its longest single
+ * call, the time the loop of the Mega would not read its serial links.
+ *
+ * --jam streams the first move into a jam of the simulator (DobotSim --jam-at) and prints how
+ * the wait ended and after how long. --alarm-period sets how often the waits read the alarms,
+ * 0 leaves only the stall timeout of the queue.
+ *
+ * --estop presses the emergency stop during a CP move, N times at a random point of the move,
+ * and prints the time from the press to the force stop frame on the wire. The move is ticked as
+ * a move of Mega.ino, or blocking as home, test and the calibration moves, which queue all the
+ * steps and wait for the end. interrupt is the button ISR of Mega.ino: a thread calls
+ * Dobot_ForceStop, as the ISR preempts the main loop. polled is the emergency command read by the
+ * loop: the stop is seen once the current call returns and sent by Dobot_BatchAbort.
+ *
+ * The port is DOBOT_PORT (default /tmp/dobot-sim). `make transfer` runs it on the simulator.
+ *
+ * Usage: DobotTransferBench [-n N] [--blend MM] [--no-dwell] [--sequence] [--lookahead N]
+ *                           [--jam] [--alarm-period MS] [--estop]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <vector>
+#include <algorithm>
+
+#include "Arduino.h"
+#include "Dobot.h"
+#include "ProtocolDef.h"
+#include "ProtocolID.h"
+#include "DobotSerialHost.h"
+
+// Board and heights of Mega.ino
+#define BOARD_X                 125.0f
+#define BOARD_Y                 -80.0f
+#define BOARD_SQUARE            25.0f
+#define Z_GRIPPER_ZERO          -15.0f
+#define SAFE_TRAVEL_HEIGHT      37.0f
+#define SAFE_TRAVEL_HEIGHT_EDGE 27.0f
+#define PIECE_GRAB_OFFSET       5.0f
+#define PTP_XYZ_VELOCITY        200.0f
+#define PTP_XYZ_ACCELERATION    200.0f
+#define CP_VELOCITY             100.0f
+#define CAPTURED_PIECES_X       200
+#define CAPTURED_PIECES_Y       200
+#define CAPTURED_PIECES_Z       0
+#define PIECE_HEIGHT_PAWN       32.097f
+#define PIECE_HEIGHT_KNIGHT     43.674f
+#define PIECE_HEIGHT_BISHOP     47.894f
+#define PIECE_HEIGHT_KING       53.676f
+#define CP_PLAN_ACC             200.0f
+#define CP_JUNCTION_VEL         80.0f
+#define CP_ACC                  200.0f
+
+#define GRIPPER_NONE  0
+#define GRIPPER_CLOSE 1
+#define GRIPPER_OPEN  2
+
+#define MOTION_PTP  0
+#define MOTION_CP   1
+#define MOTION_JUMP 2
+
+#define TRANSFER_MOVJ 0
+#define TRANSFER_CP   1
+#define TRANSFER_JUMP 2
+
+static const float gRest[3] = {200, 0, 50};
+
+// Speed profiles of pieceProfiles in Mega.ino, ratios in %
+typedef struct tagSpeedProfile {
+    float velocityRatio;
+    float accelerationRatio;
+}SpeedProfile;
+
+typedef struct tagPieceProfile {
+    float height;
+    SpeedProfile travel;
+    SpeedProfile approach;
+}PieceProfile;
+
+static const PieceProfile gPawn = {PIECE_HEIGHT_PAWN, {100, 80}, {30, 30}};
+static const PieceProfile gKnight = {PIECE_HEIGHT_KNIGHT, {90, 70}, {25, 25}};
+static const PieceProfile gBishop = {PIECE_HEIGHT_BISHOP, {80, 60}, {25, 25}};
+static const PieceProfile gKing = {PIECE_HEIGHT_KING, {70, 50}, {20, 20}};
+
+typedef struct tagStep {
+    float x, y, z;
+    const SpeedProfile *profile;
+    uint8_t gripper;
+    uint8_t motion;
+    float jumpHeight, jumpLimit;
+}Step;
+
+typedef struct tagBenchMove {
+    const char *name;
+    const PieceProfile *piece;
+}BenchMove;
+
+static const BenchMove gMoves[] = {
+    {"e2e4", &gPawn},
+    {"g1f3", &gKnight},
+    {"c1h6", &gBishop},
+    {"a1h8", &gKing},
+    {"e4xd5", &gPawn},
+};
+
+static const char *gStrategyNames[] = {"MOVJ", "CP", "JUMP"};
+
+// Most commands QueueStep queues for one step, STEP_MAX_COMMANDS of Mega.ino
+#define STEP_MAX_COMMANDS 7
+
+static float gBlendRadius = 10;
+static bool gIsDwell = true;
+static uint8_t gLookahead = 20;
+
+static void Square(char file, char rank, float *x, float *y)
+{
+    *x = BOARD_X + (file - 'a') * BOARD_SQUARE;
+    *y = BOARD_Y + (8 - (rank - '0')) * BOARD_SQUARE;
+}
+
+// Travel height of the column under x, the columns a and h are lower
+static float SafeTravelHeight(float x)
+{
+    int col = (int)roundf((x - BOARD_X) / BOARD_SQUARE);
+    return col == 0 || col == 7 ? SAFE_TRAVEL_HEIGHT_EDGE : SAFE_TRAVEL_HEIGHT;
+}
+
+/*
+ * Planner, same points as planTransfer of Mega.ino
+ */
+static void PlanTransfer(float fromX, float fromY, float fromZ, float toX, float toY, float toZ,
+                         int strategy, const PieceProfile *piece, std::vector<Step> *steps)
+{
+    float travelZ = std::min(SafeTravelHeight(fromX), SafeTravelHeight(toX)) - 15.0f;
+    const SpeedProfile *fast = &piece->travel;
+    const SpeedProfile *slow = &piece->approach;
+
+    if (strategy == TRANSFER_JUMP) {
+        Step plan[] = {
+            {fromX, fromY, fromZ + PIECE_GRAB_OFFSET, fast, GRIPPER_CLOSE, MOTION_JUMP, piece->height, travelZ},
+            {toX, toY, toZ + PIECE_GRAB_OFFSET, fast, GRIPPER_OPEN, MOTION_JUMP, piece->height, travelZ},
+            {toX, toY, travelZ, fast, GRIPPER_NONE, MOTION_PTP, 0, 0},
+        };
+        steps->insert(steps->end(), plan, plan + sizeof(plan) / sizeof(plan[0]));
+        return;
+    }
+    uint8_t motion = strategy == TRANSFER_CP ? MOTION_CP : MOTION_PTP;
+    Step plan[] = {
+        {fromX, fromY, travelZ, fast, GRIPPER_NONE, MOTION_PTP, 0, 0},
+        {fromX, fromY, fromZ + PIECE_GRAB_OFFSET, slow, GRIPPER_CLOSE, MOTION_PTP, 0, 0},
+        {fromX, fromY, travelZ, fast, GRIPPER_NONE, motion, 0, 0},
+        {toX, toY, travelZ, fast, GRIPPER_NONE, motion, 0, 0},
+        {toX, toY, toZ + PIECE_GRAB_OFFSET, slow, GRIPPER_OPEN, motion, 0, 0},
+        {toX, toY, travelZ, fast, GRIPPER_NONE, MOTION_PTP, 0, 0},
+    };
+    steps->insert(steps->end(), plan, plan + sizeof(plan) / sizeof(plan[0]));
+}
+
+static void PlanMove(const BenchMove *move, int strategy, std::vector<Step> *steps)
+{
+    const char *name = move->name;
+    bool isCapture = strchr(name, 'x') != 0;
+    const char *to = isCapture ? name + 3 : name + 2;
+    float fromX, fromY, toX, toY;
+
+    Square(name[0], name[1], &fromX, &fromY);
+    Square(to[0], to[1], &toX, &toY);
+    steps->clear();
+    if (isCapture) {
+        // First deposit, the captured piece is not known
+        PlanTransfer(toX, toY, Z_GRIPPER_ZERO, CAPTURED_PIECES_X, CAPTURED_PIECES_Y, CAPTURED_PIECES_Z,
+                     strategy, &gKing, steps);
+    }
+    PlanTransfer(fromX, fromY, Z_GRIPPER_ZERO, toX, toY, Z_GRIPPER_ZERO, strategy, move->piece, steps);
+}
+
+// CP velocity of a profile, in mm/s
+static float CPVelocity(const SpeedProfile *profile)
+{
+    return CP_VELOCITY * profile->velocityRatio / 100.0f;
+}
+
+/*
+ * Queue, same commands as queueStep/queueCPStep of Mega.ino
+ */
+static CmdStatus QueueCPStep(const Step *prev, const Step &step, const Step *next)
+{
+    bool isBlended = prev && next && next->motion == MOTION_CP && step.gripper == GRIPPER_NONE && gBlendRadius > 0;
+    if (isBlended == false) {
+        return Dobot_BatchCPCmd(CPAbsoluteMode, step.x, step.y, step.z, CPVelocity(step.profile));
+    }
+
+    float corner[3] = {step.x, step.y, step.z};
+    float in[3] = {step.x - prev->x, step.y - prev->y, step.z - prev->z};
+    float out[3] = {next->x - step.x, next->y - step.y, next->z - step.z};
+    float inLength = sqrtf(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+    float outLength = sqrtf(out[0] * out[0] + out[1] * out[1] + out[2] * out[2]);
+    float radius = std::min(gBlendRadius, std::min(inLength, outLength) / 2);
+    if (radius <= 0.01f) {
+        return Dobot_BatchCPCmd(CPAbsoluteMode, step.x, step.y, step.z, CPVelocity(step.profile));
+    }
+
+    float entry[3], middle[3], exit[3];
+    for (int i = 0; i < 3; i++) {
+        entry[i] = corner[i] - in[i] / inLength * radius;
+        exit[i] = corner[i] + out[i] / outLength * radius;
+        middle[i] = 0.25f * entry[i] + 0.5f * corner[i] + 0.25f * exit[i];
+    }
+    float velocity = CPVelocity(step.profile);
+    CmdStatus status = Dobot_BatchCPCmd(CPAbsoluteMode, entry[0], entry[1], entry[2], velocity);
+    if (status == CmdStatusOk) {
+        status = Dobot_BatchCPCmd(CPAbsoluteMode, middle[0], middle[1], middle[2], velocity);
+    }
+    if (status == CmdStatusOk) {
+        status = Dobot_BatchCPCmd(CPAbsoluteMode, exit[0], exit[1], exit[2], CPVelocity(next->profile));
+    }
+    return status;
+}
+
+static CmdStatus QueueStep(const Step *prev, const Step &step, const Step *next)
+{
+    CmdStatus status;
+
+    if (step.motion == MOTION_CP) {
+        status = QueueCPStep(prev, step, next);
+    } else {
+        status = Dobot_BatchPTPCommonParams(step.profile->velocityRatio, step.profile->accelerationRatio);
+        if (status == CmdStatusOk && step.motion == MOTION_JUMP) {
+            if ((status = Dobot_BatchPTPJumpParams(step.jumpHeight, step.jumpLimit)) == CmdStatusOk) {
+                status = Dobot_BatchPTPCmd(JUMP_XYZ, step.x, step.y, step.z, 0);
+            }
+        } else if (status == CmdStatusOk) {
+            status = Dobot_BatchPTPCmd(MOVJ_XYZ, step.x, step.y, step.z, 0);
+        }
+    }
+    if (status != CmdStatusOk || step.gripper == GRIPPER_NONE) {
+        return status;
+    }
+    bool isGriped = step.gripper == GRIPPER_CLOSE;
+    if (gIsDwell && (status = Dobot_BatchDwell(500)) != CmdStatusOk) {
+        return status;
+    }
+    if ((status = Dobot_BatchEndEffectorGripper(true, isGriped)) != CmdStatusOk) {
+        return status;
+    }
+    if (gIsDwell && (status = Dobot_BatchDwell(300)) != CmdStatusOk) {
+        return status;
+    }
+    return isGriped ? CmdStatusOk : Dobot_BatchEndEffectorGripper(false, false);
+}
+
+// Stop a failed run, report and clear its alarms: a latched alarm would fail all the next runs too
+static void AbortRun(void)
+{
+    uint8_t codes[ALARMS_STATE_SIZE * 8];
+    uint8_t count = 0;
+    uint64_t doneIndex;
+
+    Dobot_GetAlarms(codes, sizeof(codes), &count);
+    Dobot_BatchAbort(&doneIndex);
+    Dobot_ClearAlarms();
+    for (uint8_t i = 0; i < count; i++) {
+        fprintf(stderr, "[ERROR]Run aborted, alarm 0x%02x %s\n", codes[i], Dobot_AlarmName(codes[i]));
+    }
+}
+
+// Time of one run in ms, negative if a command failed
+static double RunMove(const BenchMove *move, int strategy)
+{
+    std::vector<Step> steps;
+    PlanMove(move, strategy, &steps);
+
+    Dobot_BatchPTPCmd(MOVJ_XYZ, gRest[0], gRest[1], gRest[2], 0);
+    if (Dobot_BatchWait() != CmdStatusOk) {
+        return -1;
+    }
+    unsigned long start = micros();
+    CmdStatus status = CmdStatusOk;
+    for (size_t i = 0; i < steps.size() && status == CmdStatusOk; i++) {
+        const Step *prev = i > 0 ? &steps[i - 1] : 0;
+        const Step *next = i + 1 < steps.size() ? &steps[i + 1] : 0;
+        status = QueueStep(prev, steps[i], next);
+    }
+    if (status == CmdStatusOk) {
+        status = Dobot_BatchWait();
+    }
+    if (status != CmdStatusOk) {
+        AbortRun();
+        return -1;
+    }
+    return (micros() - start) / 1000.0;
+}
+
+// Ways to run a sequence, see --sequence
+#define SEQUENCE_DRAINED  0
+#define SEQUENCE_STREAMED 1
+#define SEQUENCE_TICKED   2
+#define SEQUENCE_MODES    3
+
+static const char *gSequenceModeNames[SEQUENCE_MODES] = {"drained", "streamed", "ticked"};
+
+// Longest single call of the running sequence, in ms: how long the loop of the Mega would not run
+static double gLongestCall;
+
+static void NoteCall(unsigned long start)
+{
+    double ms = (micros() - start) / 1000.0;
+    if (ms > gLongestCall) {
+        gLongestCall = ms;
+    }
+}
+
+// Set by the polled emergency stop of --estop, seen by the loop between two ticks
+static volatile bool gIsStopRequested;
+
+// Steps of all the moves, sent one per turn of the loop as streamTick of Mega.ino sends them
+static CmdStatus TickSequence(const std::vector<Step> &steps, const std::vector<size_t> &moveStart)
+{
+    CmdStatus status = CmdStatusOk;
+    size_t sent = 0;
+    size_t move = 0;
+
+    while (status == CmdStatusOk) {
+        if (gIsStopRequested) {
+            return CmdStatusStopped;
+        }
+        unsigned long start = micros();
+        if (sent < steps.size() && Dobot_BatchHasRoom(STEP_MAX_COMMANDS, gLookahead)) {
+            while (move + 1 < moveStart.size() && moveStart[move + 1] <= sent) {
+                move++;
+            }
+            size_t end = move + 1 < moveStart.size() ? moveStart[move + 1] : steps.size();
+            const Step *prev = sent > moveStart[move] ? &steps[sent - 1] : 0;
+            const Step *next = sent + 1 < end ? &steps[sent + 1] : 0;
+            status = QueueStep(prev, steps[sent], next);
+            sent++;
+        } else if (sent == steps.size() && Dobot_BatchDoneIndex() >= Dobot_BatchIndex()) {
+            break;
+        } else {
+            status = Dobot_BatchPoll();
+        }
+        NoteCall(start);
+    }
+    return status;
+}
+
+// Time of the whole sequence of moves in ms, negative if a command failed
+static double RunSequence(int strategy, int mode)
+{
+    std::vector<Step> steps;
+
+    Dobot_BatchPTPCmd(MOVJ_XYZ, gRest[0], gRest[1], gRest[2], 0);
+    if (Dobot_BatchWait() != CmdStatusOk) {
+        return -1;
+    }
+    gLongestCall = 0;
+    unsigned long start = micros();
+    CmdStatus status = CmdStatusOk;
+    if (mode == SEQUENCE_TICKED) {
+        std::vector<Step> all;
+        std::vector<size_t> moveStart;
+        for (size_t m = 0; m < sizeof(gMoves) / sizeof(gMoves[0]); m++) {
+            PlanMove(&gMoves[m], strategy, &steps);
+            moveStart.push_back(all.size());
+            all.insert(all.end(), steps.begin(), steps.end());
+        }
+        status = TickSequence(all, moveStart);
+    }
+    for (size_t m = 0; m < sizeof(gMoves) / sizeof(gMoves[0]) && mode != SEQUENCE_TICKED && status == CmdStatusOk; m++) {
+        PlanMove(&gMoves[m], strategy, &steps);
+        for (size_t i = 0; i < steps.size() && status == CmdStatusOk; i++) {
+            unsigned long callStart = micros();
+            if (mode == SEQUENCE_STREAMED) {
+                status = Dobot_BatchReserve(STEP_MAX_COMMANDS, gLookahead);
+            }
+            if (status == CmdStatusOk) {
+                const Step *prev = i > 0 ? &steps[i - 1] : 0;
+                const Step *next = i + 1 < steps.size() ? &steps[i + 1] : 0;
+                status = QueueStep(prev, steps[i], next);
+            }
+            NoteCall(callStart);
+        }
+        if (status == CmdStatusOk && mode == SEQUENCE_DRAINED) {
+            unsigned long callStart = micros();
+            status = Dobot_BatchWait();
+            NoteCall(callStart);
+        }
+    }
+    if (status == CmdStatusOk && mode != SEQUENCE_TICKED) {
+        unsigned long callStart = micros();
+        status = Dobot_BatchWait();
+        NoteCall(callStart);
+    }
+    if (status != CmdStatusOk) {
+        AbortRun();
+        return -1;
+    }
+    return (micros() - start) / 1000.0;
+}
+
+static int BenchSequence(uint32_t n)
+{
+    int failures = 0;
+
+    printf("sequence,strategy,runs,drained_ms,streamed_ms,ticked_ms,vs_drained,"
+           "drained_longest_call_ms,streamed_longest_call_ms,ticked_longest_call_ms\n");
+    for (int strategy = TRANSFER_MOVJ; strategy <= TRANSFER_JUMP; strategy++) {
+        std::vector<double> times[SEQUENCE_MODES];
+        double longest[SEQUENCE_MODES] = {0};
+        for (uint32_t i = 0; i < n; i++) {
+            for (int mode = 0; mode < SEQUENCE_MODES; mode++) {
+                double ms = RunSequence(strategy, mode);
+                if (ms < 0) {
+                    failures++;
+                    continue;
+                }
+                times[mode].push_back(ms);
+                longest[mode] = std::max(longest[mode], gLongestCall);
+            }
+        }
+        bool isComplete = true;
+        double median[SEQUENCE_MODES];
+        for (int mode = 0; mode < SEQUENCE_MODES; mode++) {
+            if (times[mode].empty()) {
+                fprintf(stderr, "%s %s: no run finished\n", gStrategyNames[strategy], gSequenceModeNames[mode]);
+                isComplete = false;
+                continue;
+            }
+            std::sort(times[mode].begin(), times[mode].end());
+            median[mode] = times[mode][times[mode].size() / 2];
+        }
+        if (isComplete == false) {
+            printf("all,%s,0,,,,,,,\n", gStrategyNames[strategy]);
+            continue;
+        }
+        printf("all,%s,%u,%.0f,%.0f,%.0f,%.2f,%.0f,%.0f,%.0f\n", gStrategyNames[strategy],
+               (unsigned)times[SEQUENCE_TICKED].size(),
+               median[SEQUENCE_DRAINED], median[SEQUENCE_STREAMED], median[SEQUENCE_TICKED],
+               median[SEQUENCE_STREAMED] / median[SEQUENCE_DRAINED],
+               longest[SEQUENCE_DRAINED], longest[SEQUENCE_STREAMED], longest[SEQUENCE_TICKED]);
+    }
+    return failures;
+}
+
+// First move with the simulator jamming one of its motions, 0 if the jam was detected
+static int BenchJam(void)
+{
+    std::vector<Step> steps;
+
+    PlanMove(&gMoves[0], TRANSFER_MOVJ, &steps);
+    Dobot_BatchPTPCmd(MOVJ_XYZ, gRest[0], gRest[1], gRest[2], 0);
+    if (Dobot_BatchWait() != CmdStatusOk) {
+        return 1;
+    }
+    printf("jam,first_index,status,wait_ms,alarms\n");
+    uint64_t firstIndex = Dobot_BatchIndex() + 1;
+    unsigned long start = micros();
+    CmdStatus status = CmdStatusOk;
+    for (size_t i = 0; i < steps.size() && status == CmdStatusOk; i++) {
+        status = Dobot_BatchReserve(STEP_MAX_COMMANDS, gLookahead);
+        if (status == CmdStatusOk) {
+            const Step *prev = i > 0 ? &steps[i - 1] : 0;
+            const Step *next = i + 1 < steps.size() ? &steps[i + 1] : 0;
+            status = QueueStep(prev, steps[i], next);
+        }
+    }
+    if (status == CmdStatusOk) {
+        status = Dobot_BatchWait();
+    }
+    double ms = (micros() - start) / 1000.0;
+
+    uint8_t codes[8];
+    uint8_t count = 0;
+    Dobot_GetAlarms(codes, sizeof(codes), &count);
+    uint64_t doneIndex;
+    Dobot_BatchAbort(&doneIndex);
+    Dobot_ClearAlarms();
+    printf("%s,%llu,%d,%.0f,", gMoves[0].name, (unsigned long long)firstIndex, status, ms);
+    for (uint8_t i = 0; i < count; i++) {
+        printf("%s0x%02x %s", i ? " " : "", codes[i], Dobot_AlarmName(codes[i]));
+    }
+    printf("\n");
+    return status == CmdStatusOk ? 1 : 0;
+}
+
+// --estop: time of the press, and of the first force stop frame on the wire after it, in us
+static volatile unsigned long gPressTime;
+static volatile unsigned long gStopSentTime;
+static volatile bool gIsPressed;
+static uint8_t gTapState, gTapLen, gTapCount;
+
+// Tap of the writer thread of the shim, only the ID of each frame sent is needed
+static void TapStop(bool isTx, const uint8_t *data, uint32_t len)
+{
+    for (uint32_t i = 0; isTx && i < len; i++) {
+        uint8_t byte = data[i];
+        switch (gTapState) {
+        case 0:
+        case 1:
+            gTapState = byte == SYNC_BYTE ? gTapState + 1 : 0;
+            break;
+        case 2:
+            if (byte != SYNC_BYTE) {
+                gTapLen = byte;
+                gTapCount = 0;
+                gTapState = 3;
+            }
+            break;
+        default:
+            if (gTapCount++ == 0 && byte == ProtocolQueuedCmdForceStopExec && gIsPressed && gStopSentTime == 0) {
+                gStopSentTime = micros();
+            }
+            // Payload and checksum
+            if (gTapCount == gTapLen + 1) {
+                gTapState = 0;
+            }
+            break;
+        }
+    }
+}
+
+typedef struct tagEstopPress {
+    uint32_t delayMs;
+    bool isInterrupt;
+}EstopPress;
+
+static void *PressEstop(void *arg)
+{
+    const EstopPress *press = (const EstopPress *)arg;
+
+    delay(press->delayMs);
+    gPressTime = micros();
+    gIsPressed = true;
+    if (press->isInterrupt) {
+        Dobot_ForceStop();
+    } else {
+        gIsStopRequested = true;
+    }
+    return 0;
+}
+
+// Time from the press to the force stop on the wire in us, negative if the run failed
+static double RunEstop(bool isBlocking, bool isInterrupt, uint32_t delayMs)
+{
+    std::vector<Step> steps;
+    std::vector<size_t> moveStart(1, 0);
+
+    Dobot_BatchPTPCmd(MOVJ_XYZ, gRest[0], gRest[1], gRest[2], 0);
+    if (Dobot_BatchWait() != CmdStatusOk) {
+        return -1;
+    }
+    PlanMove(&gMoves[0], TRANSFER_CP, &steps);
+    gIsPressed = false;
+    gIsStopRequested = false;
+    gStopSentTime = 0;
+
+    EstopPress press = {delayMs, isInterrupt};
+    pthread_t button;
+    pthread_create(&button, 0, PressEstop, &press);
+    CmdStatus status = CmdStatusOk;
+    if (isBlocking) {
+        for (size_t i = 0; i < steps.size() && status == CmdStatusOk; i++) {
+            const Step *prev = i > 0 ? &steps[i - 1] : 0;
+            const Step *next = i + 1 < steps.size() ? &steps[i + 1] : 0;
+            status = QueueStep(prev, steps[i], next);
+        }
+        if (status == CmdStatusOk) {
+            status = Dobot_BatchWait();
+        }
+        // The loop reads the command only now
+        if (status == CmdStatusOk && gIsStopRequested) {
+            status = CmdStatusStopped;
+        }
+    } else {
+        status = TickSequence(steps, moveStart);
+    }
+    pthread_join(button, 0);
+
+    // What the loop does next in both cases: emergencyStop of Mega.ino
+    uint64_t doneIndex;
+    CmdStatus abortStatus = Dobot_BatchAbort(&doneIndex);
+    gIsStopRequested = false;
+    if (status != CmdStatusStopped || abortStatus != CmdStatusOk || gStopSentTime == 0) {
+        fprintf(stderr, "[ERROR]Stop not sent, move status %d, abort status %d\n", status, abortStatus);
+        AbortRun();
+        return -1;
+    }
+    return (double)(gStopSentTime - gPressTime);
+}
+
+static int BenchEstop(uint32_t n)
+{
+    const char *moveNames[2] = {"ticked", "blocking"};
+    const char *stopNames[2] = {"polled", "interrupt"};
+    int failures = 0;
+
+    DobotSerialSetTap(TapStop);
+    srand(1);
+    printf("move,estop,runs,median_us,p99_us,max_us\n");
+    for (int isBlocking = 0; isBlocking <= 1; isBlocking++) {
+        for (int isInterrupt = 0; isInterrupt <= 1; isInterrupt++) {
+            std::vector<double> times;
+            for (uint32_t i = 0; i < n; i++) {
+                // Anywhere in the first seconds of the move, on a step or on a poll
+                double us = RunEstop(isBlocking, isInterrupt, 200 + rand() % 3000);
+                if (us < 0) {
+                    failures++;
+                    continue;
+                }
+                times.push_back(us);
+            }
+            if (times.empty()) {
+                printf("%s,%s,0,,,\n", moveNames[isBlocking], stopNames[isInterrupt]);
+                continue;
+            }
+            std::sort(times.begin(), times.end());
+            printf("%s,%s,%u,%.0f,%.0f,%.0f\n", moveNames[isBlocking], stopNames[isInterrupt],
+                   (unsigned)times.size(), times[times.size() / 2], times[(times.size() * 99) / 100], times.back());
+        }
+    }
+    DobotSerialSetTap(0);
+    return failures;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t n = 3;
+    bool isSequence = false;
+    bool isJam = false;
+    bool isEstop = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            n = strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--blend") == 0 && i + 1 < argc) {
+            gBlendRadius = strtof(argv[++i], 0);
+        } else if (strcmp(argv[i], "--no-dwell") == 0) {
+            gIsDwell = false;
+        } else if (strcmp(argv[i], "--sequence") == 0) {
+            isSequence = true;
+        } else if (strcmp(argv[i], "--lookahead") == 0 && i + 1 < argc) {
+            gLookahead = strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--jam") == 0) {
+            isJam = true;
+        } else if (strcmp(argv[i], "--alarm-period") == 0 && i + 1 < argc) {
+            Dobot_SetAlarmWatch(strtoul(argv[++i], 0, 10));
+        } else if (strcmp(argv[i], "--estop") == 0) {
+            isEstop = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-n N] [--blend MM] [--no-dwell] [--sequence] [--lookahead N]\n"
+                            "          [--jam] [--alarm-period MS] [--estop]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (n == 0) {
+        fprintf(stderr, "N must be at least 1\n");
+        return 2;
+    }
+
+    Dobot_Init();
+    Dobot_SetPTPCoordinateParams(PTP_XYZ_VELOCITY, PTP_XYZ_VELOCITY, PTP_XYZ_ACCELERATION, PTP_XYZ_ACCELERATION);
+    Dobot_SetCPParams(CP_PLAN_ACC, CP_JUNCTION_VEL, CP_ACC, 0);
+
+    if (isJam) {
+        return BenchJam();
+    }
+    int failures = 0;
+    if (isEstop) {
+        failures = BenchEstop(n);
+        if (failures > 0) {
+            fprintf(stderr, "%d runs failed\n", failures);
+        }
+        return failures > 0 ? 1 : 0;
+    }
+    if (isSequence) {
+        failures = BenchSequence(n);
+        if (failures > 0) {
+            fprintf(stderr, "%d runs failed\n", failures);
+        }
+        return failures > 0 ? 1 : 0;
+    }
+
+    printf("move,strategy,runs,median_ms,vs_movj\n");
+    for (size_t m = 0; m < sizeof(gMoves) / sizeof(gMoves[0]); m++) {
+        double movjMs = 0;
+        for (int strategy = TRANSFER_MOVJ; strategy <= TRANSFER_JUMP; strategy++) {
+            std::vector<double> times;
+            for (uint32_t i = 0; i < n; i++) {
+                double ms = RunMove(&gMoves[m], strategy);
+                if (ms < 0) {
+                    failures++;
+                    continue;
+                }
+                times.push_back(ms);
+            }
+            if (times.empty()) {
+                printf("%s,%s,0,,\n", gMoves[m].name, gStrategyNames[strategy]);
+                continue;
+            }
+            std::sort(times.begin(), times.end());
+            double median = times[times.size() / 2];
+            if (strategy == TRANSFER_MOVJ) {
+                movjMs = median;
+            }
+            printf("%s,%s,%u,%.0f,%.2f\n", gMoves[m].name, gStrategyNames[strategy], (unsigned)times.size(),
+                   median, movjMs > 0 ? median / movjMs : 0);
+        }
+    }
+    if (failures > 0) {
+        fprintf(stderr, "%d runs failed\n", failures);
+    }
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Host microbenchmark: bytes per second through the RingBuffer, old vs new.
+ *
+ * Three workloads, all on a 256 byte queue like the Serial raw byte queues:
+ *   byte    - one byte enqueued then dequeued, like Serialread / ProtocolPoll did
+ *   frame   - a 22 byte Dobot frame moved byte by byte, like PacketWrite/ReadProcess did
+ *   bulk    - the same frame moved with RingBufferEnqueueBulk / DequeueBulk (new only)
+ *
+ * The numbers are for the host CPU. On the AVR the gap is larger, since the
+ * old code does a 32 bit modulo and two 64 bit increments per byte.
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#include "../../RingBuffer.h"
+#include "legacy/LegacyRingBuffer.h"
+
+#define QUEUE_SIZE  256
+#define FRAME_SIZE  22
+#define TOTAL_BYTES (64UL * 1024 * 1024)
+
+static uint8_t gQueueBuffer[QUEUE_SIZE];
+static uint8_t gFrame[FRAME_SIZE];
+static uint8_t gOut[FRAME_SIZE];
+static volatile uint32_t gSink;
+
+typedef std::chrono::steady_clock Clock;
+
+static void Report(const char *name, Clock::time_point start)
+{
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    printf("%-14s %10.1f MB/s\n", name, TOTAL_BYTES / seconds / 1e6);
+}
+
+static void LegacyByte(void)
+{
+    LegacyRingBuffer rb;
+    LegacyRingBufferInit(&rb, gQueueBuffer, QUEUE_SIZE, 1);
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < TOTAL_BYTES; i++) {
+        uint8_t data = (uint8_t)i;
+        LegacyRingBufferEnqueue(&rb, &data);
+        LegacyRingBufferDequeue(&rb, &data);
+        gSink += data;
+    }
+    Report("legacy byte", start);
+}
+
+static void NewByte(void)
+{
+    RingBuffer rb;
+    RingBufferInit(&rb, gQueueBuffer, QUEUE_SIZE, 1);
+    Clock::time_point start = Clock::now();
+    for (uint32_t i = 0; i < TOTAL_BYTES; i++) {
+        uint8_t data = (uint8_t)i;
+        RingBufferEnqueue(&rb, &data);
+        RingBufferDequeue(&rb, &data);
+        gSink += data;
+    }
+    Report("new byte", start);
+}
+
+static void LegacyFrame(void)
+{
+    LegacyRingBuffer rb;
+    LegacyRingBufferInit(&rb, gQueueBuffer, QUEUE_SIZE, 1);
+    Clock::time_point start = Clock::now();
+    for (uint32_t n = 0; n < TOTAL_BYTES; n += FRAME_SIZE) {
+        for (uint32_t i = 0; i < FRAME_SIZE; i++) {
+            LegacyRingBufferEnqueue(&rb, &gFrame[i]);
+        }
+        for (uint32_t i = 0; i < FRAME_SIZE; i++) {
+            LegacyRingBufferDequeue(&rb, &gOut[i]);
+        }
+        gSink += gOut[FRAME_SIZE - 1];
+    }
+    Report("legacy frame", start);
+}
+
+static void NewFrame(void)
+{
+    RingBuffer rb;
+    RingBufferInit(&rb, gQueueBuffer, QUEUE_SIZE, 1);
+    Clock::time_point start = Clock::now();
+    for (uint32_t n = 0; n < TOTAL_BYTES; n += FRAME_SIZE) {
+        for (uint32_t i = 0; i < FRAME_SIZE; i++) {
+            RingBufferEnqueue(&rb, &gFrame[i]);
+        }
+        for (uint32_t i = 0; i < FRAME_SIZE; i++) {
+            RingBufferDequeue(&rb, &gOut[i]);
+        }
+        gSink += gOut[FRAME_SIZE - 1];
+    }
+    Report("new frame", start);
+}
+
+static void NewBulk(void)
+{
+    RingBuffer rb;
+    RingBufferInit(&rb, gQueueBuffer, QUEUE_SIZE, 1);
+    Clock::time_point start = Clock::now();
+    for (uint32_t n = 0; n < TOTAL_BYTES; n += FRAME_SIZE) {
+        RingBufferEnqueueBulk(&rb, gFrame, FRAME_SIZE);
+        RingBufferDequeueBulk(&rb, gOut, FRAME_SIZE);
+        gSink += gOut[FRAME_SIZE - 1];
+    }
+    Report("new bulk", start);
+}
+
+// The frames wrap around the queue end, so check the data survives it
+static bool CheckWrap(void)
+{
+    RingBuffer rb;
+    RingBufferInit(&rb, gQueueBuffer, QUEUE_SIZE, 1);
+    for (uint32_t n = 0; n < 10000; n++) {
+        for (uint32_t i = 0; i < FRAME_SIZE; i++) {
+            gFrame[i] = (uint8_t)(n + i);
+        }
+        if (RingBufferEnqueueBulk(&rb, gFrame, FRAME_SIZE) != FRAME_SIZE ||
+            RingBufferGetCount(&rb) != FRAME_SIZE ||
+            RingBufferDequeueBulk(&rb, gOut, FRAME_SIZE) != FRAME_SIZE) {
+            return false;
+        }
+        for (uint32_t i = 0; i < FRAME_SIZE; i++) {
+            if (gOut[i] != gFrame[i]) {
+                return false;
+            }
+        }
+    }
+    // One slot is kept free
+    return RingBufferEnqueueBulk(&rb, gQueueBuffer, QUEUE_SIZE) == QUEUE_SIZE - 1 && RingBufferIsFull(&rb);
+}
+
+int main(void)
+{
+    if (!CheckWrap()) {
+        printf("RingBuffer wrap check failed\n");
+        return 1;
+    }
+    printf("sizeof(RingBuffer): legacy %u, new %u bytes\n",
+           (unsigned)sizeof(LegacyRingBuffer), (unsigned)sizeof(RingBuffer));
+    LegacyByte();
+    NewByte();
+    LegacyFrame();
+    NewFrame();
+    NewBulk();
+    return 0;
+}
@@ -0,0 +1,152 @@
+/****************************************Copyright(c)*****************************************************
+**                            Shenzhen Yuejiang Technology Co., LTD.
+**
+**                                 http://www.dobot.cc
+**
+**--------------File Info---------------------------------------------------------------------------------
+** File name:           LegacyRingBuffer.h
+** Latest modified Date:
+** Latest Version:      V1.0.0
+** Descriptions:
+**
+**--------------------------------------------------------------------------------------------------------
+** Created by:          Liu Zhufu
+** Created date:        2016-06-01
+** Version:             V1.0.0
+** Descriptions:        Ring buffer before the power-of-two rewrite, kept as the benchmark baseline
+**--------------------------------------------------------------------------------------------------------
+*********************************************************************************************************/
+#ifndef LEGACY_RINGBUFFER_H
+#define LEGACY_RINGBUFFER_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+    
+#include <stdint.h>
+#include <stdbool.h>
+
+#pragma pack(push)
+#pragma pack(1)
+
+typedef struct tagLegacyRingBuffer {
+    // Static property
+    void *addr;
+    uint32_t capacity;
+    uint32_t elemSize;
+    // Dynamic property
+    volatile bool isEmpty;
+    volatile bool isFull;
+    volatile uint32_t count;
+    volatile uint32_t readAddress;
+    volatile uint32_t writeAddress;
+    volatile uint64_t readIndex;
+    volatile uint64_t writeIndex;
+}LegacyRingBuffer;
+
+#pragma pack(pop)
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferInit
+** Descriptions:        LegacyRingBuffer init
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void LegacyRingBufferInit(LegacyRingBuffer *ringBuffer, void *addr, uint32_t capacity, int32_t elemSize);
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferClear
+** Descriptions:
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void LegacyRingBufferClear(LegacyRingBuffer *ringBuffer);
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferIsEmpty
+** Descriptions:
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+inline bool LegacyRingBufferIsEmpty(LegacyRingBuffer *ringBuffer)
+{
+    return ringBuffer->isEmpty;
+}
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferIsFull
+** Descriptions:
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+inline bool LegacyRingBufferIsFull(LegacyRingBuffer *ringBuffer)
+{
+    return ringBuffer->isFull;
+}
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferGetCount
+** Descriptions:
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+inline uint32_t LegacyRingBufferGetCount(LegacyRingBuffer *ringBuffer)
+{
+    return ringBuffer->count;
+}
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferGetLeft
+** Descriptions:
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+inline uint32_t LegacyRingBufferGetLeft(LegacyRingBuffer *ringBuffer)
+{
+    return ringBuffer->capacity - ringBuffer->count;
+}
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferDataAt
+** Descriptions:
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+inline void *LegacyRingBufferDataAt(LegacyRingBuffer *ringBuffer, uint32_t index)
+{
+    uint32_t trueIndex = (ringBuffer->readAddress + index) % ringBuffer->capacity;
+
+    return (uint8_t *)ringBuffer->addr + trueIndex * ringBuffer->elemSize;
+}
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferEnqueue
+** Descriptions:        LegacyRingBuffer enqueue
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void LegacyRingBufferEnqueue(LegacyRingBuffer *ringBuffer, void *addr);
+
+/*********************************************************************************************************
+** Function name:       LegacyRingBufferDequeue
+** Descriptions:        LegacyRingBuffer dequeue
+** Input parameters:    None
+** Output parameters:   None
+** Returned value:      None
+*********************************************************************************************************/
+extern void LegacyRingBufferDequeue(LegacyRingBuffer *ringBuffer, void *addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
@@ -0,0 +1,139 @@
+/*
+ * Host shim of the Arduino core: time, Serial and fdevopen.
+ */
+#include <time.h>
+#include "Arduino.h"
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+
+static uint64_t ShimClock(void)
+{
+    static uint64_t start;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    if (start == 0) {
+        start = now;
+    }
+    return now - start;
+}
+
+unsigned long millis(void)
+{
+    return (unsigned long)(uint32_t)(ShimClock() / 1000);
+}
+
+unsigned long micros(void)
+{
+    return (unsigned long)(uint32_t)ShimClock();
+}
+
+void delay(unsigned long ms)
+{
+    struct timespec ts = {(time_t)(ms / 1000), (long)(ms % 1000) * 1000000};
+    while (nanosleep(&ts, &ts) != 0) {
+    }
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    struct timespec ts = {0, (long)us * 1000};
+    nanosleep(&ts, 0);
+}
+
+FILE *fdevopen(int (*)(char, struct __file *), int (*)(struct __file *))
+{
+    return stdout;
+}
+
+size_t Print::write(const uint8_t *data, size_t len)
+{
+    size_t n = 0;
+    while (len--) {
+        n += write(*data++);
+    }
+    return n;
+}
+
+size_t Print::write(const char *str)
+{
+    return write((const uint8_t *)str, strlen(str));
+}
+
+size_t Print::print(const char *str)
+{
+    return write(str);
+}
+
+size_t Print::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char n, int base)
+{
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(int n, int base)
+{
+    return print((long)n, base);
+}
+
+size_t Print::print(unsigned int n, int base)
+{
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(long n, int base)
+{
+    if (base == DEC && n < 0) {
+        return print('-') + print((unsigned long)-n, base);
+    }
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    char buffer[8 * sizeof(long) + 1];
+    char *str = &buffer[sizeof(buffer) - 1];
+
+    if (base < 2) {
+        base = DEC;
+    }
+    *str = '\0';
+    do {
+        unsigned long digit = n % base;
+        *--str = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        n /= base;
+    } while (n);
+    return write(str);
+}
+
+size_t Print::print(double n, int digits)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, n);
+    return write(buffer);
+}
+
+size_t Print::println(void)
+{
+    return write("\r\n");
+}
+
+void HardwareSerial::begin(unsigned long)
+{
+}
+
+void HardwareSerial::flush(void)
+{
+    fflush(stderr);
+}
+
+size_t HardwareSerial::write(uint8_t data)
+{
+    fputc(data, stderr);
+    return 1;
+}
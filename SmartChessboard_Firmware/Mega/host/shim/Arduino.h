@@ -0,0 +1,28 @@
+/*
+ * Host shim of the Arduino core, just what the Dobot protocol stack uses.
+ * millis/micros/delay follow the monotonic clock, Serial prints to stderr.
+ */
+#ifndef ARDUINO_SHIM_H
+#define ARDUINO_SHIM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// avr-libc stdio hook used by printf_begin, printf already goes to stdout here
+struct __file;
+FILE *fdevopen(int (*put)(char, struct __file *), int (*get)(struct __file *));
+
+#include "HardwareSerial.h"
+
+#endif
@@ -0,0 +1,178 @@
+/*
+ * Host port layer of DobotSerial: a tty instead of UART2.
+ *
+ * The port is DOBOT_PORT, /tmp/dobot-sim by default (the link made by host/sim/DobotSim).
+ * A reader thread stands in for the RX ISR and hands every byte to DobotSerialReceive.
+ * A writer thread stands in for the UDRE2 ISR: woken by DobotSerialPortStartTx, it takes the
+ * bytes with DobotSerialTransmit and writes each chunk once its wire time at the baud rate is
+ * over, so the TX queue drains at the pace of the Mega UART while the protocol thread goes on.
+ * DobotSerialSetTap (DobotSerialHost.h) lets a host tool see the bytes in both directions.
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "DobotSerial.h"
+#include "DobotSerialHost.h"
+
+static int gPort = -1;
+static uint32_t gByteTime;                  // ns on the wire, 10 bits per byte
+static DobotSerialTap gTap;
+static pthread_mutex_t gTxLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gTxCond = PTHREAD_COND_INITIALIZER;
+static bool gTxStarted;
+
+// Chunk sent at once, small so that the bytes do not arrive much later than on the real UART
+#define TX_CHUNK_SIZE   8
+
+static speed_t SpeedOf(uint32_t baudrate)
+{
+    switch (baudrate) {
+    case 9600:
+        return B9600;
+    case 57600:
+        return B57600;
+    case 230400:
+        return B230400;
+    default:
+        return B115200;
+    }
+}
+
+static void *DobotSerialReader(void *)
+{
+    uint8_t data[64];
+
+    while (1) {
+        ssize_t len = read(gPort, data, sizeof(data));
+        if (len < 0 && errno == EINTR) {
+            continue;
+        }
+        if (len <= 0) {
+            fprintf(stderr, "[ERROR]Dobot port closed\n");
+            return 0;
+        }
+        if (gTap) {
+            gTap(false, data, len);
+        }
+        for (ssize_t i = 0; i < len; i++) {
+            DobotSerialReceive(data[i]);
+            // The ISR runs between two instructions of the main loop, a thread needs the ordering spelled out
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+        }
+    }
+}
+
+static uint64_t NowNs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void WritePort(const uint8_t *data, uint32_t len)
+{
+    if (gTap) {
+        gTap(true, data, len);
+    }
+    while (len) {
+        ssize_t n = write(gPort, data, len);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            perror("Dobot port write");
+            return;
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+static void *DobotSerialWriter(void *)
+{
+    uint8_t data[TX_CHUNK_SIZE];
+    uint64_t lineFree = 0;
+
+    while (1) {
+        pthread_mutex_lock(&gTxLock);
+        while (gTxStarted == false) {
+            pthread_cond_wait(&gTxCond, &gTxLock);
+        }
+        gTxStarted = false;
+        pthread_mutex_unlock(&gTxLock);
+
+        // Drain until empty, as the ISR does before it disables itself
+        while (1) {
+            uint32_t len;
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            for (len = 0; len < sizeof(data) && DobotSerialTransmit(&data[len]); len++) {
+            }
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            if (len == 0) {
+                break;
+            }
+            // The chunk leaves when its last byte would be shifted out, and the writer sleeps
+            // meanwhile: on one core the protocol thread keeps the CPU, as the main loop on the Mega
+            uint64_t now = NowNs();
+            lineFree = (lineFree > now ? lineFree : now) + (uint64_t)len * gByteTime;
+            struct timespec end = {(time_t)(lineFree / 1000000000ULL), (long)(lineFree % 1000000000ULL)};
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &end, 0) == EINTR) {
+            }
+            WritePort(data, len);
+        }
+    }
+}
+
+void DobotSerialPortStartTx(void)
+{
+    pthread_mutex_lock(&gTxLock);
+    gTxStarted = true;
+    pthread_cond_signal(&gTxCond);
+    pthread_mutex_unlock(&gTxLock);
+}
+
+void DobotSerialPortOpen(uint32_t baudrate)
+{
+    const char *path = getenv("DOBOT_PORT");
+    pthread_t reader, writer;
+    struct termios tio;
+
+    if (gPort >= 0) {
+        return;
+    }
+    if (path == 0) {
+        path = "/tmp/dobot-sim";
+    }
+    gPort = open(path, O_RDWR | O_NOCTTY);
+    if (gPort < 0) {
+        perror(path);
+        exit(1);
+    }
+    if (tcgetattr(gPort, &tio) == 0) {
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, SpeedOf(baudrate));
+        cfsetospeed(&tio, SpeedOf(baudrate));
+        tio.c_cc[VMIN] = 1;
+        tio.c_cc[VTIME] = 0;
+        tcsetattr(gPort, TCSANOW, &tio);
+    }
+    gByteTime = 10 * 1000000000ULL / baudrate;
+    pthread_create(&reader, 0, DobotSerialReader, 0);
+    pthread_detach(reader);
+    pthread_create(&writer, 0, DobotSerialWriter, 0);
+    // An ISR preempts the main loop, the thread does so too where it is allowed to
+    struct sched_param param = {1};
+    pthread_setschedparam(writer, SCHED_FIFO, &param);
+    pthread_detach(writer);
+}
+
+void DobotSerialSetTap(DobotSerialTap tap)
+{
+    gTap = tap;
+}
@@ -0,0 +1,18 @@
+/*
+ * Host only additions to DobotSerial, for the tools that watch the link.
+ */
+#ifndef DOBOTSERIALHOST_H
+#define DOBOTSERIALHOST_H
+
+#include <stdint.h>
+
+/*
+ * Called with every chunk written to the port (isTx) and read from it.
+ * The reads come from the reader thread and the writes from the writer thread, not from the
+ * thread that runs the protocol.
+ */
+typedef void (*DobotSerialTap)(bool isTx, const uint8_t *data, uint32_t len);
+
+extern void DobotSerialSetTap(DobotSerialTap tap);
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * Host shim of Print, Stream and HardwareSerial, the output goes to stderr so stdout stays free
+ * for the host programs. Nothing is ever received on Serial and Serial1.
+ */
+#ifndef HARDWARESERIAL_SHIM_H
+#define HARDWARESERIAL_SHIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t data) = 0;
+    virtual int availableForWrite(void) { return 0; }
+    size_t write(const uint8_t *data, size_t len);
+    size_t write(const char *str);
+
+    size_t print(const char *str);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(void);
+    template <typename T>
+    size_t println(T value)
+    {
+        size_t n = print(value);
+        return n + println();
+    }
+    template <typename T>
+    size_t println(T value, int format)
+    {
+        size_t n = print(value, format);
+        return n + println();
+    }
+};
+
+class Stream : public Print {
+public:
+    virtual int available(void) = 0;
+    virtual int peek(void) = 0;
+    virtual int read(void) = 0;
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long baud);
+    void end(void) {}
+    int available(void) { return 0; }
+    int peek(void) { return -1; }
+    int read(void) { return -1; }
+    int availableForWrite(void) { return 64; }
+    void flush(void);
+    size_t write(uint8_t data);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
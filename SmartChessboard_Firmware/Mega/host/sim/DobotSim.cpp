@@ -0,0 +1,1090 @@
+/*
+ * Host simulator of a Dobot Magician on a pseudo-terminal.
+ *
+ * Frames are decoded with the Packet layout of ProtocolDef.h and answered the way the
+ * controller does: the echo carries the same id and ctrl, a get returns its data, a set
+ * returns no params and a queued command returns its 64 bit queue index.
+ *
+ * Queued commands run one after the other on a timing model of the arm:
+ *   PTP   - trapezoidal profiles with the PTP joint/coordinate/jump/common params,
+ *           MOVJ on the joints (simple Magician kinematics), MOVL on the tool point,
+ *           JUMP as lift + move + drop
+ *   CP    - segments blended at the junction velocity when the next CP is already queued
+ *   ARC   - chord length at the ARC params
+ *   WAIT  - its timeout
+ *   HOME  - a fixed time (--home-ms)
+ *   IO    - gripper, suction cup, DO and params writes take no time
+ * A target out of reach raises an alarm and the command is skipped.
+ *
+ * The replies are paced at the baud rate. Faults can be injected on the link:
+ *   --drop P        each byte in either direction is lost with probability P
+ *   --corrupt P     a reply is sent with a wrong checksum with probability P
+ *   --late P        a reply is held for --late-ms ms with probability P, the next ones queue behind it
+ * and on the arm:
+ *   --jam-at N      the first motion at or after queue index N raises a lose-step alarm and never
+ *                   ends, as a jammed joint, until the queue is stopped. The time from the jam to
+ *                   the stop is printed.
+ *
+ * Usage: DobotSim [--link /tmp/dobot-sim] [--baud 115200] [--reply-ms 0] [--home-ms 10000]
+ *                 [--drop P] [--corrupt P] [--late P] [--late-ms 200] [--seed N] [--jam-at N] [-v]
+ */
+#define _XOPEN_SOURCE 600
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ProtocolDef.h"
+#include "ProtocolID.h"
+#include "type.h"
+
+#define QUEUE_SIZE      64
+#define OUTBOX_SIZE     32
+#define ALARMS_SIZE     16
+
+// Magician arm lengths in mm
+#define ARM_REAR        135.0f
+#define ARM_FORE        147.0f
+
+// Alarm codes, one bit each in the AlarmsState bytes
+#define ALARM_INV_LIMIT 0x12
+#define ALARM_LOSE_STEP 0x50
+
+typedef struct tagSimOptions {
+    const char *link;
+    uint32_t baud;
+    uint32_t replyMs;
+    uint32_t homeMs;
+    double dropRate;
+    double corruptRate;
+    double lateRate;
+    uint32_t lateMs;
+    uint32_t seed;
+    uint64_t jamAt;
+    bool isVerbose;
+}SimOptions;
+
+typedef struct tagSimStats {
+    uint32_t rxFrames;
+    uint32_t rxBadChecksum;
+    uint32_t txFrames;
+    uint32_t droppedBytes;
+    uint32_t corruptFrames;
+    uint32_t lateFrames;
+    uint32_t queuedCmds;
+    uint32_t alarms;
+    uint32_t jamStopMs;
+}SimStats;
+
+// Last params set for each id, returned by the get of the same id
+typedef struct tagSimParams {
+    uint8_t len;
+    uint8_t data[MAX_PAYLOAD_SIZE - 2];
+}SimParams;
+
+typedef struct tagQueuedCmd {
+    uint64_t index;
+    uint8_t id;
+    uint8_t paramsLen;
+    uint8_t params[MAX_PAYLOAD_SIZE - 2];
+}QueuedCmd;
+
+typedef struct tagSimFrame {
+    uint64_t due;
+    uint8_t len;
+    uint8_t data[sizeof(Packet)];
+}SimFrame;
+
+typedef struct tagSimPoint {
+    float x;
+    float y;
+    float z;
+    float r;
+}SimPoint;
+
+static SimOptions gOptions = {"/tmp/dobot-sim", 115200, 0, 10000, 0, 0, 0, 200, 1, 0, false};
+static SimStats gStats;
+static SimParams gParams[ProtocolMax];
+static volatile sig_atomic_t gIsQuit;
+static uint64_t gStartTime;
+
+// Link
+static int gMaster = -1;
+static Packet gRxPacket;
+static PacketParseState gRxState = PacketParseSyncByte1;
+static uint8_t gRxCount;
+static SimFrame gOutbox[OUTBOX_SIZE];
+static uint8_t gOutboxHead, gOutboxCount;
+static uint64_t gTxFree;
+
+// Arm
+static Pose gPose;
+static uint8_t gAlarms[ALARMS_SIZE];
+static uint8_t gIOFunction[32];
+static uint8_t gIODO[32];
+static bool gIsGripperEnabled, gIsGripped, gIsSucked;
+
+// Queue, gQueueHead is the running command while gIsActive
+static QueuedCmd gQueue[QUEUE_SIZE];
+static uint8_t gQueueHead, gQueueCount;
+static uint64_t gWriteIndex, gCurrentIndex;
+static bool gIsRunning = true;
+static bool gIsStopping;
+static bool gIsActive;
+static bool gIsJammed;
+static uint64_t gJamStart;
+static uint64_t gActiveStart, gActiveEnd;
+static Pose gActiveFrom, gActiveTo;
+static uint8_t gLastMotionId;
+static uint64_t gLastMotionEnd;
+static float gLastCPExit;
+
+static uint64_t Now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static bool Chance(double rate)
+{
+    return rate > 0 && rand() < rate * ((double)RAND_MAX + 1);
+}
+
+static void OnSignal(int)
+{
+    gIsQuit = 1;
+}
+
+/*
+ * Params
+ */
+template <typename T>
+static T *ParamsOf(uint8_t id)
+{
+    return (T *)gParams[id].data;
+}
+
+template <typename T>
+static void ParamsDefault(uint8_t id, const T &value)
+{
+    gParams[id].len = sizeof(T);
+    memcpy(gParams[id].data, &value, sizeof(T));
+}
+
+static void ParamsInit(void)
+{
+    PTPJointParams joint;
+    for (int i = 0; i < ROBOT_AXIS; i++) {
+        joint.velocity[i] = 200;
+        joint.acceleration[i] = 200;
+    }
+    ParamsDefault(ProtocolPTPJointParams, joint);
+    PTPCoordinateParams coordinate = {200, 200, 200, 200};
+    ParamsDefault(ProtocolPTPCoordinateParams, coordinate);
+    PTPJumpParams jump = {20, 200};
+    ParamsDefault(ProtocolPTPJumpParams, jump);
+    PTPCommonParams common = {100, 100};
+    ParamsDefault(ProtocolPTPCommonParams, common);
+    CPParams cp;
+    memset(&cp, 0, sizeof(cp));
+    cp.planAcc = 200;
+    cp.juncitionVel = 50;
+    cp.acc = 200;
+    ParamsDefault(ProtocolCPParams, cp);
+    ARCParams arc = {100, 100, 100, 100};
+    ParamsDefault(ProtocolARCParams, arc);
+    EndEffectorParams endEffector = {59.7f, 0, 0};
+    ParamsDefault(ProtocolEndEffectorParams, endEffector);
+    Pose homePose;
+    memset(&homePose, 0, sizeof(homePose));
+    homePose.x = 200;
+    homePose.z = 50;
+    ParamsDefault(ProtocolHOMEParams, homePose);
+}
+
+/*
+ * Kinematics, only as close to the Magician as the timing needs
+ */
+static bool Inverse(const SimPoint &p, float *joint)
+{
+    const EndEffectorParams *endEffector = ParamsOf<EndEffectorParams>(ProtocolEndEffectorParams);
+    float radius = sqrtf(p.x * p.x + p.y * p.y) - endEffector->xBias;
+    float height = p.z + endEffector->zBias;
+    float dist = sqrtf(radius * radius + height * height);
+
+    if (dist > ARM_REAR + ARM_FORE || dist < fabsf(ARM_REAR - ARM_FORE) || dist == 0) {
+        return false;
+    }
+    float rear = atan2f(height, radius) +
+                 acosf((ARM_REAR * ARM_REAR + dist * dist - ARM_FORE * ARM_FORE) / (2 * ARM_REAR * dist));
+    float fore = atan2f(height - ARM_REAR * sinf(rear), radius - ARM_REAR * cosf(rear));
+
+    joint[0] = atan2f(p.y, p.x) * 180 / (float)M_PI;
+    joint[1] = 90 - rear * 180 / (float)M_PI;
+    joint[2] = -fore * 180 / (float)M_PI;
+    joint[3] = p.r - joint[0];
+    return joint[0] >= -135 && joint[0] <= 135 && joint[1] >= -5 && joint[1] <= 90 &&
+           joint[2] >= -15 && joint[2] <= 95;
+}
+
+static SimPoint Forward(const float *joint)
+{
+    const EndEffectorParams *endEffector = ParamsOf<EndEffectorParams>(ProtocolEndEffectorParams);
+    float j1 = joint[0] * (float)M_PI / 180;
+    float j2 = joint[1] * (float)M_PI / 180;
+    float j3 = joint[2] * (float)M_PI / 180;
+    float radius = ARM_REAR * sinf(j2) + ARM_FORE * cosf(j3) + endEffector->xBias;
+    SimPoint p;
+
+    p.x = radius * cosf(j1);
+    p.y = radius * sinf(j1);
+    p.z = ARM_REAR * cosf(j2) - ARM_FORE * sinf(j3) - endEffector->zBias;
+    p.r = joint[0] + joint[3];
+    return p;
+}
+
+static SimPoint PointOf(const Pose &pose)
+{
+    SimPoint p = {pose.x, pose.y, pose.z, pose.rHead};
+    return p;
+}
+
+static bool PoseOf(const SimPoint &p, Pose *pose)
+{
+    pose->x = p.x;
+    pose->y = p.y;
+    pose->z = p.z;
+    pose->rHead = p.r;
+    return Inverse(p, pose->jointAngle);
+}
+
+static float Distance(const SimPoint &a, const SimPoint &b)
+{
+    return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+}
+
+/*
+ * Time in s to travel dist with a trapezoidal profile starting and ending at rest
+ */
+static float Trapezoid(float dist, float velocity, float acceleration)
+{
+    if (dist <= 0 || velocity <= 0 || acceleration <= 0) {
+        return 0;
+    }
+    if (dist >= velocity * velocity / acceleration) {
+        return dist / velocity + velocity / acceleration;
+    }
+    return 2 * sqrtf(dist / acceleration);
+}
+
+static float MoveJTime(const Pose &from, const Pose &to)
+{
+    const PTPJointParams *joint = ParamsOf<PTPJointParams>(ProtocolPTPJointParams);
+    const PTPCommonParams *common = ParamsOf<PTPCommonParams>(ProtocolPTPCommonParams);
+    float time = 0;
+
+    for (int i = 0; i < ROBOT_AXIS; i++) {
+        float t = Trapezoid(fabsf(to.jointAngle[i] - from.jointAngle[i]),
+                            joint->velocity[i] * common->velocityRatio / 100,
+                            joint->acceleration[i] * common->accelerationRatio / 100);
+        if (t > time) {
+            time = t;
+        }
+    }
+    return time;
+}
+
+static float MoveLTime(const SimPoint &from, const SimPoint &to)
+{
+    const PTPCoordinateParams *coordinate = ParamsOf<PTPCoordinateParams>(ProtocolPTPCoordinateParams);
+    const PTPCommonParams *common = ParamsOf<PTPCommonParams>(ProtocolPTPCommonParams);
+    float xyz = Trapezoid(Distance(from, to),
+                          coordinate->xyzVelocity * common->velocityRatio / 100,
+                          coordinate->xyzAcceleration * common->accelerationRatio / 100);
+    float r = Trapezoid(fabsf(to.r - from.r),
+                        coordinate->rVelocity * common->velocityRatio / 100,
+                        coordinate->rAcceleration * common->accelerationRatio / 100);
+    return xyz > r ? xyz : r;
+}
+
+static void SetAlarm(uint8_t code)
+{
+    gAlarms[code / 8] |= 1 << (code % 8);
+    gStats.alarms++;
+    if (gOptions.isVerbose) {
+        fprintf(stderr, "[SIM] alarm 0x%02x\n", code);
+    }
+}
+
+/*
+ * PTP: target pose and duration, false if the target is out of reach
+ */
+static bool PlanPTP(const PTPCmd *cmd, Pose *to, float *time)
+{
+    SimPoint from = PointOf(gPose);
+    SimPoint target = {cmd->x, cmd->y, cmd->z, cmd->rHead};
+    bool isJump = false, isLinear = false;
+
+    switch (cmd->ptpMode) {
+    case JUMP_XYZ:
+        isJump = true;
+        break;
+    case MOVL_XYZ:
+        isLinear = true;
+        break;
+    case JUMP_ANGLE:
+    case MOVJ_ANGLE:
+    case MOVL_ANGLE: {
+        float joint[ROBOT_AXIS] = {cmd->x, cmd->y, cmd->z, cmd->rHead};
+        target = Forward(joint);
+        isJump = cmd->ptpMode == JUMP_ANGLE;
+        isLinear = cmd->ptpMode == MOVL_ANGLE;
+        break;
+    }
+    case MOVJ_INC: {
+        float joint[ROBOT_AXIS];
+        for (int i = 0; i < ROBOT_AXIS; i++) {
+            joint[i] = gPose.jointAngle[i];
+        }
+        joint[0] += cmd->x;
+        joint[1] += cmd->y;
+        joint[2] += cmd->z;
+        joint[3] += cmd->rHead;
+        target = Forward(joint);
+        break;
+    }
+    case MOVL_INC:
+    case MOVJ_XYZ_INC:
+        target.x += from.x;
+        target.y += from.y;
+        target.z += from.z;
+        target.r += from.r;
+        isLinear = cmd->ptpMode == MOVL_INC;
+        break;
+    case JUMP_MOVL_XYZ:
+        isJump = true;
+        isLinear = true;
+        break;
+    default:
+        break;
+    }
+    if (PoseOf(target, to) == false) {
+        SetAlarm(ALARM_INV_LIMIT);
+        return false;
+    }
+    if (isJump) {
+        const PTPJumpParams *jump = ParamsOf<PTPJumpParams>(ProtocolPTPJumpParams);
+        float top = (from.z > target.z ? from.z : target.z) + jump->jumpHeight;
+        if (jump->zLimit > 0 && top > jump->zLimit) {
+            top = from.z > target.z ? from.z : target.z;
+            if (jump->zLimit > top) {
+                top = jump->zLimit;
+            }
+        }
+        SimPoint up = from, over = target;
+        Pose upPose, overPose;
+        up.z = top;
+        over.z = top;
+        if (PoseOf(up, &upPose) == false || PoseOf(over, &overPose) == false) {
+            SetAlarm(ALARM_INV_LIMIT);
+            return false;
+        }
+        *time = MoveLTime(from, up) + MoveLTime(over, target) +
+                (isLinear ? MoveLTime(up, over) : MoveJTime(upPose, overPose));
+    } else {
+        *time = isLinear ? MoveLTime(from, target) : MoveJTime(gPose, *to);
+    }
+    return true;
+}
+
+/*
+ * CP: the segment is blended with its neighbours when they are CP too
+ */
+static const QueuedCmd *QueueNext(void)
+{
+    return gQueueCount > 1 ? &gQueue[(gQueueHead + 1) % QUEUE_SIZE] : 0;
+}
+
+static SimPoint CPTarget(const CPCmd *cmd, const SimPoint &from)
+{
+    SimPoint target = {cmd->x, cmd->y, cmd->z, from.r};
+    if (cmd->cpMode == CPRelativeMode) {
+        target.x += from.x;
+        target.y += from.y;
+        target.z += from.z;
+    }
+    return target;
+}
+
+static SimPoint Direction(const SimPoint &from, const SimPoint &to)
+{
+    float dist = Distance(from, to);
+    SimPoint dir = {0, 0, 0, 0};
+    if (dist > 0) {
+        dir.x = (to.x - from.x) / dist;
+        dir.y = (to.y - from.y) / dist;
+        dir.z = (to.z - from.z) / dist;
+    }
+    return dir;
+}
+
+static float JunctionVelocity(const SimPoint &a, const SimPoint &b, float velocity)
+{
+    const CPParams *cp = ParamsOf<CPParams>(ProtocolCPParams);
+    float cosine = a.x * b.x + a.y * b.y + a.z * b.z;
+    if (cosine > 0.99f) {
+        return velocity;
+    }
+    return cp->juncitionVel < velocity ? cp->juncitionVel : velocity;
+}
+
+// Time lost ramping between entry velocity and cruise velocity, on top of dist / velocity
+static float RampTime(float velocity, float entry, float acceleration)
+{
+    return (velocity - entry) * (velocity - entry) / (2 * acceleration * velocity);
+}
+
+static bool PlanCP(const CPCmd *cmd, bool isBlended, Pose *to, float *time)
+{
+    const CPParams *cp = ParamsOf<CPParams>(ProtocolCPParams);
+    SimPoint from = PointOf(gPose);
+    SimPoint target = CPTarget(cmd, from);
+    SimPoint dir = Direction(from, target);
+    float velocity = cmd->velocity > 0 ? cmd->velocity : 100;
+    float acceleration = cp->planAcc > 0 ? cp->planAcc : 100;
+    float dist = Distance(from, target);
+
+    if (PoseOf(target, to) == false) {
+        SetAlarm(ALARM_INV_LIMIT);
+        return false;
+    }
+    // Entry at the exit velocity the previous segment was planned with
+    float entry = isBlended ? (gLastCPExit < velocity ? gLastCPExit : velocity) : 0;
+    float exit = 0;
+    const QueuedCmd *next = QueueNext();
+    if (next && next->id == ProtocolCPCmd) {
+        CPCmd nextCmd;
+        memcpy(&nextCmd, next->params, sizeof(nextCmd) < next->paramsLen ? sizeof(nextCmd) : next->paramsLen);
+        exit = JunctionVelocity(dir, Direction(target, CPTarget(&nextCmd, target)), velocity);
+    }
+    *time = dist > 0 ? dist / velocity + RampTime(velocity, entry, acceleration) + RampTime(velocity, exit, acceleration) : 0;
+    gLastCPExit = exit;
+    return true;
+}
+
+static bool PlanARC(const ARCCmd *cmd, Pose *to, float *time)
+{
+    const ARCParams *arc = ParamsOf<ARCParams>(ProtocolARCParams);
+    SimPoint from = PointOf(gPose);
+    SimPoint cir = {cmd->cirPoint.x, cmd->cirPoint.y, cmd->cirPoint.z, cmd->cirPoint.rHead};
+    SimPoint target = {cmd->toPoint.x, cmd->toPoint.y, cmd->toPoint.z, cmd->toPoint.rHead};
+
+    if (PoseOf(target, to) == false) {
+        SetAlarm(ALARM_INV_LIMIT);
+        return false;
+    }
+    *time = Trapezoid(Distance(from, cir) + Distance(cir, target), arc->xyzVelocity, arc->xyzAcceleration);
+    return true;
+}
+
+/*
+ * Queue
+ */
+static void QueueApplyIO(const QueuedCmd *cmd)
+{
+    switch (cmd->id) {
+    case ProtocolEndEffectorGripper:
+        gIsGripperEnabled = cmd->params[0];
+        gIsGripped = cmd->params[1];
+        break;
+    case ProtocolEndEffectorSuctionCup:
+        gIsSucked = cmd->params[1];
+        break;
+    case ProtocolIODO:
+        gIODO[cmd->params[0] % 32] = cmd->params[1];
+        break;
+    default:
+        // A queued params write, e.g. the jump params between two hops, applies when it is reached
+        if (gParams[cmd->id].len > 0 && cmd->paramsLen == gParams[cmd->id].len) {
+            memcpy(gParams[cmd->id].data, cmd->params, cmd->paramsLen);
+        }
+        break;
+    }
+}
+
+// Start the command at the head of the queue at time start
+static void QueueStart(uint64_t start)
+{
+    const QueuedCmd *cmd = &gQueue[gQueueHead];
+    float time = 0;
+
+    gActiveFrom = gPose;
+    gActiveTo = gPose;
+    switch (cmd->id) {
+    case ProtocolPTPCmd:
+    case ProtocolPTPWithLCmd: {
+        // PTPWithLCmd starts with the PTPCmd fields, the rail is not modelled
+        PTPCmd ptpCmd;
+        memcpy(&ptpCmd, cmd->params, sizeof(ptpCmd));
+        if (PlanPTP(&ptpCmd, &gActiveTo, &time) == false) {
+            gActiveTo = gPose;
+        }
+        break;
+    }
+    case ProtocolCPCmd: {
+        CPCmd cpCmd;
+        memset(&cpCmd, 0, sizeof(cpCmd));
+        memcpy(&cpCmd, cmd->params, cmd->paramsLen < sizeof(cpCmd) ? cmd->paramsLen : sizeof(cpCmd));
+        bool isBlended = gLastMotionId == ProtocolCPCmd && gLastMotionEnd == start && gLastCPExit > 0;
+        if (PlanCP(&cpCmd, isBlended, &gActiveTo, &time) == false) {
+            gActiveTo = gPose;
+        }
+        break;
+    }
+    case ProtocolARCCmd: {
+        ARCCmd arcCmd;
+        memcpy(&arcCmd, cmd->params, sizeof(arcCmd));
+        if (PlanARC(&arcCmd, &gActiveTo, &time) == false) {
+            gActiveTo = gPose;
+        }
+        break;
+    }
+    case ProtocolWAITCmd: {
+        uint32_t timeout;
+        memcpy(&timeout, cmd->params, sizeof(timeout));
+        time = timeout / 1000.0f;
+        break;
+    }
+    case ProtocolHOMECmd: {
+        const Pose *home = ParamsOf<Pose>(ProtocolHOMEParams);
+        SimPoint target = PointOf(*home);
+        PoseOf(target, &gActiveTo);
+        time = gOptions.homeMs / 1000.0f;
+        break;
+    }
+    default:
+        QueueApplyIO(cmd);
+        break;
+    }
+    gActiveStart = start;
+    gActiveEnd = start + (uint64_t)(time * 1e6f);
+    gIsActive = true;
+    bool isMotion = cmd->id == ProtocolPTPCmd || cmd->id == ProtocolPTPWithLCmd || cmd->id == ProtocolCPCmd ||
+                    cmd->id == ProtocolARCCmd;
+    if (gOptions.jamAt && cmd->index >= gOptions.jamAt && isMotion) {
+        // Only once: the arm stays where it is and the command never ends
+        gOptions.jamAt = 0;
+        SetAlarm(ALARM_LOSE_STEP);
+        gActiveTo = gPose;
+        gActiveEnd = UINT64_MAX;
+        gIsJammed = true;
+        gJamStart = start;
+        fprintf(stderr, "[SIM] jam at #%llu\n", (unsigned long long)cmd->index);
+    }
+    if (gOptions.isVerbose) {
+        fprintf(stderr, "[SIM] run #%llu id %u for %.1f ms\n", (unsigned long long)cmd->index, cmd->id, time * 1e3f);
+    }
+}
+
+static void QueueFinish(void)
+{
+    const QueuedCmd *cmd = &gQueue[gQueueHead];
+
+    gPose = gActiveTo;
+    gCurrentIndex = cmd->index;
+    if (cmd->id == ProtocolPTPCmd || cmd->id == ProtocolPTPWithLCmd || cmd->id == ProtocolCPCmd || cmd->id == ProtocolARCCmd ||
+        cmd->id == ProtocolHOMECmd) {
+        gLastMotionId = cmd->id;
+        gLastMotionEnd = gActiveEnd;
+    }
+    gQueueHead = (gQueueHead + 1) % QUEUE_SIZE;
+    gQueueCount--;
+    gIsActive = false;
+}
+
+// Run the queue up to now, each command starts when the previous one ends
+static void QueueAdvance(uint64_t now)
+{
+    uint64_t start = now;
+
+    while (1) {
+        if (gIsActive) {
+            if (gActiveEnd > now) {
+                return;
+            }
+            start = gActiveEnd;
+            QueueFinish();
+            if (gIsStopping) {
+                gIsStopping = false;
+                gIsRunning = false;
+            }
+        }
+        if (gIsRunning == false || gQueueCount == 0) {
+            return;
+        }
+        QueueStart(start);
+    }
+}
+
+// Pose of the arm now, between the two ends of the running motion
+static Pose CurrentPose(uint64_t now)
+{
+    if (gIsActive == false || gActiveEnd <= gActiveStart) {
+        return gPose;
+    }
+    float k = (float)(now - gActiveStart) / (float)(gActiveEnd - gActiveStart);
+    Pose pose;
+    float *out = &pose.x;
+    const float *from = &gActiveFrom.x, *to = &gActiveTo.x;
+    for (size_t i = 0; i < sizeof(Pose) / sizeof(float); i++) {
+        out[i] = from[i] + (to[i] - from[i]) * k;
+    }
+    return pose;
+}
+
+static void QueueForceStop(uint64_t now)
+{
+    if (gIsActive) {
+        // The arm stops where it is, the command is not done
+        gPose = CurrentPose(now);
+        gIsActive = false;
+    }
+    gIsRunning = false;
+    gIsStopping = false;
+    if (gIsJammed) {
+        gIsJammed = false;
+        gStats.jamStopMs = (uint32_t)((now - gJamStart) / 1000);
+        fprintf(stderr, "[SIM] jam stopped after %u ms\n", gStats.jamStopMs);
+    }
+}
+
+/*
+ * Link
+ */
+static void SendFrame(uint8_t id, uint8_t ctrl, const void *params, uint8_t paramsLen)
+{
+    if (gOutboxCount == OUTBOX_SIZE) {
+        return;
+    }
+    SimFrame *frame = &gOutbox[(gOutboxHead + gOutboxCount++) % OUTBOX_SIZE];
+    Packet *packet = (Packet *)frame->data;
+    uint8_t checksum = 0;
+
+    packet->header.syncBytes[0] = SYNC_BYTE;
+    packet->header.syncBytes[1] = SYNC_BYTE;
+    packet->header.payloadLen = paramsLen + 2;
+    packet->payload.id = id;
+    packet->payload.ctrl = ctrl;
+    memcpy(packet->payload.params, params, paramsLen);
+    for (uint8_t i = 0; i < packet->header.payloadLen; i++) {
+        checksum += ((uint8_t *)&packet->payload)[i];
+    }
+    checksum = 0 - checksum;
+    if (Chance(gOptions.corruptRate)) {
+        checksum ^= 0x5A;
+        gStats.corruptFrames++;
+    }
+    frame->len = sizeof(PacketHeader) + packet->header.payloadLen + 1;
+    frame->data[frame->len - 1] = checksum;
+
+    // Replies leave in order, a late one holds the next ones
+    uint64_t due = Now() + gOptions.replyMs * 1000;
+    if (Chance(gOptions.lateRate)) {
+        due += gOptions.lateMs * 1000;
+        gStats.lateFrames++;
+    }
+    if (due < gTxFree) {
+        due = gTxFree;
+    }
+    // The frame is handed over once its last byte would be on the wire
+    frame->due = due + (uint64_t)frame->len * 10 * 1000000 / gOptions.baud;
+    gTxFree = frame->due;
+    gStats.txFrames++;
+}
+
+static void FlushOutbox(uint64_t now)
+{
+    while (gOutboxCount && gOutbox[gOutboxHead].due <= now) {
+        SimFrame *frame = &gOutbox[gOutboxHead];
+        uint8_t data[sizeof(Packet)];
+        uint8_t len = 0;
+
+        for (uint8_t i = 0; i < frame->len; i++) {
+            if (Chance(gOptions.dropRate)) {
+                gStats.droppedBytes++;
+                continue;
+            }
+            data[len++] = frame->data[i];
+        }
+        if (len && write(gMaster, data, len) < 0 && errno != EAGAIN) {
+            perror("write");
+        }
+        gOutboxHead = (gOutboxHead + 1) % OUTBOX_SIZE;
+        gOutboxCount--;
+    }
+}
+
+static void ReplyQueued(const Packet *packet)
+{
+    uint8_t paramsLen = packet->header.payloadLen - 2;
+
+    if (gQueueCount == QUEUE_SIZE) {
+        // No room, the controller drops the command without an echo
+        return;
+    }
+    QueuedCmd *cmd = &gQueue[(gQueueHead + gQueueCount++) % QUEUE_SIZE];
+    cmd->index = ++gWriteIndex;
+    cmd->id = packet->payload.id;
+    cmd->paramsLen = paramsLen;
+    memcpy(cmd->params, packet->payload.params, paramsLen);
+    gStats.queuedCmds++;
+    SendFrame(packet->payload.id, packet->payload.ctrl, &cmd->index, sizeof(cmd->index));
+}
+
+static void HandlePacket(const Packet *packet)
+{
+    uint8_t id = packet->payload.id;
+    uint8_t ctrl = packet->payload.ctrl;
+    bool isWrite = ctrl & 0x01;
+    bool isQueued = ctrl & 0x02;
+    uint8_t paramsLen = packet->header.payloadLen - 2;
+    const uint8_t *params = packet->payload.params;
+    uint64_t now = Now();
+
+    gStats.rxFrames++;
+    if (gOptions.isVerbose) {
+        fprintf(stderr, "[SIM] rx id %u ctrl 0x%02x len %u\n", id, ctrl, paramsLen);
+    }
+    QueueAdvance(now);
+    if (isWrite && isQueued) {
+        ReplyQueued(packet);
+        return;
+    }
+    switch (id) {
+    case ProtocolDeviceID: {
+        uint32_t deviceId[3] = {0x53494D00, 0, 1};
+        SendFrame(id, ctrl, deviceId, sizeof(deviceId));
+        return;
+    }
+    case ProtocolDeviceName: {
+        static const char name[] = "DobotSim";
+        SendFrame(id, ctrl, name, sizeof(name));
+        return;
+    }
+    case ProtocolDeviceVersion: {
+        uint8_t version[3] = {3, 7, 0};
+        SendFrame(id, ctrl, version, sizeof(version));
+        return;
+    }
+    case ProtocolDeviceTime: {
+        uint32_t deviceTime = (uint32_t)((now - gStartTime) / 1000);
+        SendFrame(id, ctrl, &deviceTime, sizeof(deviceTime));
+        return;
+    }
+    case ProtocolGetPose: {
+        Pose pose = CurrentPose(now);
+        SendFrame(id, ctrl, &pose, sizeof(pose));
+        return;
+    }
+    case ProtocolGetPoseL: {
+        float poseL = 0;
+        SendFrame(id, ctrl, &poseL, sizeof(poseL));
+        return;
+    }
+    case ProtocolAlarmsState:
+        if (isWrite) {
+            memset(gAlarms, 0, sizeof(gAlarms));
+            SendFrame(id, ctrl, 0, 0);
+        } else {
+            SendFrame(id, ctrl, gAlarms, sizeof(gAlarms));
+        }
+        return;
+    case ProtocolEndEffectorGripper:
+        if (isWrite) {
+            gIsGripperEnabled = params[0];
+            gIsGripped = params[1];
+            SendFrame(id, ctrl, 0, 0);
+        } else {
+            uint8_t state[2] = {gIsGripperEnabled, gIsGripped};
+            SendFrame(id, ctrl, state, sizeof(state));
+        }
+        return;
+    case ProtocolEndEffectorSuctionCup:
+        if (isWrite) {
+            gIsSucked = paramsLen > 1 ? params[1] : params[0];
+            SendFrame(id, ctrl, 0, 0);
+        } else {
+            uint8_t state[2] = {1, gIsSucked};
+            SendFrame(id, ctrl, state, sizeof(state));
+        }
+        return;
+    case ProtocolIOMultiplexing:
+        if (isWrite) {
+            gIOFunction[params[0] % 32] = params[1];
+            SendFrame(id, ctrl, 0, 0);
+        } else {
+            uint8_t config[2] = {params[0], gIOFunction[params[0] % 32]};
+            SendFrame(id, ctrl, config, sizeof(config));
+        }
+        return;
+    case ProtocolIODO:
+        if (isWrite) {
+            gIODO[params[0] % 32] = params[1];
+            SendFrame(id, ctrl, 0, 0);
+        } else {
+            uint8_t value[2] = {params[0], gIODO[params[0] % 32]};
+            SendFrame(id, ctrl, value, sizeof(value));
+        }
+        return;
+    case ProtocolIODI: {
+        // Nothing is wired, the inputs read low
+        uint8_t value[2] = {params[0], 0};
+        SendFrame(id, ctrl, value, sizeof(value));
+        return;
+    }
+    case ProtocolIOADC: {
+        uint8_t value[3] = {params[0], 0, 0};
+        SendFrame(id, ctrl, value, sizeof(value));
+        return;
+    }
+    case ProtocolColorSensor:
+    case ProtocolIRSwitch:
+        if (isWrite) {
+            SendFrame(id, ctrl, 0, 0);
+        } else {
+            uint8_t value[3] = {0, 0, 0};
+            SendFrame(id, ctrl, value, id == ProtocolColorSensor ? 3 : 1);
+        }
+        return;
+    case ProtocolQueuedCmdStartExec:
+        gIsRunning = true;
+        gIsStopping = false;
+        QueueAdvance(now);
+        SendFrame(id, ctrl, 0, 0);
+        return;
+    case ProtocolQueuedCmdStopExec:
+        // The running command is finished first
+        if (gIsActive) {
+            gIsStopping = true;
+        } else {
+            gIsRunning = false;
+        }
+        SendFrame(id, ctrl, 0, 0);
+        return;
+    case ProtocolQueuedCmdForceStopExec:
+        QueueForceStop(now);
+        SendFrame(id, ctrl, 0, 0);
+        return;
+    case ProtocolQueuedCmdClear:
+        if (gIsActive) {
+            QueueForceStop(now);
+        }
+        gQueueCount = 0;
+        SendFrame(id, ctrl, 0, 0);
+        return;
+    case ProtocolQueuedCmdCurrentIndex:
+        SendFrame(id, ctrl, &gCurrentIndex, sizeof(gCurrentIndex));
+        return;
+    case ProtocolQueuedCmdLeftSpace: {
+        uint32_t leftSpace = QUEUE_SIZE - gQueueCount;
+        SendFrame(id, ctrl, &leftSpace, sizeof(leftSpace));
+        return;
+    }
+    default:
+        break;
+    }
+
+    // Plain params: a set stores them, a get returns the last ones set
+    if (isWrite) {
+        gParams[id].len = paramsLen;
+        memcpy(gParams[id].data, params, paramsLen);
+        SendFrame(id, ctrl, 0, 0);
+    } else {
+        SendFrame(id, ctrl, gParams[id].data, gParams[id].len);
+    }
+}
+
+static void ReceiveByte(uint8_t byte)
+{
+    uint8_t *raw = (uint8_t *)&gRxPacket;
+
+    if (Chance(gOptions.dropRate)) {
+        gStats.droppedBytes++;
+        return;
+    }
+    switch (gRxState) {
+    case PacketParseSyncByte1:
+        if (byte == SYNC_BYTE) {
+            gRxState = PacketParseSyncByte2;
+        }
+        break;
+    case PacketParseSyncByte2:
+        gRxState = byte == SYNC_BYTE ? PacketParsePayloadLen : PacketParseSyncByte1;
+        break;
+    case PacketParsePayloadLen:
+        if (byte == SYNC_BYTE) {
+            break;
+        }
+        if (byte < 2 || byte > MAX_PAYLOAD_SIZE) {
+            gRxState = PacketParseSyncByte1;
+            break;
+        }
+        gRxPacket.header.payloadLen = byte;
+        gRxCount = 0;
+        gRxState = PacketParsePayload;
+        break;
+    case PacketParsePayload:
+        raw[sizeof(PacketHeader) + gRxCount++] = byte;
+        if (gRxCount == gRxPacket.header.payloadLen) {
+            gRxState = PacketParseChecksum;
+        }
+        break;
+    case PacketParseChecksum: {
+        uint8_t checksum = byte;
+        for (uint8_t i = 0; i < gRxPacket.header.payloadLen; i++) {
+            checksum += raw[sizeof(PacketHeader) + i];
+        }
+        gRxState = PacketParseSyncByte1;
+        if (checksum != 0) {
+            gStats.rxBadChecksum++;
+            break;
+        }
+        HandlePacket(&gRxPacket);
+        break;
+    }
+    }
+}
+
+static int OpenPty(void)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+    const char *slaveName = ptsname(master);
+
+    // Keep the slave open in raw mode, so the master never sees a hangup between two clients
+    int slave = open(slaveName, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror(slaveName);
+        return -1;
+    }
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    unlink(gOptions.link);
+    if (symlink(slaveName, gOptions.link) < 0) {
+        perror(gOptions.link);
+        return -1;
+    }
+    fprintf(stderr, "[SIM] %s -> %s\n", gOptions.link, slaveName);
+    fcntl(master, F_SETFL, fcntl(master, F_GETFL) | O_NONBLOCK);
+    return master;
+}
+
+static bool ParseOptions(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : 0;
+
+        if (strcmp(arg, "-v") == 0) {
+            gOptions.isVerbose = true;
+            continue;
+        }
+        if (value == 0) {
+            return false;
+        }
+        i++;
+        if (strcmp(arg, "--link") == 0) {
+            gOptions.link = value;
+        } else if (strcmp(arg, "--baud") == 0) {
+            gOptions.baud = strtoul(value, 0, 10);
+        } else if (strcmp(arg, "--reply-ms") == 0) {
+            gOptions.replyMs = strtoul(value, 0, 10);
+        } else if (strcmp(arg, "--home-ms") == 0) {
+            gOptions.homeMs = strtoul(value, 0, 10);
+        } else if (strcmp(arg, "--drop") == 0) {
+            gOptions.dropRate = atof(value);
+        } else if (strcmp(arg, "--corrupt") == 0) {
+            gOptions.corruptRate = atof(value);
+        } else if (strcmp(arg, "--late") == 0) {
+            gOptions.lateRate = atof(value);
+        } else if (strcmp(arg, "--late-ms") == 0) {
+            gOptions.lateMs = strtoul(value, 0, 10);
+        } else if (strcmp(arg, "--seed") == 0) {
+            gOptions.seed = strtoul(value, 0, 10);
+        } else if (strcmp(arg, "--jam-at") == 0) {
+            gOptions.jamAt = strtoull(value, 0, 10);
+        } else {
+            return false;
+        }
+    }
+    return gOptions.baud != 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (ParseOptions(argc, argv) == false) {
+        fprintf(stderr, "Usage: %s [--link PATH] [--baud N] [--reply-ms N] [--home-ms N]\n"
+                        "       [--drop P] [--corrupt P] [--late P] [--late-ms N] [--seed N] [--jam-at N] [-v]\n",
+                argv[0]);
+        return 2;
+    }
+    srand(gOptions.seed);
+    signal(SIGINT, OnSignal);
+    signal(SIGTERM, OnSignal);
+
+    ParamsInit();
+    PoseOf(PointOf(*ParamsOf<Pose>(ProtocolHOMEParams)), &gPose);
+    gStartTime = Now();
+    gMaster = OpenPty();
+    if (gMaster < 0) {
+        return 1;
+    }
+
+    while (gIsQuit == 0) {
+        uint64_t now = Now();
+        QueueAdvance(now);
+        FlushOutbox(now);
+
+        // Sleep until a byte comes in, a reply is due or the running command ends
+        uint64_t wake = now + 100000;
+        if (gOutboxCount && gOutbox[gOutboxHead].due < wake) {
+            wake = gOutbox[gOutboxHead].due;
+        }
+        if (gIsActive && gActiveEnd < wake) {
+            wake = gActiveEnd;
+        }
+        struct pollfd pfd = {gMaster, POLLIN, 0};
+        int timeout = (int)((wake > now ? wake - now : 0) + 999) / 1000;
+        if (poll(&pfd, 1, timeout) <= 0) {
+            continue;
+        }
+        uint8_t data[256];
+        ssize_t len = read(gMaster, data, sizeof(data));
+        for (ssize_t i = 0; i < len; i++) {
+            ReceiveByte(data[i]);
+        }
+    }
+
+    unlink(gOptions.link);
+    fprintf(stderr, "[SIM] rx %u (bad checksum %u), tx %u, queued %u, alarms %u\n",
+            gStats.rxFrames, gStats.rxBadChecksum, gStats.txFrames, gStats.queuedCmds, gStats.alarms);
+    fprintf(stderr, "[SIM] faults: dropped bytes %u, corrupt %u, late %u\n",
+            gStats.droppedBytes, gStats.corruptFrames, gStats.lateFrames);
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * The RX slot of ChessLink (libraries/ChessLink) when a frame starts while the previous one is
+ * still held: the Mega reads the first bytes of a move in a poll() (the wait loop of send() does
+ * it) before receive() frees the slot, and the rest after.
+ *
+ * The bytes go from one end to the other only when the test moves them, so the split falls
+ * always at the same place: the sync, length, type, seq and the first payload byte of the second
+ * move. That frame must not be delivered nor acknowledged, its payload is not whole in the slot;
+ * the MKR sends it again at the Ack timeout and the copy arrives intact. A slot that took the tail
+ * of the frame over the previous payload delivered "e7d5" for "d7d5", with a good CRC.
+ *
+ * Usage: ChessLinkRxTest
+ */
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+
+#include <ChessLink.h>
+
+// One end of the link: what it writes waits in out until Move() takes it to the other end
+class PipeStream : public Stream {
+public:
+    std::deque<uint8_t> in;
+    std::deque<uint8_t> out;
+
+    size_t write(uint8_t data)
+    {
+        out.push_back(data);
+        return 1;
+    }
+    int availableForWrite(void) { return 64; }
+    int available(void) { return in.size(); }
+    int peek(void) { return in.empty() ? -1 : in.front(); }
+    int read(void)
+    {
+        if (in.empty()) {
+            return -1;
+        }
+        uint8_t data = in.front();
+        in.pop_front();
+        return data;
+    }
+};
+
+// count bytes from one end to the other, all of them with 0
+static size_t Move(PipeStream &from, PipeStream &to, size_t count = 0)
+{
+    size_t moved = 0;
+    while (!from.out.empty() && (count == 0 || moved < count)) {
+        to.in.push_back(from.out.front());
+        from.out.pop_front();
+        moved++;
+    }
+    return moved;
+}
+
+static bool Check(bool isOk, const char *what)
+{
+    if (!isOk) {
+        fprintf(stderr, "FAILED: %s\n", what);
+    }
+    return isOk;
+}
+
+static bool IsText(const ChessLink &link, const char *text)
+{
+    return link.length() == strlen(text) && memcmp(link.payload(), text, link.length()) == 0;
+}
+
+int main(void)
+{
+    PipeStream mkrPort, megaPort;
+    ChessLink mkr, mega;
+    bool isOk = true;
+
+    mkr.begin(mkrPort);
+    mega.begin(megaPort);
+
+    // The first move is delivered and held by the Mega
+    isOk &= Check(mkr.send(ChessLinkCommand, "e2e4"), "send e2e4");
+    Move(mkrPort, megaPort);
+    isOk &= Check(mega.receive() && IsText(mega, "e2e4"), "e2e4 delivered");
+    Move(megaPort, mkrPort);
+    mkr.poll();
+    isOk &= Check(mkr.stats().sent == 1, "e2e4 acknowledged");
+
+    // The second one starts while e2e4 is still in the slot
+    isOk &= Check(mkr.send(ChessLinkCommand, "d7d5"), "send d7d5");
+    Move(mkrPort, megaPort, 6);
+    mega.poll();
+    isOk &= Check(!mega.receive(), "nothing before the end of d7d5");
+    Move(mkrPort, megaPort);
+    if (mega.receive()) {
+        isOk &= Check(IsText(mega, "d7d5"), "d7d5 delivered with its own payload");
+    }
+    isOk &= Check(megaPort.out.empty(), "frame started on a busy slot not acknowledged");
+
+    // The copy sent at the Ack timeout
+    delay(CHESSLINK_ACK_TIMEOUT + 10);
+    mkr.poll();
+    Move(mkrPort, megaPort);
+    isOk &= Check(mega.receive() && IsText(mega, "d7d5"), "d7d5 delivered by the retransmit");
+    Move(megaPort, mkrPort);
+    mkr.poll();
+    isOk &= Check(mkr.stats().sent == 2 && mkr.stats().retransmits == 1, "d7d5 acknowledged after one retransmit");
+    isOk &= Check(mega.stats().received == 2, "two frames delivered to the Mega");
+
+    printf("%s: held slot, %u retransmit\n", isOk ? "ok" : "FAILED", (unsigned)mkr.stats().retransmits);
+    return isOk ? 0 : 1;
+}
@@ -0,0 +1,273 @@
+/*
+ * The TX path of DobotSerial against its ISR: MessageWrite fills the tx raw byte queue while the
+ * UDRE2 ISR drains it and an urgent frame (the force stop of the e-stop) is slipped in between two
+ * frames.
+ *
+ * On x86 the main loop runs with the trap flag set, so a SIGTRAP comes after every instruction and
+ * the ISR can run between any two of them, as the real one does: it takes a byte at a random one in
+ * --step. Elsewhere, or with --timer, the ISR is a SIGALRM handler every --interval µs, which rarely
+ * lands inside MessageWrite. Like UDRE2 the ISR sends one byte per interrupt and turns itself off
+ * when the queue is empty, until DobotSerialSend. The queue is 32 bytes, so the header of about one
+ * frame in three wraps around its end (the start lands on byte 30 or 31), and each frame is written
+ * while the last byte of the previous one is leaving the queue: the moment the length byte of a
+ * frame is read.
+ *
+ * The bytes sent are parsed back: every frame must be whole with a good checksum, the queued ones
+ * in order and the urgent ones only between two of them. A frame published header first loses the
+ * alignment of the ISR, which then sends the urgent frame inside another frame.
+ *
+ * Usage: DobotSerialTxTest [-n FRAMES] [--step N] [--timer] [--interval US] [--seed N]
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "DobotSerial.h"
+#include "Message.h"
+
+#define TX_QUEUE_SIZE   32
+#define URGENT_ID       250
+#define URGENT_PERIOD   37                  // bytes sent between two urgent frames
+#if defined(__x86_64__)
+#define HAS_TRAP_FLAG   1
+#define SP              "rsp"
+#elif defined(__i386__)
+#define HAS_TRAP_FLAG   1
+#define SP              "esp"
+#endif
+
+static uint8_t gTxBuffer[TX_QUEUE_SIZE];
+static uint8_t gRxBuffer[TX_QUEUE_SIZE];
+static RingBuffer gRxQueue;
+static ProtocolHandler gHandler;
+
+static uint8_t gUrgentFrame[8];
+static uint8_t gUrgentLen;
+
+static volatile bool gTxEnabled;
+static uint8_t *gWire;
+static volatile uint32_t gWireLen;
+static uint32_t gWireSize;
+static uint32_t gInterrupts;
+static uint32_t gStep = 16;
+static uint32_t gRandom = 1;
+
+void DobotSerialPortOpen(uint32_t)
+{
+}
+
+void DobotSerialPortStartTx(void)
+{
+    gTxEnabled = true;
+}
+
+// The UDRE2 ISR and, now and then, the e-stop ISR
+static void Interrupt(int)
+{
+    uint8_t data;
+
+    // Not rand(), the main loop may be inside it
+    gRandom = gRandom * 1103515245 + 12345;
+    if ((gRandom >> 16) % gStep != 0) {
+        return;
+    }
+    if (++gInterrupts % URGENT_PERIOD == 0) {
+        DobotSerialSendUrgent(gUrgentFrame, gUrgentLen);
+    }
+    if (!gTxEnabled) {
+        return;
+    }
+    if (!DobotSerialTransmit(&data)) {
+        gTxEnabled = false;
+        return;
+    }
+    if (gWireLen < gWireSize) {
+        gWire[gWireLen] = data;
+        gWireLen = gWireLen + 1;
+    }
+}
+
+// Params of at least 2 bytes, the first two are the frame number
+static void FillMessage(Message *message, uint16_t number, uint8_t paramsLen)
+{
+    message->id = 1 + number % 200;
+    message->rw = 1;
+    message->isQueued = 1;
+    message->paramsLen = paramsLen;
+    message->params[0] = (uint8_t)number;
+    message->params[1] = number >> 8;
+    for (uint8_t i = 2; i < paramsLen; i++) {
+        message->params[i] = (uint8_t)rand();
+    }
+}
+
+// Frame size 8..18, picked to start the next frame on byte 30 or 31 when it can
+static uint8_t NextParamsLen(void)
+{
+    uint8_t start = gHandler.txRawByteQueue.writeAddress;
+    uint8_t target = TX_QUEUE_SIZE - 1 - rand() % 2;
+    uint8_t frameLen = (uint8_t)(target - start) & (TX_QUEUE_SIZE - 1);
+
+    if (frameLen < 8 || frameLen > 18) {
+        frameLen = 8 + rand() % 11;
+    }
+    return frameLen - 6;
+}
+
+#ifdef HAS_TRAP_FLAG
+// Single step the main loop: the kernel clears the flag for the handler and restores it after
+static void SetTrapFlag(bool isOn)
+{
+    if (isOn) {
+        __asm__ __volatile__("pushf\n\torl $0x100, (%%" SP ")\n\tpopf" ::: "memory", "cc");
+    } else {
+        __asm__ __volatile__("pushf\n\tandl $~0x100, (%%" SP ")\n\tpopf" ::: "memory", "cc");
+    }
+}
+#endif
+
+// false at the first frame not as sent
+static bool CheckWire(uint32_t frames, uint32_t *urgents)
+{
+    uint32_t pos = 0;
+    uint16_t expected = 0;
+
+    *urgents = 0;
+    while (pos < gWireLen) {
+        if (gWireLen - pos < 6 || gWire[pos] != SYNC_BYTE || gWire[pos + 1] != SYNC_BYTE) {
+            fprintf(stderr, "byte %u: no frame start (%02X %02X)\n", pos, gWire[pos], gWire[pos + 1]);
+            return false;
+        }
+        uint8_t payloadLen = gWire[pos + 2];
+        if (payloadLen < 2 || payloadLen > MAX_PAYLOAD_SIZE || gWireLen - pos < payloadLen + 4u) {
+            fprintf(stderr, "byte %u: bad length %u\n", pos, payloadLen);
+            return false;
+        }
+        uint8_t checksum = 0;
+        for (uint8_t i = 0; i <= payloadLen; i++) {
+            checksum += gWire[pos + 3 + i];
+        }
+        if (checksum != 0) {
+            fprintf(stderr, "byte %u: bad checksum, frame %u\n", pos, expected);
+            return false;
+        }
+        if (gWire[pos + 3] == URGENT_ID) {
+            (*urgents)++;
+        } else {
+            uint16_t number = gWire[pos + 5] | (gWire[pos + 6] << 8);
+            if (number != expected) {
+                fprintf(stderr, "byte %u: frame %u instead of %u\n", pos, number, expected);
+                return false;
+            }
+            expected++;
+        }
+        pos += payloadLen + 4;
+    }
+    if (expected != frames) {
+        fprintf(stderr, "%u frames on the wire instead of %u\n", expected, frames);
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t frames = 500;
+    long interval = 20;
+    unsigned seed = 1;
+#ifdef HAS_TRAP_FLAG
+    bool isTimer = false;
+#else
+    bool isTimer = true;
+#endif
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            frames = strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            gStep = strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--timer") == 0) {
+            isTimer = true;
+        } else if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc) {
+            interval = strtol(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], 0, 10);
+        } else {
+            fprintf(stderr, "Usage: %s [-n FRAMES] [--step N] [--timer] [--interval US] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (frames == 0 || frames > 65536 || interval <= 0 || gStep == 0) {
+        fprintf(stderr, "-n must be 1..65536, --step and --interval at least 1\n");
+        return 1;
+    }
+    srand(seed);
+    gRandom = seed;
+
+    Message message;
+    FillMessage(&message, 0, 2);
+    message.id = URGENT_ID;
+    message.isQueued = 0;
+    gUrgentLen = MessageSerialize(&message, gUrgentFrame);
+
+    // An urgent frame at most between two queued frames
+    gWireSize = frames * (18 + gUrgentLen) + 1024;
+    gWire = (uint8_t *)malloc(gWireSize);
+    RingBufferInit(&gHandler.txRawByteQueue, gTxBuffer, TX_QUEUE_SIZE, 1);
+    RingBufferInit(&gRxQueue, gRxBuffer, TX_QUEUE_SIZE, 1);
+    DobotSerialInit(DOBOT_SERIAL_BAUDRATE, &gRxQueue, &gHandler.txRawByteQueue);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = Interrupt;
+    action.sa_flags = SA_RESTART;
+    if (isTimer) {
+        gStep = 1;
+        sigaction(SIGALRM, &action, 0);
+        struct itimerval timer = {{0, interval}, {0, interval}};
+        setitimer(ITIMER_REAL, &timer, 0);
+    }
+#ifdef HAS_TRAP_FLAG
+    else {
+        sigaction(SIGTRAP, &action, 0);
+    }
+#endif
+
+    for (uint32_t n = 0; n < frames; n++) {
+        FillMessage(&message, n, NextParamsLen());
+#ifdef HAS_TRAP_FLAG
+        SetTrapFlag(!isTimer);
+#endif
+        // The last byte of the previous frame is leaving, the ISR reads this one's length next
+        while (RingBufferGetCount(&gHandler.txRawByteQueue) > 1) {
+        }
+        ProtocolResult result = MessageWrite(&gHandler, &message);
+        DobotSerialSend();
+#ifdef HAS_TRAP_FLAG
+        SetTrapFlag(false);
+#endif
+        if (result != ProtocolNoError) {
+            fprintf(stderr, "frame %u: TX queue full\n", n);
+            return 1;
+        }
+    }
+    // The last frame and a pending urgent frame
+#ifdef HAS_TRAP_FLAG
+    SetTrapFlag(!isTimer);
+#endif
+    while (!RingBufferIsEmpty(&gHandler.txRawByteQueue) || gTxEnabled) {
+    }
+#ifdef HAS_TRAP_FLAG
+    SetTrapFlag(false);
+#endif
+    struct itimerval stop = {{0, 0}, {0, 0}};
+    setitimer(ITIMER_REAL, &stop, 0);
+
+    uint32_t urgents;
+    bool isOk = CheckWire(frames, &urgents);
+    printf("%s: %u frames, %u urgent frames, %u bytes, %u interrupts\n", isOk ? "ok" : "FAILED", frames,
+           urgents, gWireLen, gInterrupts);
+    return isOk ? 0 : 1;
+}
@@ -1,7 +1,6 @@
 #pragma once
 
 #define ROBOT_AXIS                          (4)                         // »úÆ÷ÈË¹Ø½ÚÊý
-#define SERIALNUM   Serial2
 #define DEBUGPRINT  0
 
 //-----------------------------------------------------------------------------
@@ -691,6 +691,11 @@ typedef struct tagIOConfig {
     uint8_t address;
     uint8_t function;
 } IOConfig __attribute__ ((aligned(4)));
+// Same fields as IOConfig, whose alignment is larger than its size, for the arrays of port configs
+typedef struct tagIOPortConfig {
+    uint8_t address;
+    uint8_t function;
+} IOPortConfig;
 /*********************************************************************************************************
 ** System Information Storage
 *********************************************************************************************************/
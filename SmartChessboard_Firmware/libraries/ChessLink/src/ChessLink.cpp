@@ -0,0 +1,336 @@
+/*
+ * ChessLink - framed and acknowledged serial link between the MKR and the Mega.
+ * See ChessLink.h for the frame.
+ */
+#include "ChessLink.h"
+
+#define TX_MASK (CHESSLINK_TX_BUFFER - 1)
+
+ChessLink::ChessLink()
+    : port(0), peerUp(true), txHead(0), txTail(0), txPos(0), txSeq(0), txTries(0), isTxAcked(false),
+      isFirstFrame(true),
+      txSentTime(0), controlPos(0), isControlPending(false), nextControlType(0), nextControlSeq(0),
+      hasNextControl(false), rxType(0), rxLength(0), isRxReady(false),
+      isRxDelivered(false), rxLastSeq(0), hasRxLastSeq(false), wasRxLastFirst(false), parseState(ParseSync1),
+      parseLength(0), parseType(0), parseSeq(0), isParseKept(false), parseCount(0), parseCrc(0), parseStart(0)
+{
+    memset(&linkStats, 0, sizeof(linkStats));
+}
+
+void ChessLink::begin(Stream &stream)
+{
+    port = &stream;
+    // A peer that kept running still holds the last seq of our previous boot
+    txSeq = (uint8_t)micros();
+}
+
+// CRC16 CCITT a byte at a time, without a table
+uint16_t ChessLink::crcUpdate(uint16_t crc, uint8_t data)
+{
+    data ^= (uint8_t)crc;
+    data ^= data << 4;
+    return (((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3);
+}
+
+uint16_t ChessLink::txFree() const
+{
+    return CHESSLINK_TX_BUFFER - (uint16_t)(txHead - txTail);
+}
+
+// Size of the frame at the tail, the one in flight
+uint8_t ChessLink::txFrameSize() const
+{
+    return txBuffer[(txTail + 2) & TX_MASK] + CHESSLINK_OVERHEAD;
+}
+
+bool ChessLink::canSend(uint8_t length) const
+{
+    return length <= CHESSLINK_MAX_PAYLOAD && txFree() >= (uint16_t)(length + CHESSLINK_OVERHEAD);
+}
+
+bool ChessLink::send(uint8_t type, const uint8_t *payload, uint8_t length)
+{
+    if (port == 0 || length > CHESSLINK_MAX_PAYLOAD) {
+        return false;
+    }
+    // Room comes with the Acks, unless the peer is gone
+    uint32_t start = millis();
+    while (txFree() < (uint16_t)(length + CHESSLINK_OVERHEAD)) {
+        if (!peerUp || millis() - start >= CHESSLINK_SEND_TIMEOUT) {
+            linkStats.dropped++;
+            return false;
+        }
+        poll();
+    }
+
+    if (isFirstFrame) {
+        type |= CHESSLINK_TYPE_FIRST;
+        isFirstFrame = false;
+    }
+    uint8_t seq = ++txSeq;
+    uint8_t head[5] = {CHESSLINK_SYNC_BYTE1, CHESSLINK_SYNC_BYTE2, length, type, seq};
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < sizeof(head); i++) {
+        txBuffer[txHead++ & TX_MASK] = head[i];
+        if (i >= 2) {
+            crc = crcUpdate(crc, head[i]);
+        }
+    }
+    for (uint8_t i = 0; i < length; i++) {
+        txBuffer[txHead++ & TX_MASK] = payload[i];
+        crc = crcUpdate(crc, payload[i]);
+    }
+    txBuffer[txHead++ & TX_MASK] = (uint8_t)crc;
+    txBuffer[txHead++ & TX_MASK] = crc >> 8;
+
+    transmit();
+    return true;
+}
+
+bool ChessLink::send(uint8_t type, const char *text)
+{
+    return send(type, (const uint8_t *)text, strlen(text));
+}
+
+void ChessLink::queueControl(uint8_t type, uint8_t seq)
+{
+    // Only the last answer matters, the peer has a single frame in flight, but the bytes of
+    // the one already on the wire must all go out
+    if (isControlPending && controlPos > 0) {
+        nextControlType = type;
+        nextControlSeq = seq;
+        hasNextControl = true;
+        return;
+    }
+    buildControl(type, seq);
+}
+
+void ChessLink::buildControl(uint8_t type, uint8_t seq)
+{
+    uint8_t body[3] = {0, type, seq};
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < sizeof(body); i++) {
+        crc = crcUpdate(crc, body[i]);
+    }
+    controlFrame[0] = CHESSLINK_SYNC_BYTE1;
+    controlFrame[1] = CHESSLINK_SYNC_BYTE2;
+    memcpy(&controlFrame[2], body, sizeof(body));
+    controlFrame[5] = (uint8_t)crc;
+    controlFrame[6] = crc >> 8;
+    controlPos = 0;
+    isControlPending = true;
+}
+
+// Write what fits in the UART buffer: a pending Ack or Nack first, but never inside a frame
+void ChessLink::transmit()
+{
+    bool hasFrame = txHead != txTail;
+    bool isFrameMidway = hasFrame && txPos > 0 && txPos < txFrameSize();
+    int room = port->availableForWrite();
+
+    if (isControlPending && !isFrameMidway) {
+        while (room > 0 && controlPos < CHESSLINK_OVERHEAD) {
+            port->write(controlFrame[controlPos++]);
+            room--;
+        }
+        if (controlPos < CHESSLINK_OVERHEAD) {
+            return;
+        }
+        isControlPending = false;
+        if (hasNextControl) {
+            hasNextControl = false;
+            buildControl(nextControlType, nextControlSeq);
+            transmit();
+            return;
+        }
+    }
+    if (!hasFrame) {
+        return;
+    }
+    uint8_t size = txFrameSize();
+    if (txPos == size) {
+        return;
+    }
+    while (room > 0 && txPos < size) {
+        port->write(txBuffer[(txTail + txPos++) & TX_MASK]);
+        room--;
+    }
+    // The Ack wait starts once the whole frame is out
+    if (txPos == size && isTxAcked) {
+        dropFrame();
+    } else if (txPos == size) {
+        txSentTime = millis();
+        if (txTries == 0) {
+            txTries = 1;
+        }
+    }
+}
+
+void ChessLink::dropFrame()
+{
+    txTail += txFrameSize();
+    txPos = 0;
+    txTries = 0;
+    isTxAcked = false;
+}
+
+// The frame in flight again, or given up once its tries are over
+void ChessLink::retransmit()
+{
+    if (txTries > CHESSLINK_RETRIES || !peerUp) {
+        linkStats.failed++;
+        peerUp = false;
+        dropFrame();
+    } else {
+        linkStats.retransmits++;
+        txTries++;
+    }
+    txPos = 0;
+}
+
+void ChessLink::poll()
+{
+    if (port == 0) {
+        return;
+    }
+    while (port->available() > 0) {
+        handleByte(port->read());
+    }
+    if (parseState != ParseSync1 && millis() - parseStart >= CHESSLINK_FRAME_TIMEOUT) {
+        linkStats.crcErrors++;
+        parseState = ParseSync1;
+    }
+
+    // No Ack in time: the same frame again, later each time
+    if (txHead != txTail && txTries > 0 && txPos == txFrameSize() &&
+        millis() - txSentTime >= ((uint32_t)CHESSLINK_ACK_TIMEOUT << (txTries - 1))) {
+        retransmit();
+    }
+    transmit();
+}
+
+bool ChessLink::receive()
+{
+    if (isRxDelivered) {
+        isRxDelivered = false;
+        isRxReady = false;
+    }
+    poll();
+    if (!isRxReady) {
+        return false;
+    }
+    isRxDelivered = true;
+    linkStats.received++;
+    return true;
+}
+
+void ChessLink::handleByte(uint8_t data)
+{
+    switch (parseState) {
+    case ParseSync1:
+        if (data == CHESSLINK_SYNC_BYTE1) {
+            parseState = ParseSync2;
+            parseStart = millis();
+        }
+        break;
+    case ParseSync2:
+        parseState = data == CHESSLINK_SYNC_BYTE2 ? ParseLength : (data == CHESSLINK_SYNC_BYTE1 ? ParseSync2 : ParseSync1);
+        break;
+    case ParseLength:
+        if (data > CHESSLINK_MAX_PAYLOAD) {
+            linkStats.crcErrors++;
+            parseState = ParseSync1;
+            break;
+        }
+        parseLength = data;
+        parseCrc = crcUpdate(0xFFFF, data);
+        parseState = ParseType;
+        break;
+    case ParseType:
+        parseType = data;
+        parseCrc = crcUpdate(parseCrc, data);
+        parseState = ParseSeq;
+        break;
+    case ParseSeq:
+        parseSeq = data;
+        parseCrc = crcUpdate(parseCrc, data);
+        // Decided once for the frame: a slot freed by receive() halfway would get only its tail
+        isParseKept = !isRxReady;
+        parseCount = 0;
+        parseState = parseLength > 0 ? ParsePayload : ParseCrcLow;
+        break;
+    case ParsePayload:
+        // Kept only if the slot was free at its start, a frame that found it busy is not acknowledged
+        if (isParseKept) {
+            rxFrame[parseCount] = data;
+        }
+        parseCrc = crcUpdate(parseCrc, data);
+        if (++parseCount == parseLength) {
+            parseState = ParseCrcLow;
+        }
+        break;
+    case ParseCrcLow:
+        parseCrc ^= data;
+        parseState = ParseCrcHigh;
+        break;
+    case ParseCrcHigh:
+        parseState = ParseSync1;
+        handleFrame(parseCrc ^ ((uint16_t)data << 8));
+        break;
+    }
+}
+
+// crc is 0 when the frame is intact
+void ChessLink::handleFrame(uint16_t crc)
+{
+    if (crc != 0) {
+        linkStats.crcErrors++;
+        // A broken Ack or Nack is not answered, the timeout of the peer covers it
+        if (parseLength > 0) {
+            queueControl(ChessLinkNack, parseSeq);
+        }
+        return;
+    }
+    peerUp = true;
+    uint8_t type = parseType & ~CHESSLINK_TYPE_FIRST;
+    bool isFirst = (parseType & CHESSLINK_TYPE_FIRST) != 0;
+
+    if (type == ChessLinkAck) {
+        if (txHead != txTail && txTries > 0 && !isTxAcked && parseSeq == txBuffer[(txTail + 4) & TX_MASK]) {
+            linkStats.sent++;
+            // A copy half written goes out to the end, the peer drops it as a duplicate
+            if (txPos > 0 && txPos < txFrameSize()) {
+                isTxAcked = true;
+            } else {
+                dropFrame();
+            }
+        }
+        return;
+    }
+    if (type == ChessLinkNack) {
+        // Sent again now rather than at the timeout, once it is fully out
+        if (txHead != txTail && txTries > 0 && txPos == txFrameSize()) {
+            retransmit();
+        }
+        return;
+    }
+
+    // The Ack of a copy was lost, the copy is answered again but not delivered
+    if (hasRxLastSeq && parseSeq == rxLastSeq && (!isFirst || wasRxLastFirst)) {
+        linkStats.duplicates++;
+        queueControl(ChessLinkAck, parseSeq);
+        return;
+    }
+    // Its payload is not in rxFrame, the peer sends it again at the Ack timeout
+    if (isRxReady || !isParseKept) {
+        return;
+    }
+    rxFrame[parseLength] = 0;
+    rxType = type;
+    rxLength = parseLength;
+    isRxReady = true;
+    rxLastSeq = parseSeq;
+    hasRxLastSeq = true;
+    wasRxLastFirst = isFirst;
+    queueControl(ChessLinkAck, parseSeq);
+}
@@ -0,0 +1,153 @@
+/*
+ * ChessLink - framed and acknowledged serial link between the MKR and the Mega.
+ *
+ * Both boards use this same file, so the two ends always agree on the frame:
+ *
+ *   0xA5 0x5A | len | type | seq | payload (len bytes) | CRC16 low, high
+ *
+ * The CRC16 (CCITT, init 0xFFFF) covers len, type, seq and the payload.
+ * Every Command or Message frame is answered with an Ack carrying its seq, a frame with a
+ * bad CRC with a Nack. The sender keeps one frame in flight and sends it again on a Nack
+ * or when the Ack does not come within CHESSLINK_ACK_TIMEOUT, doubled at each retry.
+ * The receiver drops the copies it already delivered, by seq.
+ *
+ * Nothing here waits for the wire: poll() writes only what fits in the UART buffer and
+ * reads only what has arrived, so it can run at every turn of loop().
+ */
+#ifndef CHESSLINK_H
+#define CHESSLINK_H
+
+#include <Arduino.h>
+
+#define CHESSLINK_BAUDRATE      115200
+#define CHESSLINK_SYNC_BYTE1    0xA5
+#define CHESSLINK_SYNC_BYTE2    0x5A
+#define CHESSLINK_MAX_PAYLOAD   120     // the longest CALIB_MSG line fits
+#define CHESSLINK_OVERHEAD      7       // sync, len, type, seq, CRC
+// Frames waiting to be sent, the one in flight included. A power of two, the indexes wrap
+#define CHESSLINK_TX_BUFFER     256
+// Ack wait of the first try in ms, doubled at each retry
+#define CHESSLINK_ACK_TIMEOUT   50
+#define CHESSLINK_RETRIES       5
+// send() waits at most so long for room in the TX buffer, while the peer answers
+#define CHESSLINK_SEND_TIMEOUT  200
+// A frame not complete after so long is dropped, its missing bytes were lost
+#define CHESSLINK_FRAME_TIMEOUT 20
+
+enum ChessLinkType {
+    ChessLinkAck = 0x01,
+    ChessLinkNack = 0x02,
+    ChessLinkCommand = 0x10,            // MKR to Mega: "e2e4", "STARTGAME", "CALIB_CONFIRM"...
+    ChessLinkMessage = 0x11             // Mega to MKR: "CALIB_MSG:..."
+};
+
+// Set in the type of the first frame sent after begin(): the peer takes its seq as is
+#define CHESSLINK_TYPE_FIRST    0x80
+
+struct ChessLinkStats {
+    uint32_t sent;                      // frames delivered and acknowledged
+    uint32_t received;                  // frames delivered to receive()
+    uint32_t retransmits;
+    uint32_t crcErrors;                 // frames received with a bad CRC, or cut short
+    uint32_t duplicates;                // copies of a frame already delivered
+    uint32_t failed;                    // frames given up after CHESSLINK_RETRIES
+    uint32_t dropped;                   // frames not queued, the TX buffer stayed full
+};
+
+class ChessLink {
+public:
+    ChessLink();
+
+    // The port is opened by the sketch, at CHESSLINK_BAUDRATE on both boards. It must report
+    // availableForWrite(), as the HardwareSerial of the Mega and the Uart of the MKR do
+    void begin(Stream &port);
+
+    // Queue a frame, false if it does not fit in CHESSLINK_SEND_TIMEOUT (or at once while
+    // the peer does not answer) or if the payload is too long
+    bool send(uint8_t type, const uint8_t *payload, uint8_t length);
+    bool send(uint8_t type, const char *text);
+    // True if send() of length bytes returns at once
+    bool canSend(uint8_t length) const;
+
+    // Read, answer and send what is due, without waiting
+    void poll();
+
+    // poll(), then true if a Command or Message frame is ready: type(), payload() and text()
+    // stay valid until the next receive()
+    bool receive();
+    uint8_t type() const { return rxType; }
+    const uint8_t *payload() const { return rxFrame; }
+    uint8_t length() const { return rxLength; }
+    const char *text() const { return (const char *)rxFrame; }
+
+    // False since a frame was given up, until the peer is heard again
+    bool isPeerUp() const { return peerUp; }
+    const ChessLinkStats &stats() const { return linkStats; }
+
+private:
+    enum {
+        ParseSync1,
+        ParseSync2,
+        ParseLength,
+        ParseType,
+        ParseSeq,
+        ParsePayload,
+        ParseCrcLow,
+        ParseCrcHigh
+    };
+
+    Stream *port;
+    ChessLinkStats linkStats;
+    bool peerUp;
+
+    // TX: whole frames in a byte ring, the first one is in flight until its Ack
+    uint8_t txBuffer[CHESSLINK_TX_BUFFER];
+    uint16_t txHead;
+    uint16_t txTail;
+    uint8_t txPos;                      // bytes of the frame in flight already written
+    uint8_t txSeq;
+    uint8_t txTries;
+    bool isTxAcked;                     // acknowledged while a copy was half written
+    bool isFirstFrame;
+    uint32_t txSentTime;
+    // Acks and Nacks go out ahead of the queued frames, between two of them. One that comes
+    // while the previous is half written waits for it in nextControlType/Seq
+    uint8_t controlFrame[CHESSLINK_OVERHEAD];
+    uint8_t controlPos;
+    bool isControlPending;
+    uint8_t nextControlType;
+    uint8_t nextControlSeq;
+    bool hasNextControl;
+
+    // RX: the parser writes the payload in place when the slot is free
+    uint8_t rxFrame[CHESSLINK_MAX_PAYLOAD + 1];
+    uint8_t rxType;
+    uint8_t rxLength;
+    bool isRxReady;
+    bool isRxDelivered;
+    uint8_t rxLastSeq;
+    bool hasRxLastSeq;
+    bool wasRxLastFirst;
+
+    uint8_t parseState;
+    uint8_t parseLength;
+    uint8_t parseType;
+    uint8_t parseSeq;
+    bool isParseKept;                   // the slot was free at the seq, the payload is in rxFrame
+    uint8_t parseCount;
+    uint16_t parseCrc;
+    uint32_t parseStart;
+
+    static uint16_t crcUpdate(uint16_t crc, uint8_t data);
+    uint16_t txFree() const;
+    uint8_t txFrameSize() const;
+    void handleByte(uint8_t data);
+    void handleFrame(uint16_t crc);
+    void queueControl(uint8_t type, uint8_t seq);
+    void buildControl(uint8_t type, uint8_t seq);
+    void transmit();
+    void retransmit();
+    void dropFrame();
+};
+
+#endif